@@ -70,6 +70,22 @@ free_agent_expr (struct agent_expr *x)
   xfree (x);
 }
 
+/* Return a copy of agent expression X.  */
+struct agent_expr *
+copy_agent_expr (const struct agent_expr *x)
+{
+  struct agent_expr *copy = xmalloc (sizeof (*copy));
+
+  *copy = *x;
+  copy->buf = xmalloc (x->size);
+  memcpy (copy->buf, x->buf, x->len);
+  copy->reg_mask = xmalloc (x->reg_mask_len * sizeof (x->reg_mask[0]));
+  memcpy (copy->reg_mask, x->reg_mask,
+	  x->reg_mask_len * sizeof (x->reg_mask[0]));
+
+  return copy;
+}
+
 static void
 do_free_agent_expr_cleanup (void *x)
 {
@@ -66,6 +66,7 @@
 #include "stack.h"
 #include "skip.h"
 #include "record.h"
+#include "ax-gdb.h"
 
 /* readline include files */
 #include "readline/readline.h"
@@ -211,6 +212,7 @@ static int single_step_breakpoint_inserted_here_p (struct address_space *,
 						   CORE_ADDR pc);
 
 static void free_bp_location (struct bp_location *loc);
+static void clear_cond_bytecode (struct bp_location *loc);
 static void incref_bp_location (struct bp_location *loc);
 static void decref_bp_location (struct bp_location **loc);
 
@@ -218,6 +220,11 @@ static struct bp_location *allocate_bp_location (struct breakpoint *bpt);
 
 static void update_global_location_list (int);
 
+static int breakpoint_address_is_meaningful (struct breakpoint *bpt);
+
+static int breakpoint_locations_match (struct bp_location *loc1,
+				       struct bp_location *loc2);
+
 static void update_global_location_list_nothrow (int);
 
 static int is_hardware_watchpoint (const struct breakpoint *bpt);
@@ -381,6 +388,67 @@ breakpoints_always_inserted_mode (void)
 	  && !RECORD_IS_USED);
 }
 
+/* Where breakpoint conditions are evaluated.  If host, GDB checks
+   them after every hit.  If target, and the target supports it, GDB
+   passes them to the target along with the breakpoints, and the
+   target only reports hits whose condition is true.  GDB checks the
+   condition again after such a hit.  If auto, GDB behaves as if
+   target was selected.  */
+
+static const char condition_evaluation_auto[] = "auto";
+static const char condition_evaluation_host[] = "host";
+static const char condition_evaluation_target[] = "target";
+static const char *condition_evaluation_enums[] = {
+  condition_evaluation_auto,
+  condition_evaluation_host,
+  condition_evaluation_target,
+  NULL
+};
+static const char *condition_evaluation_mode = condition_evaluation_auto;
+
+/* Return non-zero if breakpoint conditions should be passed to the
+   target.  */
+
+static int
+target_evaluates_breakpoint_conditions (void)
+{
+  return (condition_evaluation_mode != condition_evaluation_host
+	  && target_supports_evaluation_of_breakpoint_conditions ());
+}
+
+static void
+show_condition_evaluation_mode (struct ui_file *file, int from_tty,
+				struct cmd_list_element *c,
+				const char *value)
+{
+  if (condition_evaluation_mode == condition_evaluation_host)
+    fprintf_filtered (file,
+		      _("Breakpoint condition evaluation mode is %s.\n"),
+		      value);
+  else
+    fprintf_filtered (file,
+		      _("Breakpoint condition evaluation mode is %s "
+			"(currently %s).\n"),
+		      value,
+		      target_evaluates_breakpoint_conditions ()
+		      ? condition_evaluation_target
+		      : condition_evaluation_host);
+}
+
+static void
+set_condition_evaluation_mode (char *args, int from_tty,
+			       struct cmd_list_element *c)
+{
+  if (condition_evaluation_mode == condition_evaluation_target
+      && target_has_execution
+      && !target_supports_evaluation_of_breakpoint_conditions ())
+    warning (_("The target does not support evaluating breakpoint "
+	       "conditions; GDB will evaluate them."));
+
+  /* Update the conditions of breakpoints already inserted.  */
+  update_global_location_list (1);
+}
+
 void _initialize_breakpoint (void);
 
 /* Are we executing breakpoint commands?  */
@@ -617,6 +685,7 @@ set_breakpoint_condition (struct breakpoint *b, char *exp,
 	{
 	  xfree (loc->cond);
 	  loc->cond = NULL;
+	  clear_cond_bytecode (loc);
 	}
     }
 
@@ -661,6 +730,9 @@ set_breakpoint_condition (struct breakpoint *b, char *exp,
     }
   breakpoints_changed ();
   observer_notify_breakpoint_modified (b);
+
+  /* Update the conditions of breakpoints already inserted.  */
+  update_global_location_list (1);
 }
 
 /* condition N EXP -- set break condition of breakpoint N to EXP.  */
@@ -1632,6 +1704,180 @@ unduplicated_should_be_inserted (struct bp_location *bl)
   return result;
 }
 
+/* Free the list of breakpoint conditions *CONDITIONS, and the
+   agent expressions in it.  */
+
+static void
+free_target_conditions (VEC(agent_expr_p) **conditions)
+{
+  struct agent_expr *aexpr;
+  int ix;
+
+  for (ix = 0; VEC_iterate (agent_expr_p, *conditions, ix, aexpr); ix++)
+    free_agent_expr (aexpr);
+  VEC_free (agent_expr_p, *conditions);
+}
+
+/* Forget the bytecode compiled from the condition of LOC.  */
+
+static void
+clear_cond_bytecode (struct bp_location *loc)
+{
+  if (loc->cond_bytecode != NULL)
+    free_agent_expr (loc->cond_bytecode);
+  loc->cond_bytecode = NULL;
+  loc->cond_bytecode_failed = 0;
+}
+
+/* Return the bytecode compiled from the condition of LOC, compiling
+   it on first use.  Return NULL if it can't be compiled, in which
+   case GDB evaluates the condition.  */
+
+static struct agent_expr *
+get_cond_bytecode (struct bp_location *loc)
+{
+  volatile struct gdb_exception ex;
+
+  if (loc->cond_bytecode == NULL && !loc->cond_bytecode_failed)
+    {
+      TRY_CATCH (ex, RETURN_MASK_ERROR)
+	{
+	  loc->cond_bytecode = gen_eval_for_expr (loc->address, loc->cond);
+	}
+      if (ex.reason < 0)
+	loc->cond_bytecode_failed = 1;
+    }
+
+  return loc->cond_bytecode;
+}
+
+/* Return the first element of the BP_LOCATION array whose address is
+   ADDRESS or more.  */
+
+static struct bp_location **
+bp_location_lower_bound (CORE_ADDR address)
+{
+  unsigned lo = 0, hi = bp_location_count;
+
+  while (lo < hi)
+    {
+      unsigned mid = lo + (hi - lo) / 2;
+
+      if (bp_location[mid]->address < address)
+	lo = mid + 1;
+      else
+	hi = mid;
+    }
+
+  return bp_location + lo;
+}
+
+/* Compile the conditions the target should evaluate before reporting
+   a hit of the software breakpoint placed for BL.  Since only one
+   breakpoint is inserted per address, these are the conditions of
+   all locations at BL's address, and the target should stop if any
+   of them is true.  Return NULL if the target should always stop,
+   because conditions are evaluated by GDB, or one of these locations
+   is unconditional, or its condition can't be compiled.  */
+
+static VEC(agent_expr_p) *
+build_target_condition_list (struct bp_location *bl)
+{
+  VEC(agent_expr_p) *conditions = NULL;
+  struct bp_location **locp;
+
+  if (!target_evaluates_breakpoint_conditions ()
+      || bl->loc_type != bp_loc_software_breakpoint)
+    return NULL;
+
+  for (locp = bp_location_lower_bound (bl->address);
+       locp < bp_location + bp_location_count
+	 && (*locp)->address == bl->address;
+       locp++)
+    {
+      struct bp_location *loc = *locp;
+      struct agent_expr *aexpr;
+
+      if (!breakpoint_address_is_meaningful (loc->owner)
+	  || is_tracepoint (loc->owner)
+	  || !breakpoint_locations_match (loc, bl)
+	  || !unduplicated_should_be_inserted (loc))
+	continue;
+
+      /* Internal breakpoints, and breakpoints stopping
+	 unconditionally, must always be reported.  */
+      if (loc->owner->type != bp_breakpoint || loc->cond == NULL)
+	goto unconditional;
+
+      aexpr = get_cond_bytecode (loc);
+      if (aexpr == NULL)
+	goto unconditional;
+
+      VEC_safe_push (agent_expr_p, conditions, copy_agent_expr (aexpr));
+    }
+
+  return conditions;
+
+ unconditional:
+  free_target_conditions (&conditions);
+  return NULL;
+}
+
+/* Return non-zero if the condition lists A and B hold the same
+   bytecode.  */
+
+static int
+target_conditions_equal (VEC(agent_expr_p) *a, VEC(agent_expr_p) *b)
+{
+  struct agent_expr *ax, *bx;
+  int ix;
+
+  if (VEC_length (agent_expr_p, a) != VEC_length (agent_expr_p, b))
+    return 0;
+
+  for (ix = 0; VEC_iterate (agent_expr_p, a, ix, ax); ix++)
+    {
+      bx = VEC_index (agent_expr_p, b, ix);
+      if (ax->len != bx->len || memcmp (ax->buf, bx->buf, ax->len) != 0)
+	return 0;
+    }
+
+  return 1;
+}
+
+/* The conditions the target evaluates for an inserted breakpoint
+   depend on every location at its address.  Send them again for BL,
+   which is inserted, if they changed since it was.  */
+
+static void
+update_target_conditions (struct bp_location *bl)
+{
+  VEC(agent_expr_p) *conditions;
+
+  if (bl->loc_type != bp_loc_software_breakpoint
+      || (overlay_debugging != ovly_off
+	  && bl->section != NULL
+	  && section_is_overlay (bl->section)))
+    return;
+
+  conditions = build_target_condition_list (bl);
+  if (target_conditions_equal (conditions, bl->target_info.conditions))
+    {
+      free_target_conditions (&conditions);
+      return;
+    }
+
+  free_target_conditions (&bl->target_info.conditions);
+  bl->target_info.conditions = conditions;
+
+  /* Inserting a breakpoint where the target already has one replaces
+     its conditions.  */
+  if (bl->owner->ops->insert_location (bl) != 0)
+    warning (_("Could not update the conditions of breakpoint %d "
+	       "at %s."),
+	     bl->owner->number, paddress (bl->gdbarch, bl->address));
+}
+
 /* Insert a low-level "breakpoint" of some type.  BL is the breakpoint
    location.  Any error messages are printed to TMP_ERROR_STREAM; and
    DISABLED_BREAKS, and HW_BREAKPOINT_ERROR are used to report problems.
@@ -1652,6 +1898,7 @@ insert_bp_location (struct bp_location *bl,
     return 0;
 
   /* Initialize the target-specific information.  */
+  free_target_conditions (&bl->target_info.conditions);
   memset (&bl->target_info, 0, sizeof (bl->target_info));
   bl->target_info.placed_address = bl->address;
   bl->target_info.placed_address_space = bl->pspace->aspace;
@@ -1722,8 +1969,10 @@ insert_bp_location (struct bp_location *bl,
 	  || bl->section == NULL
 	  || !(section_is_overlay (bl->section)))
 	{
-	  /* No overlay handling: just set the breakpoint.  */
+	  /* No overlay handling: just set the breakpoint, along with
+	     the conditions the target should check.  */
 
+	  bl->target_info.conditions = build_target_condition_list (bl);
 	  val = bl->owner->ops->insert_location (bl);
 	}
       else
@@ -10684,6 +10933,16 @@ update_global_location_list (int should_insert)
 			"a permanent breakpoint"));
     }
 
+  /* Adding, removing, enabling or disabling a location, or changing
+     its condition, may change the conditions the target should
+     evaluate at an address where a breakpoint is already inserted.
+     E.g., a step-resume breakpoint placed where a conditional
+     breakpoint is inserted must make that breakpoint stop
+     unconditionally.  */
+  ALL_BP_LOCATIONS (loc, locp)
+    if (loc->inserted && !loc->duplicate)
+      update_target_conditions (loc);
+
   if (breakpoints_always_inserted_mode () && should_insert
       && (have_live_inferiors ()
 	  || (gdbarch_has_global_breakpoints (target_gdbarch))))
@@ -10800,6 +11059,8 @@ say_where (struct breakpoint *b)
 static void
 bp_location_dtor (struct bp_location *self)
 {
+  free_target_conditions (&self->target_info.conditions);
+  clear_cond_bytecode (self);
   xfree (self->cond);
   xfree (self->function_name);
   xfree (self->source_file);
@@ -14077,6 +14338,23 @@ a warning will be emitted for such breakpoints."),
 			   &breakpoint_set_cmdlist,
 			   &breakpoint_show_cmdlist);
 
+  add_setshow_enum_cmd ("condition-evaluation", class_breakpoint,
+			condition_evaluation_enums,
+			&condition_evaluation_mode, _("\
+Set mode of breakpoint condition evaluation."), _("\
+Show mode of breakpoint condition evaluation."), _("\
+When this is set to \"host\", breakpoint conditions are evaluated by GDB\n\
+each time the breakpoint is hit.  When this is set to \"target\", and the\n\
+target supports it, GDB passes the conditions to the target along with\n\
+the breakpoints, and the target only reports hits whose condition is true,\n\
+saving a stop and resume for every other hit.  Conditions the target can't\n\
+evaluate are still evaluated by GDB.  \"auto\" (the default) behaves\n\
+like \"target\"."),
+			   &set_condition_evaluation_mode,
+			   &show_condition_evaluation_mode,
+			   &breakpoint_set_cmdlist,
+			   &breakpoint_show_cmdlist);
+
   add_setshow_enum_cmd ("always-inserted", class_support,
 			always_inserted_enums, &always_inserted_mode, _("\
 Set mode for inserting breakpoints."), _("\
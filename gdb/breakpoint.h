@@ -22,6 +22,7 @@
 #include "frame.h"
 #include "value.h"
 #include "vec.h"
+#include "ax.h"
 
 struct value;
 struct block;
@@ -247,6 +248,12 @@ struct bp_target_info
      (e.g. if a remote stub handled the details).  We may still need
      the size to remove the breakpoint safely.  */
   int placed_size;
+
+  /* Conditions the target should evaluate before reporting a hit of
+     this breakpoint, as agent expressions.  The target only stops if
+     one of them is true.  Empty if the breakpoint is unconditional
+     or the conditions are evaluated by GDB.  */
+  VEC(agent_expr_p) *conditions;
 };
 
 /* GDB maintains two types of information about each breakpoint (or
@@ -313,6 +320,12 @@ struct bp_location
      the owner breakpoint object.  */
   struct expression *cond;
 
+  /* COND compiled to bytecode for the target to evaluate, or NULL if
+     it has not been compiled yet.  COND_BYTECODE_FAILED is nonzero if
+     COND can't be compiled.  Both are reset whenever COND changes.  */
+  struct agent_expr *cond_bytecode;
+  char cond_bytecode_failed;
+
   /* This location's address is in an unloaded solib, and so this
      location should not be inserted.  It will be automatically
      enabled when that solib is loaded.  */
@@ -785,6 +785,71 @@ compare_line_numbers (const void *ln1p, const void *ln2p)
      behavior (see comment at struct linetable in symtab.h).  */
   return ln1->line - ln2->line;
 }
+
+/* A line table entry being sorted by sort_linetable, along with its
+   position in the unsorted table.  */
+
+struct linetable_sort_entry
+{
+  struct linetable_entry entry;
+  int index;
+};
+
+/* qsort comparison function for sort_linetable.  Entries at the same
+   pc keep the order they were recorded in, except that end of sequence
+   markers come first, as with compare_line_numbers (see record_line).  */
+
+static int
+compare_linetable_sort_entries (const void *p1, const void *p2)
+{
+  const struct linetable_sort_entry *e1 = p1;
+  const struct linetable_sort_entry *e2 = p2;
+
+  if (e1->entry.pc < e2->entry.pc)
+    return -1;
+
+  if (e1->entry.pc > e2->entry.pc)
+    return 1;
+
+  if ((e1->entry.line == 0) != (e2->entry.line == 0))
+    return e1->entry.line == 0 ? -1 : 1;
+
+  return e1->index - e2->index;
+}
+
+/* Sort the entries of line table L by address, unless they already
+   are.  find_pc_sect_line binary-searches line tables, so every
+   finished line table must go through here.  */
+
+void
+sort_linetable (struct linetable *l)
+{
+  struct linetable_sort_entry *sorted;
+  int i;
+
+  for (i = 1; i < l->nitems; i++)
+    if (l->item[i].pc < l->item[i - 1].pc)
+      break;
+
+  if (i >= l->nitems)
+    return;
+
+  /* qsort is not stable; sort (pc, index) pairs instead.  */
+  sorted = xmalloc (l->nitems * sizeof (struct linetable_sort_entry));
+  for (i = 0; i < l->nitems; i++)
+    {
+      sorted[i].entry = l->item[i];
+      sorted[i].index = i;
+    }
+
+  qsort (sorted, l->nitems, sizeof (struct linetable_sort_entry),
+	 compare_linetable_sort_entries);
+
+  for (i = 0; i < l->nitems; i++)
+    l->item[i] = sorted[i].entry;
+
+  xfree (sorted);
+}
 
 /* Start a new symtab for a new source file.  Called, for example,
    when a stabs symbol of type N_SO is seen, or when a DWARF
@@ -1055,11 +1120,14 @@ end_symtab (CORE_ADDR end_addr, struct objfile *objfile, int section)
 
 	      /* Like the pending blocks, the line table may be
 	         scrambled in reordered executables.  Sort it if
-	         OBJF_REORDERED is true.  */
+	         OBJF_REORDERED is true.  Otherwise it only needs
+	         sorting if it is out of address order.  */
 	      if (objfile->flags & OBJF_REORDERED)
 		qsort (subfile->line_vector->item,
 		       subfile->line_vector->nitems,
 		     sizeof (struct linetable_entry), compare_line_numbers);
+	      else
+		sort_linetable (subfile->line_vector);
 	    }
 
 	  /* Now, allocate a symbol table.  */
@@ -1163,6 +1231,7 @@ end_symtab (CORE_ADDR end_addr, struct objfile *objfile, int section)
   if (symtab)
     {
       symtab->primary = 1;
+      add_symtab_to_pc_map (symtab);
     }
 
   /* Default any symbols without a specified symtab to the primary
@@ -306,6 +306,8 @@ extern void record_producer (const char *producer);
 extern void merge_symbol_lists (struct pending **srclist,
 				struct pending **targetlist);
 
+extern void sort_linetable (struct linetable *l);
+
 /* The macro table for the compilation unit whose symbols we're
    currently reading.  All the symtabs for this CU will point to
    this.  */
@@ -0,0 +1,221 @@
+/* LZ compression of remote protocol packets.
+
+   Copyright (C) 2012 Free Software Foundation, Inc.
+
+   This file is part of GDB.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#ifdef GDBSERVER
+#include "server.h"
+#else
+#include "defs.h"
+#endif
+
+#include "rsp-lz.h"
+
+#include <string.h>
+
+/* The compressed data is a series of sequences, each a token byte, an
+   optional literal length extension, literal bytes, and for all but
+   the last sequence, a two byte little-endian match offset and an
+   optional match length extension.
+
+   The high nibble of the token is the number of literals and the low
+   nibble the match length minus RSP_LZ_MIN_MATCH.  A nibble of 15 is
+   followed by extension bytes which are added to it; an extension byte
+   of 255 means another one follows.  The last sequence ends the data
+   right after its literals.  */
+
+#define RSP_LZ_MIN_MATCH 4
+#define RSP_LZ_MAX_OFFSET 0xffff
+#define RSP_LZ_HASH_BITS 12
+
+static unsigned int
+rsp_lz_hash (const unsigned char *p)
+{
+  unsigned int v = p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned) p[3] << 24);
+
+  return (v * 2654435761u) >> (32 - RSP_LZ_HASH_BITS);
+}
+
+/* Append the extension bytes for a length of N, whose nibble was 15, at
+   *OUTP.  Return nonzero if they fit before END.  */
+
+static int
+rsp_lz_put_length (unsigned char **outp, unsigned char *end, int n)
+{
+  unsigned char *out = *outp;
+
+  for (n -= 15; n >= 255; n -= 255)
+    {
+      if (out >= end)
+	return 0;
+      *out++ = 255;
+    }
+  if (out >= end)
+    return 0;
+  *out++ = n;
+
+  *outp = out;
+  return 1;
+}
+
+/* Append a sequence of NLIT literals at LIT and, if MATCH_LEN is
+   nonzero, a match of MATCH_LEN bytes at OFFSET back.  */
+
+static int
+rsp_lz_put_sequence (unsigned char **outp, unsigned char *end,
+		     const unsigned char *lit, int nlit,
+		     int offset, int match_len)
+{
+  unsigned char *out = *outp;
+  int ml = match_len ? match_len - RSP_LZ_MIN_MATCH : 0;
+
+  if (out >= end)
+    return 0;
+  *out++ = ((nlit < 15 ? nlit : 15) << 4) | (ml < 15 ? ml : 15);
+
+  if (nlit >= 15 && !rsp_lz_put_length (&out, end, nlit))
+    return 0;
+  if (end - out < nlit)
+    return 0;
+  memcpy (out, lit, nlit);
+  out += nlit;
+
+  if (match_len)
+    {
+      if (end - out < 2)
+	return 0;
+      *out++ = offset & 0xff;
+      *out++ = offset >> 8;
+      if (ml >= 15 && !rsp_lz_put_length (&out, end, ml))
+	return 0;
+    }
+
+  *outp = out;
+  return 1;
+}
+
+int
+rsp_lz_compress (const unsigned char *in, int len,
+		 unsigned char *out, int out_max)
+{
+  const unsigned char *table[1 << RSP_LZ_HASH_BITS];
+  const unsigned char *ip = in, *anchor = in;
+  const unsigned char *in_end = in + len;
+  unsigned char *op = out, *out_end = out + out_max;
+
+  memset (table, 0, sizeof (table));
+
+  while (in_end - ip >= RSP_LZ_MIN_MATCH)
+    {
+      unsigned int h = rsp_lz_hash (ip);
+      const unsigned char *ref = table[h];
+      int match_len;
+
+      table[h] = ip;
+      if (ref == NULL || ip - ref > RSP_LZ_MAX_OFFSET
+	  || memcmp (ref, ip, RSP_LZ_MIN_MATCH) != 0)
+	{
+	  ip++;
+	  continue;
+	}
+
+      match_len = RSP_LZ_MIN_MATCH;
+      while (ip + match_len < in_end && ref[match_len] == ip[match_len])
+	match_len++;
+
+      if (!rsp_lz_put_sequence (&op, out_end, anchor, ip - anchor,
+				ip - ref, match_len))
+	return -1;
+
+      ip += match_len;
+      anchor = ip;
+    }
+
+  if (!rsp_lz_put_sequence (&op, out_end, anchor, in_end - anchor, 0, 0))
+    return -1;
+
+  return op - out;
+}
+
+/* Read a length whose nibble was N from *INP, which must not pass
+   END.  Return -1 if the data ends too early.  */
+
+static int
+rsp_lz_get_length (const unsigned char **inp, const unsigned char *end, int n)
+{
+  const unsigned char *in = *inp;
+
+  if (n == 15)
+    {
+      int b;
+
+      do
+	{
+	  if (in >= end)
+	    return -1;
+	  b = *in++;
+	  n += b;
+	}
+      while (b == 255);
+    }
+
+  *inp = in;
+  return n;
+}
+
+int
+rsp_lz_decompress (const unsigned char *in, int len,
+		   unsigned char *out, int out_len)
+{
+  const unsigned char *ip = in, *in_end = in + len;
+  unsigned char *op = out, *out_end = out + out_len;
+
+  while (ip < in_end)
+    {
+      int token = *ip++;
+      int nlit, match_len, offset;
+
+      nlit = rsp_lz_get_length (&ip, in_end, token >> 4);
+      if (nlit < 0 || in_end - ip < nlit || out_end - op < nlit)
+	return -1;
+      memcpy (op, ip, nlit);
+      ip += nlit;
+      op += nlit;
+
+      /* The last sequence has no match.  */
+      if (ip == in_end)
+	break;
+
+      if (in_end - ip < 2)
+	return -1;
+      offset = ip[0] | (ip[1] << 8);
+      ip += 2;
+      match_len = rsp_lz_get_length (&ip, in_end, token & 15);
+      if (match_len < 0)
+	return -1;
+      match_len += RSP_LZ_MIN_MATCH;
+
+      if (offset == 0 || offset > op - out || out_end - op < match_len)
+	return -1;
+
+      /* The match may overlap the bytes it produces.  */
+      for (; match_len > 0; match_len--, op++)
+	*op = op[-offset];
+    }
+
+  return op == out_end ? 0 : -1;
+}
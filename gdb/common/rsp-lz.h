@@ -0,0 +1,46 @@
+/* LZ compression of remote protocol packets.
+
+   Copyright (C) 2012 Free Software Foundation, Inc.
+
+   This file is part of GDB.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#ifndef RSP_LZ_H
+#define RSP_LZ_H
+
+/* The first byte of a compressed packet's payload.  No uncompressed
+   packet starts with it.  The rest of the payload is the uncompressed
+   length in hex, a ':', and the compressed data, escaped as for
+   binary data.  */
+#define RSP_LZ_MARKER '\001'
+
+/* Packets with shorter payloads are never compressed.  */
+#define RSP_LZ_MIN_LENGTH 256
+
+/* Compress the LEN bytes at IN into OUT, which has room for OUT_MAX
+   bytes.  Return the compressed length, or -1 if the result would not
+   fit in OUT_MAX bytes.  */
+
+extern int rsp_lz_compress (const unsigned char *in, int len,
+			    unsigned char *out, int out_max);
+
+/* Decompress the LEN bytes at IN into OUT, which must expand to exactly
+   OUT_LEN bytes.  Return 0 on success, or -1 if the data is
+   malformed.  */
+
+extern int rsp_lz_decompress (const unsigned char *in, int len,
+			      unsigned char *out, int out_len);
+
+#endif
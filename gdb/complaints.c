@@ -23,6 +23,7 @@
 #include "gdb_assert.h"
 #include "command.h"
 #include "gdbcmd.h"
+#include "exceptions.h"
 
 extern void _initialize_complaints (void);
 
@@ -169,11 +170,15 @@ vcomplaint (struct complaints **c, const char *file,
 	    int line, const char *fmt,
 	    va_list args)
 {
-  struct complaints *complaints = get_complaints (c);
-  struct complain *complaint = find_complaint (complaints, file, 
-					       line, fmt);
+  struct complaints *complaints;
+  struct complain *complaint;
   enum complaint_series series;
 
+  if (thread_problem_hook != NULL)
+    thread_problem_hook ();
+
+  complaints = get_complaints (c);
+  complaint = find_complaint (complaints, file, line, fmt);
   gdb_assert (complaints != NULL);
 
   complaint->counter++;
@@ -25,7 +25,7 @@
 #include "gdbcore.h"
 #include "target.h"
 #include "inferior.h"
-#include "splay-tree.h"
+#include "exceptions.h"
 
 /* Commands with a prefix of `{set,show} dcache'.  */
 static struct cmd_list_element *dcache_set_list = NULL;
@@ -44,19 +44,26 @@ static struct cmd_list_element *dcache_show_list = NULL;
    significantly.  This is most useful when accessing a large amount
    of data, such as when performing a backtrace.
 
-   The cache is a splay tree along with a linked list for replacement.
-   Each block caches a LINE_SIZE area of memory.  Within each line we
-   remember the address of the line (which must be a multiple of
-   LINE_SIZE) and the actual data block.
+   The cache is a hash table of lines along with a linked list for
+   replacement.  Each block caches a LINE_SIZE area of memory.  Within
+   each line we remember the address of the line (which must be a
+   multiple of LINE_SIZE) and the actual data block.  Accesses tend to hit
+   the same line repeatedly, so the most recently used line is checked
+   before the hash table.  Transfers are done a line at a time, rather
+   than a byte at a time.
 
    Lines are only allocated as needed, so DCACHE_SIZE really specifies the
    *maximum* number of lines in the cache.
 
-   At present, the cache is write-through rather than writeback: as soon
+   By default, the cache is write-through rather than writeback: as soon
    as data is written to the cache, it is also immediately written to
-   the target.  Therefore, cache lines are never "dirty".  Whether a given
-   line is valid or not depends on where it is stored in the dcache_struct;
-   there is no per-block valid flag.  */
+   the target.  With "set dcache write-back on", writes are only stored
+   in the cache and the line is marked dirty; dirty lines are written out
+   by dcache_flush, with adjacent dirty lines combined into a single
+   transfer.  The target layer flushes the cache before resuming or
+   detaching, and before any uncached access to a dirty range.  Whether a
+   given line is valid or not depends on where it is stored in the
+   dcache_struct; there is no per-block valid flag.  */
 
 /* NOTE: Interaction of dcache and memory region attributes
 
@@ -84,6 +91,15 @@ static unsigned dcache_size = DCACHE_DEFAULT_SIZE;
 #define DCACHE_DEFAULT_LINE_SIZE 64
 static unsigned dcache_line_size = DCACHE_DEFAULT_LINE_SIZE;
 
+/* Nonzero if writes should be deferred until the cache is flushed.  */
+static int dcache_write_back_p = 0;
+
+/* The largest number of lines fetched by a single read when misses
+   walk sequentially through memory.  0 means no limit other than half
+   the cache size, 1 disables read-ahead.  */
+#define DCACHE_DEFAULT_READ_AHEAD 64
+static unsigned dcache_read_ahead = DCACHE_DEFAULT_READ_AHEAD;
+
 /* Each cache block holds LINE_SIZE bytes of data
    starting at a multiple-of-LINE_SIZE address.  */
 
@@ -97,14 +113,29 @@ struct dcache_block
   struct dcache_block *prev;
   struct dcache_block *next;
 
+  /* Next block in the same hash bucket.  */
+  struct dcache_block *hash_next;
+
   CORE_ADDR addr;		/* address of data */
   int refs;			/* # hits */
+
+  /* Range of bytes within DATA written to the cache but not yet to the
+     target, [DIRTY_LO, DIRTY_HI).  The line is clean iff DIRTY_HI is 0.  */
+  int dirty_lo, dirty_hi;
+
   gdb_byte data[1];		/* line_size bytes at given address */
 };
 
 struct dcache_struct
 {
-  splay_tree tree;
+  /* Hash table of valid blocks, chained through HASH_NEXT.  The number of
+     buckets is a power of 2.  */
+  struct dcache_block **buckets;
+  unsigned nbuckets;
+
+  /* The most recently used block, or NULL.  */
+  struct dcache_block *mru;
+
   struct dcache_block *oldest; /* least-recently-allocated list.  */
 
   /* The free list is maintained identically to OLDEST to simplify
@@ -113,10 +144,31 @@ struct dcache_struct
 
   /* The number of in-use lines in the cache.  */
   int size;
+
+  /* The number of dirty lines in the cache.  */
+  int ndirty;
+
+  /* Nonzero while dirty lines are being written out.  Lines stay dirty
+     until their transfer succeeds, and the transfer itself may try to
+     flush the range it writes.  */
+  int writing_back;
+
+  /* Nonzero if lines that can not be written back should stay dirty,
+     rather than be reported and dropped.  */
+  int keep_failed;
   CORE_ADDR line_size;  /* current line_size.  */
 
   /* The ptid of last inferior to use cache or null_ptid.  */
   ptid_t ptid;
+
+  /* The value of target_stop_generation when the cache was filled.
+     Anything cached under another generation is stale.  */
+  unsigned int generation;
+
+  /* The lines read by the last miss, [RA_LO, RA_HI), and the number of
+     lines the next miss continuing the stream will read.  */
+  CORE_ADDR ra_lo, ra_hi;
+  int ra_lines;
 };
 
 typedef void (block_func) (struct dcache_block *block, void *param);
@@ -127,6 +179,9 @@ static int dcache_read_line (DCACHE *dcache, struct dcache_block *db);
 
 static struct dcache_block *dcache_alloc (DCACHE *dcache, CORE_ADDR addr);
 
+static void dcache_write_back (DCACHE *dcache, struct dcache_block **blocks,
+			       int nblocks);
+
 static void dcache_info (char *exp, int tty);
 
 void _initialize_dcache (void);
@@ -213,6 +268,56 @@ for_each_block (struct dcache_block **blist, block_func *func, void *param)
   while (*blist && db != *blist);
 }
 
+/* Return the number of hash buckets to use for a cache of SIZE lines.  */
+
+static unsigned
+dcache_buckets_for_size (unsigned size)
+{
+  unsigned nbuckets = 1;
+
+  while (nbuckets < size)
+    nbuckets <<= 1;
+
+  return nbuckets;
+}
+
+/* Return the hash bucket for the line containing ADDR.  */
+
+static struct dcache_block **
+dcache_bucket (DCACHE *dcache, CORE_ADDR addr)
+{
+  CORE_ADDR line = MASK (dcache, addr) / dcache->line_size;
+
+  return &dcache->buckets[(unsigned) (line ^ (line >> 16))
+			  & (dcache->nbuckets - 1)];
+}
+
+/* Add BLOCK to the hash table of DCACHE.  */
+
+static void
+dcache_hash_insert (DCACHE *dcache, struct dcache_block *block)
+{
+  struct dcache_block **bucket = dcache_bucket (dcache, block->addr);
+
+  block->hash_next = *bucket;
+  *bucket = block;
+}
+
+/* Remove BLOCK from the hash table of DCACHE.  */
+
+static void
+dcache_hash_remove (DCACHE *dcache, struct dcache_block *block)
+{
+  struct dcache_block **link = dcache_bucket (dcache, block->addr);
+
+  while (*link != block)
+    link = &(*link)->hash_next;
+  *link = block->hash_next;
+
+  if (dcache->mru == block)
+    dcache->mru = NULL;
+}
+
 /* BLOCK_FUNC routine for dcache_free.  */
 
 static void
@@ -229,7 +334,7 @@ dcache_free (DCACHE *dcache)
   if (last_cache == dcache)
     last_cache = NULL;
 
-  splay_tree_delete (dcache->tree);
+  xfree (dcache->buckets);
   for_each_block (&dcache->oldest, free_block, NULL);
   for_each_block (&dcache->freelist, free_block, NULL);
   xfree (dcache);
@@ -237,15 +342,14 @@ dcache_free (DCACHE *dcache)
 
 
 /* BLOCK_FUNC function for dcache_invalidate.
-   This doesn't remove the block from the oldest list on purpose.
-   dcache_invalidate will do it later.  */
+   This doesn't remove the block from the oldest list or the hash table on
+   purpose.  dcache_invalidate will do it later.  */
 
 static void
 invalidate_block (struct dcache_block *block, void *param)
 {
   DCACHE *dcache = (DCACHE *) param;
 
-  splay_tree_remove (dcache->tree, (splay_tree_key) block->addr);
   append_block (&dcache->freelist, block);
 }
 
@@ -258,7 +362,22 @@ dcache_invalidate (DCACHE *dcache)
 
   dcache->oldest = NULL;
   dcache->size = 0;
+  dcache->ndirty = 0;
   dcache->ptid = null_ptid;
+  dcache->mru = NULL;
+  dcache->ra_lo = dcache->ra_hi = 0;
+  dcache->ra_lines = 1;
+
+  if (dcache->nbuckets != dcache_buckets_for_size (dcache_size))
+    {
+      /* We've been asked to use a different number of lines.  */
+      xfree (dcache->buckets);
+      dcache->nbuckets = dcache_buckets_for_size (dcache_size);
+      dcache->buckets = XCALLOC (dcache->nbuckets, struct dcache_block *);
+    }
+  else
+    memset (dcache->buckets, 0,
+	    dcache->nbuckets * sizeof (struct dcache_block *));
 
   if (dcache->line_size != dcache_line_size)
     {
@@ -280,7 +399,9 @@ dcache_invalidate_line (DCACHE *dcache, CORE_ADDR addr)
 
   if (db)
     {
-      splay_tree_remove (dcache->tree, (splay_tree_key) db->addr);
+      if (db->dirty_hi)
+	dcache->ndirty--;
+      dcache_hash_remove (dcache, db);
       remove_block (&dcache->oldest, db);
       append_block (&dcache->freelist, db);
       --dcache->size;
@@ -294,14 +415,21 @@ static struct dcache_block *
 dcache_hit (DCACHE *dcache, CORE_ADDR addr)
 {
   struct dcache_block *db;
+  CORE_ADDR line = MASK (dcache, addr);
 
-  splay_tree_node node = splay_tree_lookup (dcache->tree,
-					    (splay_tree_key) MASK (dcache, addr));
+  db = dcache->mru;
+  if (db == NULL || db->addr != line)
+    {
+      for (db = *dcache_bucket (dcache, addr); db; db = db->hash_next)
+	if (db->addr == line)
+	  break;
 
-  if (!node)
-    return NULL;
+      if (!db)
+	return NULL;
+
+      dcache->mru = db;
+    }
 
-  db = (struct dcache_block *) node->value;
   db->refs++;
   return db;
 }
@@ -364,13 +492,22 @@ dcache_alloc (DCACHE *dcache, CORE_ADDR addr)
 {
   struct dcache_block *db;
 
+  /* Write back the line about to be evicted.  If that fails, the line
+     is dropped, which makes room by itself.  */
+  if (dcache->size >= dcache_size && dcache->oldest->dirty_hi)
+    {
+      db = dcache->oldest;
+      dcache_write_back (dcache, &db, 1);
+    }
+
   if (dcache->size >= dcache_size)
     {
       /* Evict the least recently allocated line.  */
       db = dcache->oldest;
+
       remove_block (&dcache->oldest, db);
 
-      splay_tree_remove (dcache->tree, (splay_tree_key) db->addr);
+      dcache_hash_remove (dcache, db);
     }
   else
     {
@@ -386,39 +523,170 @@ dcache_alloc (DCACHE *dcache, CORE_ADDR addr)
 
   db->addr = MASK (dcache, addr);
   db->refs = 0;
+  db->dirty_lo = db->dirty_hi = 0;
 
   /* Put DB at the end of the list, it's the newest.  */
   append_block (&dcache->oldest, db);
 
-  splay_tree_insert (dcache->tree, (splay_tree_key) db->addr,
-		     (splay_tree_value) db);
+  dcache_hash_insert (dcache, db);
+
+  return db;
+}
+
+/* Return nonzero if the line containing ADDR is in the cache.  Unlike
+   dcache_hit, this does not count as a use of the line.  */
+
+static int
+dcache_cached_p (DCACHE *dcache, CORE_ADDR addr)
+{
+  CORE_ADDR line = MASK (dcache, addr);
+  struct dcache_block *db;
+
+  for (db = *dcache_bucket (dcache, addr); db; db = db->hash_next)
+    if (db->addr == line)
+      return 1;
+
+  return 0;
+}
+
+/* Bring the line containing ADDR into the cache, which must not already
+   hold it, and return its block.  Return NULL if it could not be read.
+
+   A miss just past the lines read by the previous miss, in either
+   direction, continues a sequential walk such as following a linked
+   list or dumping an array; each such miss doubles the number of lines
+   read in one transfer, up to the read-ahead limit.  Any other miss
+   starts over with a single line.  */
+
+static struct dcache_block *
+dcache_fill (DCACHE *dcache, CORE_ADDR addr)
+{
+  CORE_ADDR line = MASK (dcache, addr);
+  CORE_ADDR line_size = dcache->line_size;
+  CORE_ADDR span = dcache->ra_lines * line_size;
+  CORE_ADDR start;
+  struct dcache_block *db;
+  struct mem_region *region;
+  struct cleanup *old_chain;
+  gdb_byte *buf;
+  LONGEST res;
+  int max_lines, nlines, forward, i;
+
+  max_lines = dcache_size / 2;
+  if (dcache_read_ahead != 0 && dcache_read_ahead < max_lines)
+    max_lines = dcache_read_ahead;
+  if (max_lines < 1)
+    max_lines = 1;
+
+  forward = 1;
+  if (dcache->ra_hi != dcache->ra_lo
+      && line >= dcache->ra_hi && line - dcache->ra_hi < span)
+    nlines = dcache->ra_lines * 2;
+  else if (dcache->ra_hi != dcache->ra_lo
+	   && line < dcache->ra_lo && dcache->ra_lo - line <= span)
+    {
+      nlines = dcache->ra_lines * 2;
+      forward = 0;
+    }
+  else
+    nlines = 1;
+
+  if (nlines > max_lines)
+    nlines = max_lines;
+  dcache->ra_lines = nlines;
+
+  /* Stop at the first line already cached, or at the end of the
+     address space.  */
+  for (i = 1; i < nlines; i++)
+    {
+      CORE_ADDR next = forward ? line + i * line_size : line - i * line_size;
+
+      if ((forward ? next < line : next > line)
+	  || dcache_cached_p (dcache, next))
+	break;
+    }
+  nlines = i;
+  start = forward ? line : line - (nlines - 1) * line_size;
+
+  /* Read ahead only within a single readable memory region.  */
+  if (nlines > 1)
+    {
+      region = lookup_mem_region (start);
+      if (region->attrib.mode == MEM_WO
+	  || (region->hi != 0 && start + nlines * line_size > region->hi))
+	{
+	  nlines = 1;
+	  start = line;
+	}
+    }
+
+  if (nlines > 1)
+    {
+      buf = xmalloc (nlines * line_size);
+      old_chain = make_cleanup (xfree, buf);
+
+      res = target_read (&current_target, TARGET_OBJECT_RAW_MEMORY,
+			 NULL, buf, start, nlines * line_size);
+
+      /* Reading forward, the first line is the one wanted, and whatever
+	 complete lines came before an error are still good.  */
+      if (forward && res >= (LONGEST) line_size)
+	nlines = res / line_size;
+      else if (res < (LONGEST) (nlines * line_size))
+	nlines = 0;
+
+      for (i = 0; i < nlines; i++)
+	{
+	  db = dcache_alloc (dcache, start + i * line_size);
+	  memcpy (db->data, buf + i * line_size, line_size);
+	}
+
+      do_cleanups (old_chain);
+
+      if (nlines > 0)
+	{
+	  dcache->ra_lo = start;
+	  dcache->ra_hi = start + nlines * line_size;
+	  return dcache_hit (dcache, line);
+	}
 
+      /* Fall back to reading just the line asked for.  */
+      dcache->ra_lines = 1;
+    }
+
+  db = dcache_alloc (dcache, line);
+  if (!dcache_read_line (dcache, db))
+    return NULL;
+
+  dcache->ra_lo = line;
+  dcache->ra_hi = line + line_size;
   return db;
 }
 
-/* Using the data cache DCACHE, store in *PTR the contents of the byte at
-   address ADDR in the remote machine.  
+/* Using the data cache DCACHE, copy LEN bytes at address ADDR in the
+   remote machine to MYADDR.  The range must not cross a line boundary.
 
    Returns 1 for success, 0 for error.  */
 
 static int
-dcache_peek_byte (DCACHE *dcache, CORE_ADDR addr, gdb_byte *ptr)
+dcache_peek_line (DCACHE *dcache, CORE_ADDR addr, gdb_byte *myaddr, int len)
 {
   struct dcache_block *db = dcache_hit (dcache, addr);
 
   if (!db)
     {
-      db = dcache_alloc (dcache, addr);
+      db = dcache_fill (dcache, addr);
 
-      if (!dcache_read_line (dcache, db))
+      if (!db)
          return 0;
     }
 
-  *ptr = db->data[XFORM (dcache, addr)];
+  memcpy (myaddr, db->data + XFORM (dcache, addr), len);
   return 1;
 }
 
-/* Write the byte at PTR into ADDR in the data cache.
+/* Write the LEN bytes at MYADDR into ADDR in the data cache.  The range
+   must not cross a line boundary.
 
    The caller is responsible for also promptly writing the data
    through to target memory.
@@ -430,25 +698,52 @@ dcache_peek_byte (DCACHE *dcache, CORE_ADDR addr, gdb_byte *ptr)
    Always return 1 (meaning success) to simplify dcache_xfer_memory.  */
 
 static int
-dcache_poke_byte (DCACHE *dcache, CORE_ADDR addr, gdb_byte *ptr)
+dcache_poke_line (DCACHE *dcache, CORE_ADDR addr, gdb_byte *myaddr, int len)
 {
   struct dcache_block *db = dcache_hit (dcache, addr);
 
   if (db)
-    db->data[XFORM (dcache, addr)] = *ptr;
+    memcpy (db->data + XFORM (dcache, addr), myaddr, len);
 
   return 1;
 }
 
+/* Write the LEN bytes at MYADDR into ADDR in the data cache, and mark
+   them dirty.  The range must not cross a line boundary.  Unless the
+   whole line is written, it is read in first.
+
+   Returns 1 for success, 0 if the line could not be read.  */
+
 static int
-dcache_splay_tree_compare (splay_tree_key a, splay_tree_key b)
+dcache_poke_line_dirty (DCACHE *dcache, CORE_ADDR addr, gdb_byte *myaddr,
+			int len)
 {
-  if (a > b)
-    return 1;
-  else if (a == b)
-    return 0;
+  struct dcache_block *db = dcache_hit (dcache, addr);
+  int offset = XFORM (dcache, addr);
+
+  if (!db)
+    {
+      db = dcache_alloc (dcache, addr);
+
+      if (len != dcache->line_size && !dcache_read_line (dcache, db))
+	return 0;
+    }
+
+  memcpy (db->data + offset, myaddr, len);
+
+  if (!db->dirty_hi)
+    {
+      db->dirty_lo = offset;
+      db->dirty_hi = offset + len;
+      dcache->ndirty++;
+    }
   else
-    return -1;
+    {
+      db->dirty_lo = min (db->dirty_lo, offset);
+      db->dirty_hi = max (db->dirty_hi, offset + len);
+    }
+
+  return 1;
 }
 
 /* Allocate and initialize a data cache.  */
@@ -460,15 +755,21 @@ dcache_init (void)
 
   dcache = (DCACHE *) xmalloc (sizeof (*dcache));
 
-  dcache->tree = splay_tree_new (dcache_splay_tree_compare,
-				 NULL,
-				 NULL);
+  dcache->nbuckets = dcache_buckets_for_size (dcache_size);
+  dcache->buckets = XCALLOC (dcache->nbuckets, struct dcache_block *);
+  dcache->mru = NULL;
 
   dcache->oldest = NULL;
   dcache->freelist = NULL;
   dcache->size = 0;
+  dcache->ndirty = 0;
+  dcache->writing_back = 0;
+  dcache->keep_failed = 0;
   dcache->line_size = dcache_line_size;
   dcache->ptid = null_ptid;
+  dcache->generation = target_stop_generation;
+  dcache->ra_lo = dcache->ra_hi = 0;
+  dcache->ra_lines = 1;
   last_cache = dcache;
 
   return dcache;
@@ -492,17 +793,45 @@ dcache_xfer_memory (struct target_ops *ops, DCACHE *dcache,
 {
   int i;
   int res;
-  int (*xfunc) (DCACHE *dcache, CORE_ADDR addr, gdb_byte *ptr);
+  int (*xfunc) (DCACHE *dcache, CORE_ADDR addr, gdb_byte *myaddr, int len);
 
-  xfunc = should_write ? dcache_poke_byte : dcache_peek_byte;
+  xfunc = should_write ? dcache_poke_line : dcache_peek_line;
 
-  /* If this is a different inferior from what we've recorded,
-     flush the cache.  */
+  /* If this is a different inferior from what we've recorded, or the
+     target has run since the cache was filled, flush the cache.  */
 
-  if (! ptid_equal (inferior_ptid, dcache->ptid))
+  if (! ptid_equal (inferior_ptid, dcache->ptid)
+      || dcache->generation != target_stop_generation)
     {
+      dcache_flush (dcache);
       dcache_invalidate (dcache);
       dcache->ptid = inferior_ptid;
+      dcache->generation = target_stop_generation;
+    }
+
+  if (should_write && dcache_write_back_p)
+    {
+      for (i = 0; i < len; )
+	{
+	  int chunk = dcache->line_size - XFORM (dcache, memaddr + i);
+
+	  if (chunk > len - i)
+	    chunk = len - i;
+
+	  if (!dcache_poke_line_dirty (dcache, memaddr + i, myaddr + i, chunk))
+	    {
+	      /* The line is not readable, write this piece through.  */
+	      dcache_invalidate_line (dcache, memaddr + i);
+	      res = target_write (ops, TARGET_OBJECT_RAW_MEMORY,
+				  NULL, myaddr + i, memaddr + i, chunk);
+	      if (res < chunk)
+		return i + max (res, 0);
+	    }
+
+	  i += chunk;
+	}
+
+      return len;
     }
 
   /* Do write-through first, so that if it fails, we don't write to
@@ -518,9 +847,14 @@ dcache_xfer_memory (struct target_ops *ops, DCACHE *dcache,
       len = res;
     }
       
-  for (i = 0; i < len; i++)
+  for (i = 0; i < len; )
     {
-      if (!xfunc (dcache, memaddr + i, myaddr + i))
+      int chunk = dcache->line_size - XFORM (dcache, memaddr + i);
+
+      if (chunk > len - i)
+	chunk = len - i;
+
+      if (!xfunc (dcache, memaddr + i, myaddr + i, chunk))
 	{
 	  /* That failed.  Discard its cache line so we don't have a
 	     partially read line.  */
@@ -531,19 +865,245 @@ dcache_xfer_memory (struct target_ops *ops, DCACHE *dcache,
 	  else
 	    return i;
 	}
+
+      i += chunk;
     }
-    
+
   return len;
 }
 
-/* FIXME: There would be some benefit to making the cache write-back and
-   moving the writeback operation to a higher layer, as it could occur
-   after a sequence of smaller writes have been completed (as when a stack
-   frame is constructed for an inferior function call).  Note that only
-   moving it up one level to target_xfer_memory[_partial]() is not
-   sufficient since we want to coalesce memory transfers that are
-   "logically" connected but not actually a single call to one of the
-   memory transfer functions.  */
+/* Write LEN bytes from MYADDR to target memory at MEMADDR.  Return
+   nonzero if all of them were written.  Errors are not propagated:
+   deferred data is written out on the way to resuming or detaching,
+   which must not be left half done.  */
+
+static int
+dcache_write_memory (CORE_ADDR memaddr, gdb_byte *myaddr, LONGEST len)
+{
+  volatile struct gdb_exception e;
+  LONGEST res = -1;
+
+  TRY_CATCH (e, RETURN_MASK_ERROR)
+    {
+      res = target_write (&current_target, TARGET_OBJECT_RAW_MEMORY,
+			  NULL, myaddr, memaddr, len);
+    }
+
+  return e.reason == 0 && res == len;
+}
+
+/* Write the dirty part of line DB to the target.  Mark it clean on
+   success.  Otherwise, unless DCACHE->keep_failed is set, report the
+   failure and drop the line, since the cache no longer matches
+   memory.  */
+
+static void
+dcache_write_back_line (DCACHE *dcache, struct dcache_block *db)
+{
+  CORE_ADDR lo = db->addr + db->dirty_lo;
+
+  if (dcache_write_memory (lo, db->data + db->dirty_lo,
+			   db->dirty_hi - db->dirty_lo))
+    {
+      db->dirty_lo = db->dirty_hi = 0;
+      dcache->ndirty--;
+    }
+  else if (!dcache->keep_failed)
+    {
+      warning (_("Cannot write cached data back to memory at %s, "
+		 "discarding it."),
+	       paddress (target_gdbarch, lo));
+      dcache_invalidate_line (dcache, db->addr);
+    }
+}
+
+/* Write the dirty parts of the NBLOCKS dirty lines in BLOCKS, which are
+   sorted by address, to the target.  Runs of adjacent dirty bytes are
+   written with a single transfer.  Lines are marked clean once they
+   have been written.  If a run can not be written, its lines are
+   retried one at a time, and those that still fail are reported and
+   dropped from the cache.  */
+
+static void
+dcache_write_back (DCACHE *dcache, struct dcache_block **blocks, int nblocks)
+{
+  struct cleanup *old_chain;
+  int i = 0;
+
+  if (dcache->writing_back)
+    return;
+
+  old_chain = make_cleanup_restore_integer (&dcache->writing_back);
+  dcache->writing_back = 1;
+  save_inferior_ptid ();
+
+  /* The data belongs to the inferior that last used the cache.  */
+  inferior_ptid = dcache->ptid;
+
+  while (i < nblocks)
+    {
+      int first = i, j;
+      CORE_ADDR start, end;
+      gdb_byte *buf;
+
+      /* Extend the run while the next line continues it.  */
+      for (i++; i < nblocks; i++)
+	{
+	  struct dcache_block *prev = blocks[i - 1];
+	  struct dcache_block *next = blocks[i];
+
+	  if (next->addr != prev->addr + dcache->line_size
+	      || prev->dirty_hi != dcache->line_size
+	      || next->dirty_lo != 0)
+	    break;
+	}
+
+      start = blocks[first]->addr + blocks[first]->dirty_lo;
+      end = blocks[i - 1]->addr + blocks[i - 1]->dirty_hi;
+
+      buf = xmalloc (end - start);
+      make_cleanup (xfree, buf);
+      for (j = first; j < i; j++)
+	{
+	  struct dcache_block *db = blocks[j];
+	  CORE_ADDR lo = db->addr + db->dirty_lo;
+
+	  memcpy (buf + (lo - start), db->data + db->dirty_lo,
+		  db->dirty_hi - db->dirty_lo);
+	}
+
+      if (i - first > 1 && dcache_write_memory (start, buf, end - start))
+	{
+	  for (j = first; j < i; j++)
+	    {
+	      blocks[j]->dirty_lo = blocks[j]->dirty_hi = 0;
+	      dcache->ndirty--;
+	    }
+	}
+      else
+	{
+	  for (j = first; j < i; j++)
+	    dcache_write_back_line (dcache, blocks[j]);
+	}
+    }
+
+  do_cleanups (old_chain);
+}
+
+/* qsort comparison function for dcache_flush and dcache_sorted_blocks.  */
+
+static int
+compare_block_addr (const void *ap, const void *bp)
+{
+  const struct dcache_block *a = *(const struct dcache_block **) ap;
+  const struct dcache_block *b = *(const struct dcache_block **) bp;
+
+  if (a->addr > b->addr)
+    return 1;
+  else if (a->addr == b->addr)
+    return 0;
+  else
+    return -1;
+}
+
+/* BLOCK_FUNC routine for dcache_flush.  */
+
+static void
+collect_dirty_block (struct dcache_block *block, void *param)
+{
+  struct dcache_block ***next = param;
+
+  if (block->dirty_hi)
+    *(*next)++ = block;
+}
+
+void
+dcache_flush (DCACHE *dcache)
+{
+  struct dcache_block **blocks;
+  struct dcache_block **next;
+  struct cleanup *old_chain;
+  struct inferior *inf;
+
+  if (dcache->ndirty == 0 || dcache->writing_back)
+    return;
+
+  /* If the inferior is gone, so is the memory the data was for.  */
+  inf = (ptid_equal (dcache->ptid, null_ptid) ? NULL
+	 : find_inferior_pid (ptid_get_pid (dcache->ptid)));
+  if (inf == NULL)
+    {
+      dcache_invalidate (dcache);
+      return;
+    }
+
+  blocks = XNEWVEC (struct dcache_block *, dcache->ndirty);
+  old_chain = make_cleanup (xfree, blocks);
+  next = blocks;
+  for_each_block (&dcache->oldest, collect_dirty_block, &next);
+  gdb_assert (next - blocks == dcache->ndirty);
+  qsort (blocks, dcache->ndirty, sizeof (*blocks), compare_block_addr);
+
+  dcache_write_back (dcache, blocks, dcache->ndirty);
+
+  do_cleanups (old_chain);
+}
+
+/* Write out all of DCACHE's dirty lines before its geometry changes.
+   Lines that can not be written stay in the cache, and an error is
+   thrown, so that no deferred write is silently lost.  */
+
+static void
+dcache_flush_or_error (DCACHE *dcache)
+{
+  struct cleanup *old_chain;
+
+  old_chain = make_cleanup_restore_integer (&dcache->keep_failed);
+  dcache->keep_failed = 1;
+  dcache_flush (dcache);
+  do_cleanups (old_chain);
+
+  if (dcache->ndirty != 0)
+    error (_("Cannot write %d dirty dcache lines back to memory."),
+	   dcache->ndirty);
+}
+
+/* BLOCK_FUNC routine for dcache_flush_range.  */
+
+struct dirty_range
+{
+  CORE_ADDR lo, hi;
+  int found;
+};
+
+static void
+check_dirty_block (struct dcache_block *block, void *param)
+{
+  struct dirty_range *range = param;
+
+  if (block->dirty_hi
+      && block->addr + block->dirty_lo < range->hi
+      && block->addr + block->dirty_hi > range->lo)
+    range->found = 1;
+}
+
+void
+dcache_flush_range (DCACHE *dcache, CORE_ADDR memaddr, LONGEST len)
+{
+  struct dirty_range range;
+
+  if (dcache->ndirty == 0)
+    return;
+
+  range.lo = memaddr;
+  range.hi = memaddr + len;
+  range.found = 0;
+  for_each_block (&dcache->oldest, check_dirty_block, &range);
+
+  /* Flush everything, so that adjacent writes still get combined.  */
+  if (range.found)
+    dcache_flush (dcache);
+}
 
 /* Just update any cache lines which are already present.  This is called
    by memory_xfer_partial in cases where the access would otherwise not go
@@ -554,16 +1114,51 @@ dcache_update (DCACHE *dcache, CORE_ADDR memaddr, gdb_byte *myaddr, int len)
 {
   int i;
 
-  for (i = 0; i < len; i++)
-    dcache_poke_byte (dcache, memaddr + i, myaddr + i);
+  for (i = 0; i < len; )
+    {
+      int chunk = dcache->line_size - XFORM (dcache, memaddr + i);
+
+      if (chunk > len - i)
+	chunk = len - i;
+
+      dcache_poke_line (dcache, memaddr + i, myaddr + i, chunk);
+      i += chunk;
+    }
+}
+
+/* BLOCK_FUNC routine for dcache_sorted_blocks.  */
+
+static void
+collect_block (struct dcache_block *block, void *param)
+{
+  struct dcache_block ***next = param;
+
+  *(*next)++ = block;
+}
+
+/* Return an xmalloc'ed array of the valid blocks of DCACHE, sorted by
+   address.  The number of blocks is DCACHE->size.  */
+
+static struct dcache_block **
+dcache_sorted_blocks (DCACHE *dcache)
+{
+  struct dcache_block **blocks;
+  struct dcache_block **next;
+
+  blocks = XNEWVEC (struct dcache_block *, dcache->size + 1);
+  next = blocks;
+  for_each_block (&dcache->oldest, collect_block, &next);
+  qsort (blocks, dcache->size, sizeof (*blocks), compare_block_addr);
+
+  return blocks;
 }
 
 static void
 dcache_print_line (int index)
 {
-  splay_tree_node n;
+  struct dcache_block **blocks;
   struct dcache_block *db;
-  int i, j;
+  int j;
 
   if (!last_cache)
     {
@@ -571,22 +1166,15 @@ dcache_print_line (int index)
       return;
     }
 
-  n = splay_tree_min (last_cache->tree);
-
-  for (i = index; i > 0; --i)
-    {
-      if (!n)
-	break;
-      n = splay_tree_successor (last_cache->tree, n->key);
-    }
-
-  if (!n)
+  if (index >= last_cache->size)
     {
       printf_filtered (_("No such cache line exists.\n"));
       return;
     }
-    
-  db = (struct dcache_block *) n->value;
+
+  blocks = dcache_sorted_blocks (last_cache);
+  db = blocks[index];
+  xfree (blocks);
 
   printf_filtered (_("Line %d: address %s [%d hits]\n"),
 		   index, paddress (target_gdbarch, db->addr), db->refs);
@@ -605,7 +1193,7 @@ dcache_print_line (int index)
 static void
 dcache_info (char *exp, int tty)
 {
-  splay_tree_node n;
+  struct dcache_block **blocks;
   int i, refcount;
 
   if (exp)
@@ -639,22 +1227,22 @@ dcache_info (char *exp, int tty)
 
   refcount = 0;
 
-  n = splay_tree_min (last_cache->tree);
-  i = 0;
+  blocks = dcache_sorted_blocks (last_cache);
 
-  while (n)
+  for (i = 0; i < last_cache->size; i++)
     {
-      struct dcache_block *db = (struct dcache_block *) n->value;
+      struct dcache_block *db = blocks[i];
 
       printf_filtered (_("Line %d: address %s [%d hits]\n"),
 		       i, paddress (target_gdbarch, db->addr), db->refs);
-      i++;
       refcount += db->refs;
-
-      n = splay_tree_successor (last_cache->tree, n->key);
     }
 
+  xfree (blocks);
+
   printf_filtered (_("Cache state: %d active lines, %d hits\n"), i, refcount);
+  if (last_cache->ndirty)
+    printf_filtered (_("%d dirty lines\n"), last_cache->ndirty);
 }
 
 static void
@@ -667,7 +1255,12 @@ set_dcache_size (char *args, int from_tty,
       error (_("Dcache size must be greater than 0."));
     }
   if (last_cache)
-    dcache_invalidate (last_cache);
+    {
+      /* If deferred writes can not be written out, the lines holding
+	 them stay cached; the new size still limits the cache.  */
+      dcache_flush_or_error (last_cache);
+      dcache_invalidate (last_cache);
+    }
 }
 
 static void
@@ -682,7 +1275,30 @@ set_dcache_line_size (char *args, int from_tty,
       error (_("Invalid dcache line size: %u (must be power of 2)."), d);
     }
   if (last_cache)
-    dcache_invalidate (last_cache);
+    {
+      volatile struct gdb_exception e;
+
+      /* Keep the old line size for as long as dirty lines of that
+	 size can not be written out.  */
+      TRY_CATCH (e, RETURN_MASK_ERROR)
+	{
+	  dcache_flush_or_error (last_cache);
+	}
+      if (e.reason < 0)
+	{
+	  dcache_line_size = last_cache->line_size;
+	  throw_exception (e);
+	}
+      dcache_invalidate (last_cache);
+    }
+}
+
+static void
+set_dcache_write_back (char *args, int from_tty,
+		       struct cmd_list_element *c)
+{
+  if (!dcache_write_back_p && last_cache)
+    dcache_flush (last_cache);
 }
 
 static void
@@ -736,6 +1352,26 @@ Show dcache line size."),
 			    set_dcache_line_size,
 			    NULL,
 			    &dcache_set_list, &dcache_show_list);
+  add_setshow_boolean_cmd ("write-back", class_obscure,
+			   &dcache_write_back_p, _("\
+Set whether memory writes are deferred in the dcache."), _("\
+Show whether memory writes are deferred in the dcache."), _("\
+When on, writes to cached memory only update the dcache.  They are sent\n\
+to the target when the program resumes or memory is accessed without\n\
+the cache, with adjacent writes combined into a single transfer."),
+			   set_dcache_write_back,
+			   NULL,
+			   &dcache_set_list, &dcache_show_list);
+  add_setshow_uinteger_cmd ("read-ahead", class_obscure,
+			    &dcache_read_ahead, _("\
+Set the most dcache lines read at once on sequential misses."), _("\
+Show the most dcache lines read at once on sequential misses."), _("\
+When cache misses walk through memory in either direction, each miss\n\
+reads twice as many lines as the previous one, up to this limit.\n\
+\"unlimited\" allows up to half the cache; 1 disables read-ahead."),
+			    NULL,
+			    NULL,
+			    &dcache_set_list, &dcache_show_list);
   add_setshow_uinteger_cmd ("size", class_obscure,
 			    &dcache_size, _("\
 Set number of dcache lines."), _("\
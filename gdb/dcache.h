@@ -33,6 +33,12 @@ DCACHE *dcache_init (void);
 /* Free a DCACHE.  */
 void dcache_free (DCACHE *);
 
+/* Write data deferred in DCACHE to the target.  */
+void dcache_flush (DCACHE *dcache);
+
+/* Likewise, if any of the deferred data is in [MEMADDR, MEMADDR + LEN).  */
+void dcache_flush_range (DCACHE *dcache, CORE_ADDR memaddr, LONGEST len);
+
 /* Simple to call from <remote>_xfer_memory.  */
 
 int dcache_xfer_memory (struct target_ops *ops, DCACHE *cache, CORE_ADDR mem,
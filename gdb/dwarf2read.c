@@ -56,6 +56,8 @@
 #include "vec.h"
 #include "c-lang.h"
 #include "valprint.h"
+#include "elf-bfd.h"
+#include "gdb_wait.h"
 #include <ctype.h>
 
 #include <fcntl.h>
@@ -65,6 +67,13 @@
 #ifdef HAVE_ZLIB_H
 #include <zlib.h>
 #endif
+#if defined (HAVE_PTHREAD_H) && defined (HAVE_PTHREAD_CREATE)
+#include <pthread.h>
+#include <setjmp.h>
+#include <signal.h>
+#include <sys/time.h>
+#define DWARF2_WORKER_THREADS 1
+#endif
 #ifdef HAVE_MMAP
 #include <sys/mman.h>
 #ifndef MAP_FAILED
@@ -372,6 +381,12 @@ struct dwarf2_cu
   /* Hash table holding all the loaded partial DIEs.  */
   htab_t partial_dies;
 
+  /* Copies of the partial DIEs that load_partial_dies, when building a
+     psymtab, found it could add a partial symbol for without keeping
+     the DIE, chained through die_sibling in the order found.
+     process_psymtab_comp_unit adds their symbols.  */
+  struct partial_die_info *early_psymbol_dies, *last_early_psymbol_die;
+
   /* Storage for things with the same lifetime as this read-in compilation
      unit, including partial DIEs.  */
   struct obstack comp_unit_obstack;
@@ -428,6 +443,29 @@ struct dwarf2_cu
      unoptimized code.  For a future better test see GCC PR other/32998.  */
 
   unsigned int has_loclist : 1;
+
+  /* This flag is set while a worker thread loads the partial DIEs of
+     this compilation unit; see dwarf2_build_psymtabs_hard.  Partial DIE
+     names are left for canonicalize_partial_die_names then.  */
+  unsigned int loaded_by_worker : 1;
+};
+
+/* A compilation unit loaded by load_psymtab_comp_unit.  */
+
+struct psymtab_cu_load
+{
+  /* The compilation unit.  */
+  struct dwarf2_cu *cu;
+
+  /* Just past the compilation unit DIE, or NULL if the unit is to be
+     skipped.  */
+  gdb_byte *info_ptr;
+
+  struct die_info *comp_unit_die;
+  int has_children;
+
+  /* The first of the unit's partial DIEs, if it has children.  */
+  struct partial_die_info *first_die;
 };
 
 /* Persistent data held for a compilation unit, even when not
@@ -824,6 +862,20 @@ show_dwarf2_max_cache_age (struct ui_file *file, int from_tty,
 		    value);
 }
 
+/* The number of worker threads that load partial DIEs while partial
+   symbol tables are built.  -1 means one less than the number of
+   processors; zero, the default, means the main thread does all the
+   work.  */
+static int dwarf2_worker_threads = 0;
+static void
+show_dwarf2_worker_threads (struct ui_file *file, int from_tty,
+			    struct cmd_list_element *c, const char *value)
+{
+  fprintf_filtered (file, _("The number of threads loading dwarf2 "
+			    "partial DIEs is %s.\n"),
+		    value);
+}
+
 
 /* Various complaints about symbol reading that don't abort the process.  */
 
@@ -901,6 +953,10 @@ static void dwarf2_find_base_address (struct die_info *die,
 
 static void dwarf2_build_psymtabs_hard (struct objfile *);
 
+static void dwarf2_save_cached_index (struct objfile *);
+
+static void munmap_section_buffer (struct dwarf2_section_info *);
+
 static void scan_partial_symbols (struct partial_die_info *,
 				  CORE_ADDR *, CORE_ADDR *,
 				  int, struct dwarf2_cu *);
@@ -947,6 +1003,11 @@ static struct partial_die_info *load_partial_dies (bfd *,
 						   gdb_byte *, gdb_byte *,
 						   int, struct dwarf2_cu *);
 
+static void add_early_partial_symbols (struct dwarf2_cu *);
+
+static void canonicalize_partial_die_names (struct partial_die_info *,
+					    struct dwarf2_cu *);
+
 static gdb_byte *read_partial_die (struct partial_die_info *,
                                    struct abbrev_info *abbrev,
 				   unsigned int, bfd *,
@@ -2152,13 +2213,14 @@ find_slot_in_mapped_hash (struct mapped_index *index, const char *name,
     }
 }
 
-/* Read the index file.  If everything went ok, initialize the "quick"
-   elements of all the CUs and return 1.  Otherwise, return 0.  */
+/* Read the index at ADDR, which is SIZE bytes long.  If everything
+   went ok, initialize the "quick" elements of all the CUs and return 1.
+   Otherwise, return 0.  */
 
 static int
-dwarf2_read_index (struct objfile *objfile)
+read_index_from_buffer (struct objfile *objfile, char *addr,
+			offset_type size)
 {
-  char *addr;
   struct mapped_index *map;
   offset_type *metadata;
   const gdb_byte *cu_list;
@@ -2167,18 +2229,6 @@ dwarf2_read_index (struct objfile *objfile)
   offset_type types_list_elements = 0;
   int i;
 
-  if (dwarf2_section_empty_p (&dwarf2_per_objfile->gdb_index))
-    return 0;
-
-  /* Older elfutils strip versions could keep the section in the main
-     executable while splitting it for the separate debug info file.  */
-  if ((bfd_get_file_flags (dwarf2_per_objfile->gdb_index.asection)
-       & SEC_HAS_CONTENTS) == 0)
-    return 0;
-
-  dwarf2_read_section (objfile, &dwarf2_per_objfile->gdb_index);
-
-  addr = dwarf2_per_objfile->gdb_index.buffer;
   /* Version check.  */
   version = MAYBE_SWAP (*(offset_type *) addr);
   /* Versions earlier than 3 emitted every copy of a psymbol.  This
@@ -2195,7 +2245,7 @@ dwarf2_read_index (struct objfile *objfile)
 
   map = OBSTACK_ZALLOC (&objfile->objfile_obstack, struct mapped_index);
   map->version = version;
-  map->total_size = dwarf2_per_objfile->gdb_index.size;
+  map->total_size = size;
 
   metadata = (offset_type *) (addr + sizeof (offset_type));
 
@@ -2255,6 +2305,365 @@ dwarf2_read_index (struct objfile *objfile)
   return 1;
 }
 
+/* Read the index file.  If everything went ok, initialize the "quick"
+   elements of all the CUs and return 1.  Otherwise, return 0.  */
+
+static int
+dwarf2_read_index (struct objfile *objfile)
+{
+  if (dwarf2_section_empty_p (&dwarf2_per_objfile->gdb_index))
+    return 0;
+
+  /* Older elfutils strip versions could keep the section in the main
+     executable while splitting it for the separate debug info file.  */
+  if ((bfd_get_file_flags (dwarf2_per_objfile->gdb_index.asection)
+       & SEC_HAS_CONTENTS) == 0)
+    return 0;
+
+  dwarf2_read_section (objfile, &dwarf2_per_objfile->gdb_index);
+
+  return read_index_from_buffer (objfile,
+				 dwarf2_per_objfile->gdb_index.buffer,
+				 dwarf2_per_objfile->gdb_index.size);
+}
+
+/* The index cache holds the indices GDB made itself for the symbol
+   files without a .gdb_index section, so that loading the same file
+   again is as fast as if it had one.  */
+
+/* Whether to use the index cache.  Off by default, as saving an index
+   forks a copy of GDB.  */
+static int index_cache_enabled = 0;
+static void
+show_index_cache_enabled (struct ui_file *file, int from_tty,
+			  struct cmd_list_element *c, const char *value)
+{
+  fprintf_filtered (file, _("The index cache is %s.\n"), value);
+}
+
+/* The directory of the index cache.  An empty string or NULL disables
+   the cache.  */
+static char *index_cache_directory;
+static void
+show_index_cache_directory (struct ui_file *file, int from_tty,
+			    struct cmd_list_element *c, const char *value)
+{
+  fprintf_filtered (file,
+		    _("The directory of the index cache is \"%s\".\n"),
+		    value);
+}
+
+/* Return the name of the index cache file for OBJFILE, or NULL if the
+   cache is disabled or OBJFILE can not be cached.  The caller must
+   xfree the result.
+
+   Files with a build ID are keyed by it.  Other files are keyed by
+   their name, size and modification time, so that rebuilding a file
+   makes its old entry unreachable.  */
+
+static char *
+index_cache_file_name (struct objfile *objfile)
+{
+  bfd *abfd = objfile->obfd;
+  struct stat st;
+
+  if (!index_cache_enabled
+      || index_cache_directory == NULL || *index_cache_directory == '\0')
+    return NULL;
+
+  if (bfd_get_flavour (abfd) == bfd_target_elf_flavour
+      && elf_tdata (abfd)->build_id != NULL)
+    {
+      bfd_size_type i, size = elf_tdata (abfd)->build_id_size;
+      char *hex = alloca (2 * size + 1);
+
+      for (i = 0; i < size; i++)
+	sprintf (hex + 2 * i, "%02x",
+		 (unsigned int) elf_tdata (abfd)->build_id[i]);
+      hex[2 * size] = '\0';
+
+      return concat (index_cache_directory, SLASH_STRING, hex,
+		     INDEX_SUFFIX, (char *) NULL);
+    }
+
+  if (stat (objfile->name, &st) < 0)
+    return NULL;
+
+  return xstrprintf ("%s%s%s-%08lx-%lx-%lx%s", index_cache_directory,
+		     SLASH_STRING, lbasename (objfile->name),
+		     (unsigned long) htab_hash_string (objfile->name),
+		     (unsigned long) st.st_size,
+		     (unsigned long) st.st_mtime, INDEX_SUFFIX);
+}
+
+/* A type unit of .debug_types, as index_cache_types_valid_p expects
+   to find it in the types CU list of an index.  */
+
+struct index_cache_type_unit
+{
+  ULONGEST signature;
+  unsigned int offset;
+  unsigned int type_offset;
+
+  /* Nonzero if the types CU list has an entry for this unit.  */
+  int seen;
+};
+
+static hashval_t
+hash_index_cache_type_unit (const void *item)
+{
+  const struct index_cache_type_unit *unit = item;
+
+  return unit->signature;
+}
+
+static int
+eq_index_cache_type_unit (const void *item_lhs, const void *item_rhs)
+{
+  const struct index_cache_type_unit *lhs = item_lhs;
+  const struct index_cache_type_unit *rhs = item_rhs;
+
+  return lhs->signature == rhs->signature;
+}
+
+/* Return 1 if the types CU list from TYPES_LIST to TYPES_LIST_END
+   has one entry for each type unit of .debug_types of OBJFILE, as
+   create_debug_types_hash_table finds them.  */
+
+static int
+index_cache_types_valid_p (struct objfile *objfile,
+			   const gdb_byte *types_list,
+			   const gdb_byte *types_list_end)
+{
+  struct dwarf2_section_info *section;
+  struct cleanup *cleanup;
+  gdb_byte *info_ptr, *end_ptr;
+  htab_t units;
+  int valid = 1;
+  size_t count = 0;
+
+  if ((types_list_end - types_list) % 24 != 0)
+    return 0;
+
+  /* read_index_from_buffer only handles a single .debug_types
+     section.  */
+  if (VEC_empty (dwarf2_section_info_def, dwarf2_per_objfile->types))
+    return types_list == types_list_end;
+  if (VEC_length (dwarf2_section_info_def, dwarf2_per_objfile->types) != 1)
+    return 0;
+
+  section = VEC_index (dwarf2_section_info_def, dwarf2_per_objfile->types, 0);
+  dwarf2_read_section (objfile, section);
+  if (section->buffer == NULL)
+    return types_list == types_list_end;
+
+  units = htab_create_alloc (41, hash_index_cache_type_unit,
+			     eq_index_cache_type_unit, xfree,
+			     xcalloc, xfree);
+  cleanup = make_cleanup_htab_delete (units);
+
+  info_ptr = section->buffer;
+  end_ptr = info_ptr + section->size;
+  while (info_ptr < end_ptr)
+    {
+      struct index_cache_type_unit unit, **slot;
+      unsigned int length, initial_length_size, offset_size;
+      gdb_byte *ptr = info_ptr;
+
+      length = read_initial_length (objfile->obfd, ptr,
+				    &initial_length_size);
+      if (ptr + length + initial_length_size > end_ptr)
+	break;
+
+      offset_size = initial_length_size == 4 ? 4 : 8;
+      ptr += initial_length_size;
+      ptr += 2; /* version */
+      ptr += offset_size; /* abbrev offset */
+      ptr += 1; /* address size */
+      unit.signature = bfd_get_64 (objfile->obfd, ptr);
+      ptr += 8;
+      unit.type_offset = read_offset_1 (objfile->obfd, ptr, offset_size);
+      ptr += offset_size;
+      unit.offset = info_ptr - section->buffer;
+      unit.seen = 0;
+
+      info_ptr += initial_length_size + length;
+
+      /* Dummy type units are not indexed.  */
+      if (ptr >= end_ptr || peek_abbrev_code (objfile->obfd, ptr) == 0)
+	continue;
+
+      /* Of units with the same signature, the last one is indexed.  */
+      slot = (struct index_cache_type_unit **) htab_find_slot (units, &unit,
+							       INSERT);
+      if (*slot == NULL)
+	*slot = XNEW (struct index_cache_type_unit);
+      **slot = unit;
+    }
+
+  for (; valid && types_list < types_list_end; types_list += 24)
+    {
+      struct index_cache_type_unit key, *unit;
+
+      key.signature = extract_unsigned_integer (types_list + 16, 8,
+						BFD_ENDIAN_LITTLE);
+      unit = htab_find (units, &key);
+      if (unit == NULL
+	  || unit->seen
+	  || unit->offset != extract_unsigned_integer (types_list, 8,
+						       BFD_ENDIAN_LITTLE)
+	  || unit->type_offset != extract_unsigned_integer (types_list + 8, 8,
+							    BFD_ENDIAN_LITTLE))
+	valid = 0;
+      else
+	{
+	  unit->seen = 1;
+	  count++;
+	}
+    }
+
+  if (count != htab_elements (units))
+    valid = 0;
+
+  do_cleanups (cleanup);
+  return valid;
+}
+
+/* Return 1 if the SIZE bytes at ADDR look like an index for the
+   .debug_info and .debug_types of OBJFILE.  A .gdb_index section
+   comes with the DWARF it describes, but a cached index has to be
+   checked: it must be well-formed, its CU list must cover .debug_info
+   exactly, and its types CU list must list the type units of
+   .debug_types.  */
+
+static int
+index_cache_valid_p (struct objfile *objfile, const gdb_byte *addr,
+		     offset_type size)
+{
+  const offset_type *metadata = (const offset_type *) addr;
+  offset_type prev = 6 * sizeof (offset_type);
+  const gdb_byte *cu_list, *cu_list_end;
+  ULONGEST next_offset = 0;
+  int i;
+
+  if (size < prev)
+    return 0;
+
+  for (i = 1; i < 6; i++)
+    {
+      offset_type val = MAYBE_SWAP (metadata[i]);
+
+      if (val < prev || val > size)
+	return 0;
+      prev = val;
+    }
+
+  cu_list = addr + MAYBE_SWAP (metadata[1]);
+  cu_list_end = addr + MAYBE_SWAP (metadata[2]);
+  if ((cu_list_end - cu_list) % 16 != 0)
+    return 0;
+
+  dwarf2_read_section (objfile, &dwarf2_per_objfile->info);
+  for (; cu_list < cu_list_end; cu_list += 16)
+    {
+      if (extract_unsigned_integer (cu_list, 8, BFD_ENDIAN_LITTLE)
+	  != next_offset)
+	return 0;
+      next_offset += extract_unsigned_integer (cu_list + 8, 8,
+					       BFD_ENDIAN_LITTLE);
+    }
+
+  if (next_offset != dwarf2_per_objfile->info.size)
+    return 0;
+
+  return index_cache_types_valid_p (objfile,
+				    addr + MAYBE_SWAP (metadata[2]),
+				    addr + MAYBE_SWAP (metadata[3]));
+}
+
+/* Like dwarf2_read_index, but read the index of OBJFILE from the
+   index cache.  Entries that turn out to be unusable are removed, so
+   that dwarf2_save_cached_index writes them anew.  */
+
+static int
+dwarf2_read_cached_index (struct objfile *objfile)
+{
+  struct dwarf2_section_info *section = &dwarf2_per_objfile->gdb_index;
+  char *filename;
+  struct stat st;
+  gdb_byte *addr;
+  int fd, ok, have_st;
+
+  /* An unusable .gdb_index section would be preferred again next time,
+     so caching an index for the file does not help.  */
+  if (!dwarf2_section_empty_p (section))
+    return 0;
+
+  filename = index_cache_file_name (objfile);
+  if (filename == NULL)
+    return 0;
+
+  fd = open (filename, O_RDONLY | O_BINARY);
+  if (fd < 0)
+    {
+      xfree (filename);
+      return 0;
+    }
+
+  have_st = fstat (fd, &st) == 0;
+  if (!have_st || st.st_size != (offset_type) st.st_size)
+    addr = NULL;
+  else
+    {
+#ifdef HAVE_MMAP
+      addr = mmap (NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if ((void *) addr == MAP_FAILED)
+	addr = NULL;
+      else
+	{
+	  /* The mapping is released with the sections in
+	     dwarf2_per_objfile_free.  */
+	  section->map_addr = addr;
+	  section->map_len = st.st_size;
+	}
+#else
+      addr = obstack_alloc (&objfile->objfile_obstack, st.st_size);
+      if (read (fd, addr, st.st_size) != st.st_size)
+	addr = NULL;
+#endif
+    }
+  close (fd);
+
+  ok = (addr != NULL
+	&& index_cache_valid_p (objfile, addr, st.st_size)
+	&& read_index_from_buffer (objfile, addr, st.st_size));
+  if (ok)
+    {
+      section->buffer = addr;
+      section->size = st.st_size;
+      section->readin = 1;
+    }
+  else
+    {
+      struct stat now;
+
+      munmap_section_buffer (section);
+      section->map_addr = NULL;
+      section->map_len = 0;
+
+      /* Another GDB may have renamed a fresh index over the file
+	 meanwhile; only remove the one we read.  */
+      if (have_st
+	  && stat (filename, &now) == 0
+	  && now.st_dev == st.st_dev
+	  && now.st_ino == st.st_ino)
+	unlink (filename);
+    }
+
+  xfree (filename);
+  return ok;
+}
+
 /* A helper for the "quick" functions which sets the global
    dwarf2_per_objfile according to OBJFILE.  */
 
@@ -2957,6 +3366,9 @@ dwarf2_initialize_objfile (struct objfile *objfile)
   if (dwarf2_read_index (objfile))
     return 1;
 
+  if (dwarf2_read_cached_index (objfile))
+    return 1;
+
   return 0;
 }
 
@@ -2967,12 +3379,18 @@ dwarf2_initialize_objfile (struct objfile *objfile)
 void
 dwarf2_build_psymtabs (struct objfile *objfile)
 {
+  /* An index can only describe DWARF; see elf_symfile_read.  */
+  int other_psymtabs = objfile->psymtabs != NULL;
+
   if (objfile->global_psymbols.size == 0 && objfile->static_psymbols.size == 0)
     {
       init_psymbol_list (objfile, 1024);
     }
 
   dwarf2_build_psymtabs_hard (objfile);
+
+  if (!other_psymtabs)
+    dwarf2_save_cached_index (objfile);
 }
 
 /* Return TRUE if OFFSET is within CU_HEADER.  */
@@ -3398,53 +3816,96 @@ dwarf2_find_base_address (struct die_info *die, struct dwarf2_cu *cu)
     }
 }
 
+/* The part of process_psymtab_comp_unit that reads the compilation
+   unit at INFO_PTR into CU, which init_one_comp_unit has set up: its
+   header, abbrevs, compilation unit DIE and partial DIEs.  The results
+   go to LOAD.
+   BUFFER is a pointer to the beginning of the dwarf section buffer,
+   either .debug_info or debug_types.
+
+   This only changes CU, so worker threads call it too, with
+   CU->LOADED_BY_WORKER set.  It returns zero if a worker thread has to
+   leave the unit to the main thread, and non-zero otherwise.  */
+
+static int
+load_psymtab_comp_unit (struct psymtab_cu_load *load, struct dwarf2_cu *cu,
+			gdb_byte *buffer, gdb_byte *info_ptr,
+			unsigned int buffer_size)
+{
+  bfd *abfd = cu->objfile->obfd;
+  int is_debug_types = cu->per_cu->debug_types_section != NULL;
+  struct die_reader_specs reader_specs;
+
+  memset (load, 0, sizeof (*load));
+  load->cu = cu;
+
+  info_ptr = partial_read_comp_unit_head (&cu->header, info_ptr,
+					  buffer, buffer_size,
+					  abfd, is_debug_types);
+
+  /* Skip dummy compilation units.  */
+  if (info_ptr >= buffer + buffer_size
+      || peek_abbrev_code (abfd, info_ptr) == 0)
+    return 1;
+
+  cu->list_in_scope = &file_symbols;
+
+  /* Read the abbrevs for this compilation unit into a table.  */
+  dwarf2_read_abbrevs (abfd, cu);
+
+  /* Read the compilation unit die.  */
+  init_cu_die_reader (&reader_specs, cu);
+  info_ptr = read_full_die (&reader_specs, &load->comp_unit_die, info_ptr,
+			    &load->has_children);
+
+  if (!is_debug_types && load->comp_unit_die->tag == DW_TAG_partial_unit)
+    return 1;
+
+  prepare_one_comp_unit (cu, load->comp_unit_die);
+
+  /* read_partial_die calls set_main_name for Fortran.  */
+  if (cu->loaded_by_worker && cu->language == language_fortran)
+    return 0;
+
+  /* Check if comp unit has_children.
+     If so, read the rest of the partial symbols from this comp unit.
+     If not, there's no more debug_info for this comp unit.  */
+  if (load->has_children)
+    load->first_die = load_partial_dies (abfd, buffer, info_ptr, 1, cu);
+
+  load->info_ptr = info_ptr;
+  return 1;
+}
+
 /* Subroutine of process_type_comp_unit and dwarf2_build_psymtabs_hard
    to combine the common parts.
    Process a compilation unit for a psymtab.
    BUFFER is a pointer to the beginning of the dwarf section buffer,
    either .debug_info or debug_types.
    INFO_PTR is a pointer to the start of the CU.
+   PRELOADED, if not NULL, is the unit as already loaded by a worker
+   thread; this function takes ownership of its CU.
    Returns a pointer to the next CU.  */
 
 static gdb_byte *
 process_psymtab_comp_unit (struct objfile *objfile,
 			   struct dwarf2_per_cu_data *this_cu,
 			   gdb_byte *buffer, gdb_byte *info_ptr,
-			   unsigned int buffer_size)
+			   unsigned int buffer_size,
+			   struct psymtab_cu_load *preloaded)
 {
-  bfd *abfd = objfile->obfd;
   gdb_byte *beg_of_comp_unit = info_ptr;
   struct die_info *comp_unit_die;
   struct partial_symtab *pst;
   CORE_ADDR baseaddr;
   struct cleanup *back_to_inner;
-  struct dwarf2_cu cu;
-  int has_children, has_pc_info;
+  struct dwarf2_cu stack_cu, *cu;
+  struct psymtab_cu_load load;
+  int has_pc_info;
   struct attribute *attr;
   CORE_ADDR best_lowpc = 0, best_highpc = 0;
-  struct die_reader_specs reader_specs;
   const char *filename;
 
-  init_one_comp_unit (&cu, objfile);
-  back_to_inner = make_cleanup (free_stack_comp_unit, &cu);
-
-  info_ptr = partial_read_comp_unit_head (&cu.header, info_ptr,
-					  buffer, buffer_size,
-					  abfd,
-					  this_cu->debug_types_section != NULL);
-
-  /* Skip dummy compilation units.  */
-  if (info_ptr >= buffer + buffer_size
-      || peek_abbrev_code (abfd, info_ptr) == 0)
-    {
-      info_ptr = (beg_of_comp_unit + cu.header.length
-		  + cu.header.initial_length_size);
-      do_cleanups (back_to_inner);
-      return info_ptr;
-    }
-
-  cu.list_in_scope = &file_symbols;
-
   /* If this compilation unit was already read in, free the
      cached copy in order to read it in again.	This is
      necessary because we skipped some symbols when we first
@@ -3454,40 +3915,63 @@ process_psymtab_comp_unit (struct objfile *objfile,
   if (this_cu->cu != NULL)
     free_one_cached_comp_unit (this_cu->cu);
 
-  /* Note that this is a pointer to our stack frame, being
-     added to a global data structure.	It will be cleaned up
-     in free_stack_comp_unit when we finish with this
-     compilation unit.	*/
-  this_cu->cu = &cu;
-  cu.per_cu = this_cu;
+  if (preloaded != NULL)
+    {
+      load = *preloaded;
+      cu = load.cu;
+      back_to_inner = make_cleanup (xfree, cu);
+      make_cleanup (free_stack_comp_unit, cu);
+    }
+  else
+    {
+      cu = &stack_cu;
+      init_one_comp_unit (cu, objfile);
+      back_to_inner = make_cleanup (free_stack_comp_unit, cu);
+      cu->per_cu = this_cu;
+    }
+  make_cleanup (dwarf2_free_abbrev_table, cu);
 
-  /* Read the abbrevs for this compilation unit into a table.  */
-  dwarf2_read_abbrevs (abfd, &cu);
-  make_cleanup (dwarf2_free_abbrev_table, &cu);
+  if (preloaded == NULL)
+    load_psymtab_comp_unit (&load, cu, buffer, info_ptr, buffer_size);
 
-  /* Read the compilation unit die.  */
-  init_cu_die_reader (&reader_specs, &cu);
-  info_ptr = read_full_die (&reader_specs, &comp_unit_die, info_ptr,
-			    &has_children);
+  info_ptr = (beg_of_comp_unit + cu->header.length
+	      + cu->header.initial_length_size);
+
+  if (load.info_ptr == NULL)
+    {
+      /* The unit is not linked from THIS_CU yet.  */
+      cu->per_cu = NULL;
+      do_cleanups (back_to_inner);
+      return info_ptr;
+    }
+  comp_unit_die = load.comp_unit_die;
+
+  /* Note that this is a pointer to our stack frame (or to a unit loaded
+     by a worker thread), being added to a global data structure.  It
+     will be cleaned up in free_stack_comp_unit when we finish with this
+     compilation unit.  */
+  this_cu->cu = cu;
+  cu->per_cu = this_cu;
 
   if (this_cu->debug_types_section)
     {
       /* LENGTH has not been set yet for type units.  */
-      gdb_assert (this_cu->offset == cu.header.offset);
-      this_cu->length = cu.header.length + cu.header.initial_length_size;
+      gdb_assert (this_cu->offset == cu->header.offset);
+      this_cu->length = cu->header.length + cu->header.initial_length_size;
     }
-  else if (comp_unit_die->tag == DW_TAG_partial_unit)
+
+  if (cu->loaded_by_worker)
     {
-      info_ptr = (beg_of_comp_unit + cu.header.length
-		  + cu.header.initial_length_size);
-      do_cleanups (back_to_inner);
-      return info_ptr;
+      if (cu->language == language_cplus)
+	{
+	  canonicalize_partial_die_names (cu->early_psymbol_dies, cu);
+	  canonicalize_partial_die_names (load.first_die, cu);
+	}
+      cu->loaded_by_worker = 0;
     }
 
-  prepare_one_comp_unit (&cu, comp_unit_die);
-
   /* Allocate a new partial symbol table structure.  */
-  attr = dwarf2_attr (comp_unit_die, DW_AT_name, &cu);
+  attr = dwarf2_attr (comp_unit_die, DW_AT_name, cu);
   if (attr == NULL || !DW_STRING (attr))
     filename = "";
   else
@@ -3500,7 +3984,7 @@ process_psymtab_comp_unit (struct objfile *objfile,
 			      objfile->static_psymbols.next);
   pst->psymtabs_addrmap_supported = 1;
 
-  attr = dwarf2_attr (comp_unit_die, DW_AT_comp_dir, &cu);
+  attr = dwarf2_attr (comp_unit_die, DW_AT_comp_dir, cu);
   if (attr != NULL)
     pst->dirname = DW_STRING (attr);
 
@@ -3513,12 +3997,12 @@ process_psymtab_comp_unit (struct objfile *objfile,
 
   this_cu->v.psymtab = pst;
 
-  dwarf2_find_base_address (comp_unit_die, &cu);
+  dwarf2_find_base_address (comp_unit_die, cu);
 
   /* Possibly set the default values of LOWPC and HIGHPC from
      `DW_AT_ranges'.  */
   has_pc_info = dwarf2_get_pc_bounds (comp_unit_die, &best_lowpc,
-				      &best_highpc, &cu, pst);
+				      &best_highpc, cu, pst);
   if (has_pc_info == 1 && best_lowpc < best_highpc)
     /* Store the contiguous range if it is not empty; it can be empty for
        CUs with no code.  */
@@ -3526,21 +4010,17 @@ process_psymtab_comp_unit (struct objfile *objfile,
 		       best_lowpc + baseaddr,
 		       best_highpc + baseaddr - 1, pst);
 
-  /* Check if comp unit has_children.
-     If so, read the rest of the partial symbols from this comp unit.
-     If not, there's no more debug_info for this comp unit.  */
-  if (has_children)
+  add_early_partial_symbols (cu);
+
+  if (load.has_children)
     {
-      struct partial_die_info *first_die;
       CORE_ADDR lowpc, highpc;
 
       lowpc = ((CORE_ADDR) -1);
       highpc = ((CORE_ADDR) 0);
 
-      first_die = load_partial_dies (abfd, buffer, info_ptr, 1, &cu);
-
-      scan_partial_symbols (first_die, &lowpc, &highpc,
-			    ! has_pc_info, &cu);
+      scan_partial_symbols (load.first_die, &lowpc, &highpc,
+			    ! has_pc_info, cu);
 
       /* If we didn't find a lowpc, set it to highpc to avoid
 	 complaints from `maint check'.	 */
@@ -3564,9 +4044,6 @@ process_psymtab_comp_unit (struct objfile *objfile,
     (objfile->static_psymbols.list + pst->statics_offset);
   sort_pst_symbols (pst);
 
-  info_ptr = (beg_of_comp_unit + cu.header.length
-	      + cu.header.initial_length_size);
-
   if (this_cu->debug_types_section)
     {
       /* It's not clear we want to do anything with stmt lists here.
@@ -3576,7 +4053,7 @@ process_psymtab_comp_unit (struct objfile *objfile,
     {
       /* Get the list of files included in the current compilation unit,
 	 and build a psymtab for each of them.  */
-      dwarf2_build_include_psymtabs (&cu, comp_unit_die, pst);
+      dwarf2_build_include_psymtabs (cu, comp_unit_die, pst);
     }
 
   do_cleanups (back_to_inner);
@@ -3601,7 +4078,7 @@ process_type_comp_unit (void **slot, void *info)
 			     this_cu->debug_types_section->buffer,
 			     (this_cu->debug_types_section->buffer
 			      + this_cu->offset),
-			     this_cu->debug_types_section->size);
+			     this_cu->debug_types_section->size, NULL);
 
   return 1;
 }
@@ -3619,6 +4096,316 @@ build_type_psymtabs (struct objfile *objfile)
 			  process_type_comp_unit, objfile);
 }
 
+#ifdef DWARF2_WORKER_THREADS
+
+/* Worker threads that load the partial DIEs of the compilation units
+   in .debug_info ahead of dwarf2_build_psymtabs_hard, which still
+   creates every psymtab itself, in order.  Workers only write to the
+   dwarf2_cu of their own unit, so the objfile, its obstacks and the
+   psymbol lists are only touched by the main thread.
+
+   A worker can not report anything: if a complaint, warning or error
+   happens in a worker thread, thread_problem_hook abandons the unit
+   and the main thread loads it again itself, and reports the problem
+   then.  */
+
+/* The states of a unit in struct psymtab_workers.  */
+
+enum psymtab_preload_state
+{
+  /* Nobody has started on the unit yet.  */
+  PRELOAD_PENDING,
+
+  /* A worker thread is loading the unit.  */
+  PRELOAD_RUNNING,
+
+  /* The unit is loaded; LOAD is valid.  */
+  PRELOAD_DONE,
+
+  /* The main thread must load the unit itself.  */
+  PRELOAD_FAILED
+};
+
+struct psymtab_preload
+{
+  struct dwarf2_per_cu_data *per_cu;
+  enum psymtab_preload_state state;
+  struct psymtab_cu_load load;
+};
+
+struct psymtab_workers
+{
+  /* MUTEX protects everything below, except the fields that are set
+     before the threads start.  COND is signalled whenever a unit is
+     finished or taken.  */
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+
+  struct objfile *objfile;
+
+  /* One entry for each unit of dwarf2_per_objfile->all_comp_units.  */
+  struct psymtab_preload *units;
+  int n_units;
+
+  /* The next unit for a worker, and the number of units the main
+     thread has taken.  Workers stay at most WINDOW units ahead of the
+     main thread, to bound the memory used by loaded units.  */
+  int next_unit;
+  int consumed;
+  int window;
+
+  /* Set when the threads should exit.  */
+  int stop;
+
+  int n_threads;
+  pthread_t *threads;
+};
+
+/* In a worker thread, the jmp_buf to return to if the unit must be
+   abandoned.  NULL in the main thread.  */
+static pthread_key_t psymtab_worker_key;
+
+/* The thread_problem_hook while workers run.  */
+
+static void
+abort_psymtab_worker (void)
+{
+  jmp_buf *abort_buf = pthread_getspecific (psymtab_worker_key);
+
+  if (abort_buf != NULL)
+    longjmp (*abort_buf, 1);
+}
+
+/* Free a compilation unit loaded by a worker thread.  */
+
+static void
+free_preloaded_comp_unit (struct dwarf2_cu *cu)
+{
+  dwarf2_free_abbrev_table (cu);
+  obstack_free (&cu->comp_unit_obstack, NULL);
+  xfree (cu);
+}
+
+/* Load UNIT in a worker thread.  Return non-zero on success.  */
+
+static int
+preload_comp_unit (struct psymtab_workers *w, struct psymtab_preload *unit)
+{
+  struct dwarf2_per_cu_data *per_cu = unit->per_cu;
+  struct dwarf2_cu *volatile cu = NULL;
+  jmp_buf abort_buf;
+  int ok;
+
+  pthread_setspecific (psymtab_worker_key, &abort_buf);
+  if (setjmp (abort_buf) == 0)
+    {
+      cu = xmalloc (sizeof (*cu));
+      init_one_comp_unit (cu, w->objfile);
+      cu->per_cu = per_cu;
+      cu->loaded_by_worker = 1;
+      ok = load_psymtab_comp_unit (&unit->load, cu,
+				   dwarf2_per_objfile->info.buffer,
+				   (dwarf2_per_objfile->info.buffer
+				    + per_cu->offset),
+				   dwarf2_per_objfile->info.size);
+    }
+  else
+    ok = 0;
+  pthread_setspecific (psymtab_worker_key, NULL);
+
+  if (!ok && cu != NULL)
+    free_preloaded_comp_unit (cu);
+  return ok;
+}
+
+/* The body of a worker thread.  */
+
+static void *
+psymtab_worker (void *arg)
+{
+  struct psymtab_workers *w = arg;
+
+  pthread_mutex_lock (&w->mutex);
+  while (1)
+    {
+      struct psymtab_preload *unit;
+      int ok;
+
+      while (!w->stop && w->next_unit < w->n_units
+	     && w->next_unit >= w->consumed + w->window)
+	pthread_cond_wait (&w->cond, &w->mutex);
+      if (w->stop || w->next_unit >= w->n_units)
+	break;
+
+      unit = &w->units[w->next_unit++];
+      if (unit->state != PRELOAD_PENDING)
+	continue;
+      unit->state = PRELOAD_RUNNING;
+      pthread_mutex_unlock (&w->mutex);
+
+      ok = preload_comp_unit (w, unit);
+
+      pthread_mutex_lock (&w->mutex);
+      unit->state = ok ? PRELOAD_DONE : PRELOAD_FAILED;
+      pthread_cond_broadcast (&w->cond);
+    }
+  pthread_mutex_unlock (&w->mutex);
+
+  return NULL;
+}
+
+/* Start the worker threads for the compilation units of OBJFILE, or
+   return NULL if there should be none.  */
+
+static struct psymtab_workers *
+start_psymtab_workers (struct objfile *objfile)
+{
+  struct psymtab_workers *w;
+  int i, n_threads = dwarf2_worker_threads;
+  sigset_t all_signals, old_signals;
+
+  if (n_threads < 0)
+    {
+#ifdef _SC_NPROCESSORS_ONLN
+      n_threads = sysconf (_SC_NPROCESSORS_ONLN) - 1;
+#else
+      n_threads = 0;
+#endif
+    }
+  if (n_threads > dwarf2_per_objfile->n_comp_units - 1)
+    n_threads = dwarf2_per_objfile->n_comp_units - 1;
+  if (n_threads <= 0)
+    return NULL;
+
+  /* Read the sections the workers need now; dwarf2_read_section is
+     not thread-safe.  */
+  dwarf2_read_section (objfile, &dwarf2_per_objfile->abbrev);
+  dwarf2_read_section (objfile, &dwarf2_per_objfile->str);
+
+  w = XZALLOC (struct psymtab_workers);
+  pthread_mutex_init (&w->mutex, NULL);
+  pthread_cond_init (&w->cond, NULL);
+  w->objfile = objfile;
+  w->n_units = dwarf2_per_objfile->n_comp_units;
+  w->units = XCALLOC (w->n_units, struct psymtab_preload);
+  for (i = 0; i < w->n_units; i++)
+    w->units[i].per_cu = dwarf2_per_objfile->all_comp_units[i];
+  w->window = 4 * n_threads;
+  w->threads = XCALLOC (n_threads, pthread_t);
+
+  thread_problem_hook = abort_psymtab_worker;
+
+  /* Signals must keep going to the main thread.  */
+  sigfillset (&all_signals);
+  pthread_sigmask (SIG_BLOCK, &all_signals, &old_signals);
+  for (i = 0; i < n_threads; i++)
+    {
+      if (pthread_create (&w->threads[w->n_threads], NULL,
+			  psymtab_worker, w) == 0)
+	w->n_threads++;
+    }
+  pthread_sigmask (SIG_SETMASK, &old_signals, NULL);
+
+  return w;
+}
+
+/* A cleanup function that stops the worker threads in ARG, which may
+   be NULL, and frees the units nobody took.  */
+
+static void
+stop_psymtab_workers (void *arg)
+{
+  struct psymtab_workers *w = arg;
+  int i;
+
+  if (w == NULL)
+    return;
+
+  pthread_mutex_lock (&w->mutex);
+  w->stop = 1;
+  pthread_cond_broadcast (&w->cond);
+  pthread_mutex_unlock (&w->mutex);
+
+  for (i = 0; i < w->n_threads; i++)
+    pthread_join (w->threads[i], NULL);
+
+  for (i = w->consumed; i < w->n_units; i++)
+    if (w->units[i].state == PRELOAD_DONE)
+      free_preloaded_comp_unit (w->units[i].load.cu);
+
+  thread_problem_hook = NULL;
+
+  pthread_cond_destroy (&w->cond);
+  pthread_mutex_destroy (&w->mutex);
+  xfree (w->threads);
+  xfree (w->units);
+  xfree (w);
+}
+
+/* Take THIS_CU, the next unit for dwarf2_build_psymtabs_hard, from
+   the workers W, waiting for it if a worker is still loading it.
+   Return non-zero and fill in LOAD if a worker loaded it; return zero
+   if the main thread must load it itself.  */
+
+static int
+take_preloaded_comp_unit (struct psymtab_workers *w,
+			  struct dwarf2_per_cu_data *this_cu,
+			  struct psymtab_cu_load *load)
+{
+  struct psymtab_preload *unit;
+  int ok;
+
+  pthread_mutex_lock (&w->mutex);
+  gdb_assert (w->consumed < w->n_units);
+  unit = &w->units[w->consumed];
+  gdb_assert (unit->per_cu == this_cu);
+
+  if (unit->state == PRELOAD_PENDING)
+    unit->state = PRELOAD_FAILED;
+  while (unit->state == PRELOAD_RUNNING)
+    {
+      struct timeval now;
+      struct timespec deadline;
+
+      /* Wake up now and then to let the user interrupt us.  */
+      gettimeofday (&now, NULL);
+      deadline.tv_sec = now.tv_sec;
+      deadline.tv_nsec = now.tv_usec * 1000 + 100000000;
+      if (deadline.tv_nsec >= 1000000000)
+	{
+	  deadline.tv_sec++;
+	  deadline.tv_nsec -= 1000000000;
+	}
+      pthread_cond_timedwait (&w->cond, &w->mutex, &deadline);
+
+      if (unit->state == PRELOAD_RUNNING)
+	{
+	  pthread_mutex_unlock (&w->mutex);
+	  QUIT;
+	  pthread_mutex_lock (&w->mutex);
+	}
+    }
+
+  ok = unit->state == PRELOAD_DONE;
+  if (ok)
+    *load = unit->load;
+  w->consumed++;
+  pthread_cond_broadcast (&w->cond);
+  pthread_mutex_unlock (&w->mutex);
+
+  /* The main thread may have needed all the DIEs of this unit since
+     the worker loaded it.  */
+  if (ok && this_cu->load_all_dies)
+    {
+      free_preloaded_comp_unit (load->cu);
+      ok = 0;
+    }
+
+  return ok;
+}
+
+#endif /* DWARF2_WORKER_THREADS */
+
 /* A cleanup function that clears objfile's psymtabs_addrmap field.  */
 
 static void
@@ -3638,6 +4425,10 @@ dwarf2_build_psymtabs_hard (struct objfile *objfile)
   gdb_byte *info_ptr;
   struct cleanup *back_to, *addrmap_cleanup;
   struct obstack temp_obstack;
+#ifdef DWARF2_WORKER_THREADS
+  struct psymtab_workers *workers;
+  struct cleanup *workers_cleanup;
+#endif
 
   dwarf2_per_objfile->reading_partial_symbols = 1;
 
@@ -3659,6 +4450,11 @@ dwarf2_build_psymtabs_hard (struct objfile *objfile)
   objfile->psymtabs_addrmap = addrmap_create_mutable (&temp_obstack);
   addrmap_cleanup = make_cleanup (psymtabs_addrmap_cleanup, objfile);
 
+#ifdef DWARF2_WORKER_THREADS
+  workers = start_psymtab_workers (objfile);
+  workers_cleanup = make_cleanup (stop_psymtab_workers, workers);
+#endif
+
   /* Since the objects we're extracting from .debug_info vary in
      length, only the individual functions to extract them (like
      read_comp_unit_head and load_partial_die) can really know whether
@@ -3677,17 +4473,29 @@ dwarf2_build_psymtabs_hard (struct objfile *objfile)
 		     + dwarf2_per_objfile->info.size))
     {
       struct dwarf2_per_cu_data *this_cu;
+      struct psymtab_cu_load load, *preloaded = NULL;
 
       this_cu = dwarf2_find_comp_unit (info_ptr
 				       - dwarf2_per_objfile->info.buffer,
 				       objfile);
 
+#ifdef DWARF2_WORKER_THREADS
+      if (workers != NULL && take_preloaded_comp_unit (workers, this_cu,
+						       &load))
+	preloaded = &load;
+#endif
+
       info_ptr = process_psymtab_comp_unit (objfile, this_cu,
 					    dwarf2_per_objfile->info.buffer,
 					    info_ptr,
-					    dwarf2_per_objfile->info.size);
+					    dwarf2_per_objfile->info.size,
+					    preloaded);
     }
 
+#ifdef DWARF2_WORKER_THREADS
+  do_cleanups (workers_cleanup);
+#endif
+
   objfile->psymtabs_addrmap = addrmap_create_fixed (objfile->psymtabs_addrmap,
 						    &objfile->objfile_obstack);
   discard_cleanups (addrmap_cleanup);
@@ -9480,6 +10288,9 @@ dwarf2_free_abbrev_table (void *ptr_to_cu)
 {
   struct dwarf2_cu *cu = ptr_to_cu;
 
+  if (cu->dwarf2_abbrevs == NULL)
+    return;
+
   obstack_free (&cu->abbrev_obstack, NULL);
   cu->dwarf2_abbrevs = NULL;
 }
@@ -9537,6 +10348,79 @@ is_type_tag_for_partial (int tag)
     }
 }
 
+/* Remember partial DIE PDI, whose partial symbol load_partial_dies adds
+   without keeping the DIE itself, for add_early_partial_symbols.  The
+   symbol can not be added yet, as the psymtab has not been started.  */
+
+static void
+add_early_psymbol_die (struct partial_die_info *pdi, struct dwarf2_cu *cu)
+{
+  struct partial_die_info *copy;
+
+  copy = obstack_copy (&cu->comp_unit_obstack, pdi, sizeof (*pdi));
+  copy->die_sibling = NULL;
+
+  if (cu->last_early_psymbol_die != NULL)
+    cu->last_early_psymbol_die->die_sibling = copy;
+  else
+    cu->early_psymbol_dies = copy;
+  cu->last_early_psymbol_die = copy;
+}
+
+/* Add the partial symbols of the DIEs set aside by
+   add_early_psymbol_die.  These are simple top-level types and
+   enumerators.  */
+
+static void
+add_early_partial_symbols (struct dwarf2_cu *cu)
+{
+  struct partial_die_info *pdi;
+
+  for (pdi = cu->early_psymbol_dies; pdi != NULL; pdi = pdi->die_sibling)
+    {
+      if (pdi->tag == DW_TAG_enumerator)
+	add_psymbol_to_list (pdi->name, strlen (pdi->name), 0,
+			     VAR_DOMAIN, LOC_CONST,
+			     (cu->language == language_cplus
+			      || cu->language == language_java)
+			     ? &cu->objfile->global_psymbols
+			     : &cu->objfile->static_psymbols,
+			     0, (CORE_ADDR) 0, cu->language, cu->objfile);
+      else
+	add_psymbol_to_list (pdi->name, strlen (pdi->name), 0,
+			     VAR_DOMAIN, LOC_TYPEDEF,
+			     &cu->objfile->static_psymbols,
+			     0, (CORE_ADDR) 0, cu->language, cu->objfile);
+    }
+}
+
+/* Canonicalize the names of partial DIE PDI, its siblings and their
+   children, which a worker thread loaded with the names as found; see
+   read_partial_die.  */
+
+static void
+canonicalize_partial_die_names (struct partial_die_info *pdi,
+				struct dwarf2_cu *cu)
+{
+  for (; pdi != NULL; pdi = pdi->die_sibling)
+    {
+      switch (pdi->tag)
+	{
+	case DW_TAG_compile_unit:
+	case DW_TAG_type_unit:
+	case DW_TAG_enumeration_type:
+	case DW_TAG_enumerator:
+	  break;
+	default:
+	  pdi->name = dwarf2_canonicalize_name (pdi->name, cu,
+						&cu->objfile->objfile_obstack);
+	  break;
+	}
+
+      canonicalize_partial_die_names (pdi->die_child, cu);
+    }
+}
+
 /* Load all DIEs that are interesting for partial symbols into memory.  */
 
 static struct partial_die_info *
@@ -9554,7 +10438,10 @@ load_partial_dies (bfd *abfd, gdb_byte *buffer, gdb_byte *info_ptr,
   parent_die = NULL;
   last_die = NULL;
 
-  if (cu->per_cu && cu->per_cu->load_all_dies)
+  /* The main thread may set LOAD_ALL_DIES while a worker thread loads
+     the unit, so workers leave it alone; dwarf2_build_psymtabs_hard
+     loads the unit again if it was set.  */
+  if (!cu->loaded_by_worker && cu->per_cu && cu->per_cu->load_all_dies)
     load_all = 1;
 
   cu->partial_dies
@@ -9668,10 +10555,7 @@ load_partial_dies (bfd *abfd, gdb_byte *buffer, gdb_byte *info_ptr,
 	      || part_die->tag == DW_TAG_subrange_type))
 	{
 	  if (building_psymtab && part_die->name != NULL)
-	    add_psymbol_to_list (part_die->name, strlen (part_die->name), 0,
-				 VAR_DOMAIN, LOC_TYPEDEF,
-				 &cu->objfile->static_psymbols,
-				 0, (CORE_ADDR) 0, cu->language, cu->objfile);
+	    add_early_psymbol_die (part_die, cu);
 	  info_ptr = locate_pdi_sibling (part_die, buffer, info_ptr, abfd, cu);
 	  continue;
 	}
@@ -9704,13 +10588,7 @@ load_partial_dies (bfd *abfd, gdb_byte *buffer, gdb_byte *info_ptr,
 	    complaint (&symfile_complaints,
 		       _("malformed enumerator DIE ignored"));
 	  else if (building_psymtab)
-	    add_psymbol_to_list (part_die->name, strlen (part_die->name), 0,
-				 VAR_DOMAIN, LOC_CONST,
-				 (cu->language == language_cplus
-				  || cu->language == language_java)
-				 ? &cu->objfile->global_psymbols
-				 : &cu->objfile->static_psymbols,
-				 0, (CORE_ADDR) 0, cu->language, cu->objfile);
+	    add_early_psymbol_die (part_die, cu);
 
 	  info_ptr = locate_pdi_sibling (part_die, buffer, info_ptr, abfd, cu);
 	  continue;
@@ -9811,6 +10689,18 @@ load_partial_dies (bfd *abfd, gdb_byte *buffer, gdb_byte *info_ptr,
     }
 }
 
+/* If a worker thread is loading CU, give up on it now.  Call this
+   before building the arguments of a complaint with functions that
+   are not thread-safe, such as paddress; thread_problem_hook would
+   only be reached after them.  */
+
+static void
+leave_worker_unit (struct dwarf2_cu *cu)
+{
+  if (cu->loaded_by_worker && thread_problem_hook != NULL)
+    thread_problem_hook ();
+}
+
 /* Read a minimal amount of information into the minimal die structure.  */
 
 static gdb_byte *
@@ -9859,9 +10749,14 @@ read_partial_die (struct partial_die_info *part_die,
 	      part_die->name = DW_STRING (&attr);
 	      break;
 	    default:
-	      part_die->name
-		= dwarf2_canonicalize_name (DW_STRING (&attr), cu,
-					    &cu->objfile->objfile_obstack);
+	      /* Worker threads can not allocate on the objfile
+		 obstack; see canonicalize_partial_die_names.  */
+	      if (cu->loaded_by_worker)
+		part_die->name = DW_STRING (&attr);
+	      else
+		part_die->name
+		  = dwarf2_canonicalize_name (DW_STRING (&attr), cu,
+					      &cu->objfile->objfile_obstack);
 	      break;
 	    }
 	  break;
@@ -9967,8 +10862,10 @@ read_partial_die (struct partial_die_info *part_die,
 	 so that GDB will ignore it.  */
       if (part_die->lowpc == 0 && !dwarf2_per_objfile->has_section_at_zero)
 	{
-	  struct gdbarch *gdbarch = get_objfile_arch (cu->objfile);
+	  struct gdbarch *gdbarch;
 
+	  leave_worker_unit (cu);
+	  gdbarch = get_objfile_arch (cu->objfile);
 	  complaint (&symfile_complaints,
 		     _("DW_AT_low_pc %s is zero "
 		       "for DIE at 0x%x [in module %s]"),
@@ -9978,8 +10875,10 @@ read_partial_die (struct partial_die_info *part_die,
       /* dwarf2_get_pc_bounds has also the strict low < high requirement.  */
       else if (part_die->lowpc >= part_die->highpc)
 	{
-	  struct gdbarch *gdbarch = get_objfile_arch (cu->objfile);
+	  struct gdbarch *gdbarch;
 
+	  leave_worker_unit (cu);
+	  gdbarch = get_objfile_arch (cu->objfile);
 	  complaint (&symfile_complaints,
 		     _("DW_AT_low_pc %s is not < DW_AT_high_pc %s "
 		       "for DIE at 0x%x [in module %s]"),
@@ -10378,6 +11277,7 @@ read_attribute_value (struct attribute *attr, unsigned form,
       && form == DW_FORM_data4
       && DW_UNSND (attr) >= 0xffffffff)
     {
+      leave_worker_unit (cu);
       complaint
         (&symfile_complaints,
          _("Suspicious DW_AT_byte_size value treated as zero instead of %s"),
@@ -16986,13 +17886,13 @@ write_one_signatured_type (void **slot, void *d)
   return 1;
 }
 
-/* Create an index file for OBJFILE in the directory DIR.  */
+/* Write an index file for OBJFILE to FILENAME.  */
 
 static void
-write_psymtabs_to_index (struct objfile *objfile, const char *dir)
+write_psymtabs_to_index (struct objfile *objfile, const char *filename)
 {
   struct cleanup *cleanup;
-  char *filename, *cleanup_filename;
+  char *cleanup_filename;
   struct obstack contents, addr_obstack, constant_pool, symtab_obstack;
   struct obstack cu_list, types_cu_list;
   int i;
@@ -17017,16 +17917,12 @@ write_psymtabs_to_index (struct objfile *objfile, const char *dir)
   if (stat (objfile->name, &st) < 0)
     perror_with_name (objfile->name);
 
-  filename = concat (dir, SLASH_STRING, lbasename (objfile->name),
-		     INDEX_SUFFIX, (char *) NULL);
-  cleanup = make_cleanup (xfree, filename);
-
   out_file = fopen (filename, "wb");
   if (!out_file)
     error (_("Can't open `%s' for writing"), filename);
 
-  cleanup_filename = filename;
-  make_cleanup (unlink_if_set, &cleanup_filename);
+  cleanup_filename = (char *) filename;
+  cleanup = make_cleanup (unlink_if_set, &cleanup_filename);
 
   symtab = create_mapped_symtab ();
   make_cleanup (cleanup_mapped_symtab, symtab);
@@ -17196,10 +18092,14 @@ save_gdb_index_command (char *arg, int from_tty)
       {
 	volatile struct gdb_exception except;
 
+	char *filename = concat (arg, SLASH_STRING, lbasename (objfile->name),
+				 INDEX_SUFFIX, (char *) NULL);
+
 	TRY_CATCH (except, RETURN_MASK_ERROR)
 	  {
-	    write_psymtabs_to_index (objfile, arg);
+	    write_psymtabs_to_index (objfile, filename);
 	  }
+	xfree (filename);
 	if (except.reason < 0)
 	  exception_fprintf (gdb_stderr, except,
 			     _("Error while writing index for `%s': "),
@@ -17209,6 +18109,111 @@ save_gdb_index_command (char *arg, int from_tty)
 }
 
 
+/* Create DIR and any missing parent directories.  */
+
+static void
+make_index_cache_directory (const char *dir)
+{
+  char *copy = alloca (strlen (dir) + 1);
+  char *p;
+
+  strcpy (copy, dir);
+  for (p = copy + 1; ; p++)
+    if (*p == '\0' || IS_DIR_SEPARATOR (*p))
+      {
+	char c = *p;
+
+	*p = '\0';
+#ifdef _WIN32
+	mkdir (copy);
+#else
+	mkdir (copy, 0700);
+#endif
+	if (c == '\0')
+	  break;
+	*p = c;
+      }
+}
+
+/* Write the index of OBJFILE to the index cache file FILENAME.  The
+   index is written to a temporary file first, so that concurrent GDBs
+   never see a partial index.  Errors are ignored.  */
+
+static void
+write_cached_index (struct objfile *objfile, const char *filename)
+{
+  char *tmp = xstrprintf ("%s.%ld", filename, (long) getpid ());
+  volatile struct gdb_exception except;
+
+  TRY_CATCH (except, RETURN_MASK_ALL)
+    {
+      make_index_cache_directory (index_cache_directory);
+      write_psymtabs_to_index (objfile, tmp);
+      if (rename (tmp, filename) < 0)
+	unlink (tmp);
+    }
+  xfree (tmp);
+}
+
+/* Save the index of OBJFILE, whose partial symbols have just been
+   read, in the index cache unless it is already there.  */
+
+static void
+dwarf2_save_cached_index (struct objfile *objfile)
+{
+  struct partial_symbol **psym;
+  struct stat st;
+  char *filename;
+
+  if (!dwarf2_section_empty_p (&dwarf2_per_objfile->gdb_index))
+    return;
+
+  /* Indices do not work for Ada yet.  */
+  for (psym = objfile->global_psymbols.list;
+       psym < objfile->global_psymbols.next;
+       psym++)
+    if (SYMBOL_LANGUAGE (*psym) == language_ada)
+      return;
+  for (psym = objfile->static_psymbols.list;
+       psym < objfile->static_psymbols.next;
+       psym++)
+    if (SYMBOL_LANGUAGE (*psym) == language_ada)
+      return;
+
+  filename = index_cache_file_name (objfile);
+  if (filename == NULL)
+    return;
+
+  if (stat (filename, &st) == 0)
+    {
+      xfree (filename);
+      return;
+    }
+
+#ifdef HAVE_WORKING_FORK
+  {
+    pid_t pid;
+
+    /* Writing the index of a big program takes a while; leave it to a
+       grandchild, which has a copy of the partial symbols and which
+       init reaps.  */
+    pid = fork ();
+    if (pid == 0)
+      {
+	if (fork () == 0)
+	  write_cached_index (objfile, filename);
+	_exit (0);
+      }
+    else if (pid > 0)
+      waitpid (pid, NULL, 0);
+  }
+#else
+  write_cached_index (objfile, filename);
+#endif
+
+  xfree (filename);
+}
+
 
 int dwarf2_always_disassemble;
 
@@ -17237,10 +18242,15 @@ void
 _initialize_dwarf2_read (void)
 {
   struct cmd_list_element *c;
+  char *cache_home, *home;
 
   dwarf2_objfile_data_key
     = register_objfile_data_with_cleanup (NULL, dwarf2_per_objfile_free);
 
+#ifdef DWARF2_WORKER_THREADS
+  pthread_key_create (&psymtab_worker_key, NULL);
+#endif
+
   add_prefix_cmd ("dwarf2", class_maintenance, set_dwarf2_cmd, _("\
 Set DWARF 2 specific variables.\n\
 Configure DWARF 2 variables such as the cache size"),
@@ -17265,6 +18275,18 @@ caching, which can slow down startup."),
 			    &set_dwarf2_cmdlist,
 			    &show_dwarf2_cmdlist);
 
+  add_setshow_zinteger_cmd ("worker-threads", class_obscure,
+			    &dwarf2_worker_threads, _("\
+Set the number of threads loading dwarf2 partial DIEs."), _("\
+Show the number of threads loading dwarf2 partial DIEs."), _("\
+While partial symbol tables are built, this many threads decode the\n\
+DWARF of the compilation units ahead of GDB.  Zero, the default, disables\n\
+the threads; -1 uses one thread less than the number of processors."),
+			    NULL,
+			    show_dwarf2_worker_threads,
+			    &set_dwarf2_cmdlist,
+			    &show_dwarf2_cmdlist);
+
   add_setshow_boolean_cmd ("always-disassemble", class_obscure,
 			   &dwarf2_always_disassemble, _("\
 Set whether `info address' always disassembles DWARF expressions."), _("\
@@ -17294,6 +18316,37 @@ the demangler."),
 			   NULL, show_check_physname,
 			   &setdebuglist, &showdebuglist);
 
+  add_setshow_boolean_cmd ("index-cache", class_files,
+			   &index_cache_enabled, _("\
+Set whether GDB keeps an index cache."), _("\
+Show whether GDB keeps an index cache."), _("\
+When on, GDB saves an index of each symbol file without a .gdb_index\n\
+section in the index cache directory, as `save gdb-index' would, and\n\
+reads the index from there when the file is loaded again.  Each index\n\
+is written by a background copy of GDB.  Off by default."),
+			   NULL,
+			   show_index_cache_enabled,
+			   &setlist, &showlist);
+
+  cache_home = getenv ("XDG_CACHE_HOME");
+  home = getenv ("HOME");
+  if (cache_home != NULL && *cache_home != '\0')
+    index_cache_directory = concat (cache_home, SLASH_STRING "gdb",
+				    (char *) NULL);
+  else if (home != NULL && *home != '\0')
+    index_cache_directory = concat (home,
+				    SLASH_STRING ".cache" SLASH_STRING "gdb",
+				    (char *) NULL);
+  add_setshow_optional_filename_cmd ("index-cache-directory", class_files,
+				     &index_cache_directory, _("\
+Set the directory of the index cache."), _("\
+Show the directory of the index cache."), _("\
+The default is $XDG_CACHE_HOME/gdb, or ~/.cache/gdb if XDG_CACHE_HOME\n\
+is not set.  An empty directory disables the index cache."),
+				     NULL,
+				     show_index_cache_directory,
+				     &setlist, &showlist);
+
   c = add_cmd ("gdb-index", class_files, save_gdb_index_command,
 	       _("\
 Save a gdb-index file.\n\
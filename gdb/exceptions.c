@@ -66,6 +66,9 @@ struct catcher
 /* Where to go for throw_exception().  */
 static struct catcher *current_catcher;
 
+/* See exceptions.h.  */
+void (*thread_problem_hook) (void);
+
 EXCEPTIONS_SIGJMP_BUF *
 exceptions_state_mc_init (volatile struct gdb_exception *exception,
 			  return_mask mask)
@@ -205,6 +208,9 @@ exceptions_state_mc_action_iter_1 (void)
 void
 throw_exception (struct gdb_exception exception)
 {
+  if (thread_problem_hook != NULL)
+    thread_problem_hook ();
+
   quit_flag = 0;
   immediate_quit = 0;
 
@@ -364,6 +370,9 @@ throw_it (enum return_reason reason, enum errors error, const char *fmt,
   struct gdb_exception e;
   char *new_message;
 
+  if (thread_problem_hook != NULL)
+    thread_problem_hook ();
+
   /* Save the message.  Create the new message before deleting the
      old, the new message may include the old message text.  */
   new_message = xstrvprintf (fmt, ap);
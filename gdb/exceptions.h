@@ -187,6 +187,14 @@ extern void throw_error (enum errors error, const char *fmt, ...)
 extern void deprecated_throw_reason (enum return_reason reason)
      ATTRIBUTE_NORETURN;
 
+/* If non-NULL, called before an exception is thrown and before a
+   warning or complaint is printed.  The catchers, cleanups and output
+   streams involved all belong to GDB's main thread, so code that runs
+   GDB functions in helper threads installs a hook that gets the helper
+   thread out before it touches any of them.  The hook must return
+   normally when called from the main thread.  */
+extern void (*thread_problem_hook) (void);
+
 /* Call FUNC(UIOUT, FUNC_ARGS) but wrapped within an exception
    handler.  If an exception (enum return_reason) is thrown using
    throw_exception() than all cleanups installed since
@@ -32,16 +32,89 @@ struct thread_info *current_inferior;
 #define get_thread(inf) ((struct thread_info *)(inf))
 #define get_dll(inf) ((struct dll_info *)(inf))
 
+/* The number of buckets a list's hash table starts out with.  */
+#define INFERIOR_LIST_MIN_BUCKETS 16
+
+/* Return the key entries with ID are hashed under: the lwp if ID has
+   one, and the pid otherwise.  Hashing threads and lwps by lwp alone
+   lets find_inferior_lwp look them up without knowing the pid.  */
+
+static unsigned int
+inferior_id_key (ptid_t id)
+{
+  long lwp = ptid_get_lwp (id);
+
+  return lwp != 0 ? lwp : ptid_get_pid (id);
+}
+
+/* Return the bucket of LIST entries with KEY hash to.  */
+
+static struct inferior_list_entry **
+inferior_list_bucket (struct inferior_list *list, unsigned int key)
+{
+  /* Thread ids are mostly consecutive; multiplicative hashing spreads
+     them over the table.  */
+  return &list->buckets[(key * 2654435761u) & (list->nbuckets - 1)];
+}
+
+static void
+inferior_list_hash_insert (struct inferior_list *list,
+			   struct inferior_list_entry *entry)
+{
+  struct inferior_list_entry **slot
+    = inferior_list_bucket (list, inferior_id_key (entry->id));
+
+  entry->hash_next = *slot;
+  if (*slot != NULL)
+    (*slot)->hash_pprev = &entry->hash_next;
+  entry->hash_pprev = slot;
+  *slot = entry;
+}
+
+static void
+inferior_list_hash_remove (struct inferior_list_entry *entry)
+{
+  *entry->hash_pprev = entry->hash_next;
+  if (entry->hash_next != NULL)
+    entry->hash_next->hash_pprev = entry->hash_pprev;
+}
+
+/* Resize the hash table of LIST to NBUCKETS buckets, and rehash all
+   its entries.  */
+
+static void
+inferior_list_rehash (struct inferior_list *list, int nbuckets)
+{
+  struct inferior_list_entry *inf;
+
+  free (list->buckets);
+  list->buckets = xcalloc (nbuckets, sizeof (list->buckets[0]));
+  list->nbuckets = nbuckets;
+
+  for (inf = list->head; inf != NULL; inf = inf->next)
+    inferior_list_hash_insert (list, inf);
+}
+
 void
 add_inferior_to_list (struct inferior_list *list,
 		      struct inferior_list_entry *new_inferior)
 {
   new_inferior->next = NULL;
+  new_inferior->prev = list->tail;
   if (list->tail != NULL)
     list->tail->next = new_inferior;
   else
     list->head = new_inferior;
   list->tail = new_inferior;
+
+  /* Keep the load factor at or below one.  */
+  list->count++;
+  if (list->count > list->nbuckets)
+    inferior_list_rehash (list, (list->nbuckets != 0
+				 ? list->nbuckets * 2
+				 : INFERIOR_LIST_MIN_BUCKETS));
+  else
+    inferior_list_hash_insert (list, new_inferior);
 }
 
 /* Invoke ACTION for each inferior in LIST.  */
@@ -64,27 +137,33 @@ void
 remove_inferior (struct inferior_list *list,
 		 struct inferior_list_entry *entry)
 {
-  struct inferior_list_entry **cur;
+  /* Not in LIST.  */
+  if (entry->prev == NULL && list->head != entry)
+    return;
 
-  if (list->head == entry)
-    {
-      list->head = entry->next;
-      if (list->tail == entry)
-	list->tail = list->head;
-      return;
-    }
+  if (entry->prev != NULL)
+    entry->prev->next = entry->next;
+  else
+    list->head = entry->next;
 
-  cur = &list->head;
-  while (*cur && (*cur)->next != entry)
-    cur = &(*cur)->next;
+  if (entry->next != NULL)
+    entry->next->prev = entry->prev;
+  else
+    list->tail = entry->prev;
 
-  if (*cur == NULL)
-    return;
+  entry->next = entry->prev = NULL;
+
+  inferior_list_hash_remove (entry);
+  list->count--;
+}
 
-  (*cur)->next = entry->next;
+/* Empty LIST, without freeing the entries.  */
 
-  if (list->tail == entry)
-    list->tail = *cur;
+void
+clear_inferior_list (struct inferior_list *list)
+{
+  free (list->buckets);
+  memset (list, 0, sizeof (*list));
 }
 
 void
@@ -110,14 +189,8 @@ add_thread (ptid_t thread_id, void *target_data)
 ptid_t
 thread_id_to_gdb_id (ptid_t thread_id)
 {
-  struct inferior_list_entry *inf = all_threads.head;
-
-  while (inf != NULL)
-    {
-      if (ptid_equal (inf->id, thread_id))
-	return thread_id;
-      inf = inf->next;
-    }
+  if (find_inferior_id (&all_threads, thread_id) != NULL)
+    return thread_id;
 
   return null_ptid;
 }
@@ -131,17 +204,7 @@ thread_to_gdb_id (struct thread_info *thread)
 struct thread_info *
 find_thread_ptid (ptid_t ptid)
 {
-  struct inferior_list_entry *inf = all_threads.head;
-
-  while (inf != NULL)
-    {
-      struct thread_info *thread = get_thread (inf);
-      if (ptid_equal (thread->entry.id, ptid))
-	return thread;
-      inf = inf->next;
-    }
-
-  return NULL;
+  return get_thread (find_inferior_id (&all_threads, ptid));
 }
 
 ptid_t
@@ -192,14 +255,36 @@ find_inferior (struct inferior_list *list,
 struct inferior_list_entry *
 find_inferior_id (struct inferior_list *list, ptid_t id)
 {
-  struct inferior_list_entry *inf = list->head;
+  struct inferior_list_entry *inf;
 
-  while (inf != NULL)
-    {
-      if (ptid_equal (inf->id, id))
-	return inf;
-      inf = inf->next;
-    }
+  if (list->buckets == NULL)
+    return NULL;
+
+  for (inf = *inferior_list_bucket (list, inferior_id_key (id));
+       inf != NULL;
+       inf = inf->hash_next)
+    if (ptid_equal (inf->id, id))
+      return inf;
+
+  return NULL;
+}
+
+/* Find the entry in LIST whose id has lwp LWP, or, for entries with no
+   lwp, pid LWP.  Return NULL if there is none.  */
+
+struct inferior_list_entry *
+find_inferior_lwp (struct inferior_list *list, int lwp)
+{
+  struct inferior_list_entry *inf;
+
+  if (list->buckets == NULL)
+    return NULL;
+
+  for (inf = *inferior_list_bucket (list, lwp);
+       inf != NULL;
+       inf = inf->hash_next)
+    if (inferior_id_key (inf->id) == (unsigned int) lwp)
+      return inf;
 
   return NULL;
 }
@@ -308,17 +393,14 @@ unloaded_dll (const char *name, CORE_ADDR base_addr)
     }
 }
 
-#define clear_list(LIST) \
-  do { (LIST)->head = (LIST)->tail = NULL; } while (0)
-
 void
 clear_inferiors (void)
 {
   for_each_inferior (&all_threads, free_one_thread);
   for_each_inferior (&all_dlls, free_one_dll);
 
-  clear_list (&all_threads);
-  clear_list (&all_dlls);
+  clear_inferior_list (&all_threads);
+  clear_inferior_list (&all_dlls);
 
   current_inferior = NULL;
 }
@@ -271,6 +271,7 @@ linux_add_process (int pid, int attached)
 
   proc = add_process (pid, attached);
   proc->private = xcalloc (1, sizeof (*proc->private));
+  proc->private->mem_fd = -1;
 
   if (the_low_target.new_process != NULL)
     proc->private->arch_private = the_low_target.new_process ();
@@ -982,6 +983,8 @@ linux_mourn (struct process_info *process)
 
   /* Freeing all private data.  */
   priv = process->private;
+  if (priv->mem_fd != -1)
+    close (priv->mem_fd);
   free (priv->arch_private);
   free (priv);
   process->private = NULL;
@@ -1041,10 +1044,9 @@ status_pending_p_callback (struct inferior_list_entry *entry, void *arg)
   return lwp->status_pending_p;
 }
 
-static int
-same_lwp (struct inferior_list_entry *entry, void *data)
+struct lwp_info *
+find_lwp_pid (ptid_t ptid)
 {
-  ptid_t ptid = *(ptid_t *) data;
   int lwp;
 
   if (ptid_get_lwp (ptid) != 0)
@@ -1052,16 +1054,7 @@ same_lwp (struct inferior_list_entry *entry, void *data)
   else
     lwp = ptid_get_pid (ptid);
 
-  if (ptid_get_lwp (entry->id) == lwp)
-    return 1;
-
-  return 0;
-}
-
-struct lwp_info *
-find_lwp_pid (ptid_t ptid)
-{
-  return (struct lwp_info*) find_inferior (&all_lwps, same_lwp, &ptid);
+  return (struct lwp_info *) find_inferior_lwp (&all_lwps, lwp);
 }
 
 static struct lwp_info *
@@ -1359,7 +1352,7 @@ Checking whether LWP %ld needs to move out of the jump pad...it does\n",
 
 	      /* Cancel any fast tracepoint lock this thread was
 		 holding.  */
-	      force_unlock_trace_buffer ();
+	      force_unlock_trace_buffer (status.thread_area);
 	    }
 
 	  if (lwp->exit_jump_pad_bkpt != NULL)
@@ -2376,7 +2369,9 @@ Check if we're already there.\n",
 		   || event_child->stopped_by_watchpoint
 		   || (!step_over_finished
 		       && !bp_explains_trap && !trace_event)
-		   || gdb_breakpoint_here (event_child->stop_pc));
+		   || (gdb_breakpoint_here (event_child->stop_pc)
+		       && gdb_condition_true_at_breakpoint
+			    (event_child->stop_pc)));
 
   /* We found no reason GDB would want us to stop.  We either hit one
      of our own breakpoints, or finished an internal step GDB
@@ -3239,8 +3234,10 @@ need_step_over_p (struct inferior_list_entry *entry, void *dummy)
   if (breakpoint_here (pc) || fast_tracepoint_jump_here (pc))
     {
       /* Don't step over a breakpoint that GDB expects to hit
-	 though.  */
-      if (gdb_breakpoint_here (pc))
+	 though.  If its conditions are all false, GDB doesn't expect
+	 to hear about it, so step over it like over our own.  */
+      if (gdb_breakpoint_here (pc)
+	  && gdb_condition_true_at_breakpoint (pc))
 	{
 	  if (debug_threads)
 	    fprintf (stderr,
@@ -4049,55 +4046,108 @@ linux_store_registers (struct regcache *regcache, int regno)
 }
 
 
-/* Copy LEN bytes from inferior's memory starting at MEMADDR
-   to debugger memory starting at MYADDR.  */
+/* Return a file descriptor open on the memory of the current
+   inferior's process, or -1 if /proc/PID/mem can't be opened.  The
+   descriptor is cached in the process, and is closed when the process
+   is mourned.  */
 
 static int
-linux_read_memory (CORE_ADDR memaddr, unsigned char *myaddr, int len)
+linux_proc_mem_fd (void)
 {
-  register int i;
-  /* Round starting address down to longword boundary.  */
-  register CORE_ADDR addr = memaddr & -(CORE_ADDR) sizeof (PTRACE_XFER_TYPE);
-  /* Round ending address up; get number of longwords that makes.  */
-  register int count
-    = (((memaddr + len) - addr) + sizeof (PTRACE_XFER_TYPE) - 1)
-      / sizeof (PTRACE_XFER_TYPE);
-  /* Allocate buffer of that many longwords.  */
-  register PTRACE_XFER_TYPE *buffer
-    = (PTRACE_XFER_TYPE *) alloca (count * sizeof (PTRACE_XFER_TYPE));
-  int fd;
-  char filename[64];
-  int pid = lwpid_of (get_thread_lwp (current_inferior));
+  struct process_info_private *priv = current_process ()->private;
 
-  /* Try using /proc.  Don't bother for one word.  */
-  if (len >= 3 * sizeof (long))
+  if (priv->mem_fd == -1)
     {
-      /* We could keep this file open and cache it - possibly one per
-	 thread.  That requires some juggling, but is even faster.  */
+      char filename[64];
+      int pid = lwpid_of (get_thread_lwp (current_inferior));
+
       sprintf (filename, "/proc/%d/mem", pid);
-      fd = open (filename, O_RDONLY | O_LARGEFILE);
+      priv->mem_fd = open (filename, O_RDWR | O_LARGEFILE);
+      if (priv->mem_fd == -1)
+	priv->mem_fd = open (filename, O_RDONLY | O_LARGEFILE);
+      if (priv->mem_fd != -1)
+	fcntl (priv->mem_fd, F_SETFD, FD_CLOEXEC);
+    }
+
+  return priv->mem_fd;
+}
+
+/* Transfer LEN bytes between MYADDR and the inferior's memory at
+   MEMADDR through /proc/PID/mem.  Reads if READING is non-zero,
+   writes otherwise.  Returns 0 on success, -1 on failure; the caller then
+   falls back to ptrace.  */
+
+static int
+linux_proc_xfer_memory (CORE_ADDR memaddr, unsigned char *myaddr, int len,
+			int reading)
+{
+  int fd, tries;
+  ssize_t ret = -1;
+
+  for (tries = 0; tries < 2; tries++)
+    {
+      fd = linux_proc_mem_fd ();
       if (fd == -1)
-	goto no_proc;
+	return -1;
 
       /* If pread64 is available, use it.  It's faster if the kernel
 	 supports it (only one syscall), and it's 64-bit safe even on
 	 32-bit platforms (for instance, SPARC debugging a SPARC64
 	 application).  */
+      if (reading)
+	{
 #ifdef HAVE_PREAD64
-      if (pread64 (fd, myaddr, len, memaddr) != len)
+	  ret = pread64 (fd, myaddr, len, memaddr);
 #else
-      if (lseek (fd, memaddr, SEEK_SET) == -1 || read (fd, myaddr, len) != len)
+	  ret = (lseek (fd, memaddr, SEEK_SET) == -1
+		 ? -1 : read (fd, myaddr, len));
 #endif
+	}
+      else
 	{
-	  close (fd);
-	  goto no_proc;
+#ifdef HAVE_PWRITE64
+	  ret = pwrite64 (fd, myaddr, len, memaddr);
+#else
+	  ret = (lseek (fd, memaddr, SEEK_SET) == -1
+		 ? -1 : write (fd, myaddr, len));
+#endif
 	}
 
+      /* A descriptor opened before the process exec'd no longer
+	 refers to a live address space, and transfers nothing.  We
+	 don't trace exec events, so reopen the file and retry.  */
+      if (ret != 0 || len == 0)
+	break;
       close (fd);
-      return 0;
+      current_process ()->private->mem_fd = -1;
     }
 
- no_proc:
+  return ret == len ? 0 : -1;
+}
+
+/* Copy LEN bytes from inferior's memory starting at MEMADDR
+   to debugger memory starting at MYADDR.  */
+
+static int
+linux_read_memory (CORE_ADDR memaddr, unsigned char *myaddr, int len)
+{
+  register int i;
+  /* Round starting address down to longword boundary.  */
+  register CORE_ADDR addr = memaddr & -(CORE_ADDR) sizeof (PTRACE_XFER_TYPE);
+  /* Round ending address up; get number of longwords that makes.  */
+  register int count
+    = (((memaddr + len) - addr) + sizeof (PTRACE_XFER_TYPE) - 1)
+      / sizeof (PTRACE_XFER_TYPE);
+  /* Allocate buffer of that many longwords.  */
+  register PTRACE_XFER_TYPE *buffer
+    = (PTRACE_XFER_TYPE *) alloca (count * sizeof (PTRACE_XFER_TYPE));
+  int pid = lwpid_of (get_thread_lwp (current_inferior));
+
+  /* Try using /proc first; a single pread is much cheaper than a
+     PTRACE_PEEKTEXT per word.  */
+  if (linux_proc_xfer_memory (memaddr, myaddr, len, 1) == 0)
+    return 0;
+
   /* Read all the longwords */
   for (i = 0; i < count; i++, addr += sizeof (PTRACE_XFER_TYPE))
     {
@@ -4153,6 +4203,12 @@ linux_write_memory (CORE_ADDR memaddr, const unsigned char *myaddr, int len)
 	       val, (long)memaddr);
     }
 
+  /* Try writing through /proc first.  Kernels before 2.6.39 refuse
+     this, in which case we go on to poke the memory a word at a
+     time.  */
+  if (linux_proc_xfer_memory (memaddr, (unsigned char *) myaddr, len, 0) == 0)
+    return 0;
+
   /* Fill start and end extra bytes of buffer with existing memory data.  */
 
   errno = 0;
@@ -4694,6 +4750,14 @@ linux_supports_disable_randomization (void)
 #endif
 }
 
+static int
+linux_supports_conditional_breakpoints (void)
+{
+  /* When a condition is false, we step over the breakpoint and
+     resume, which is too fiddly with software single-step.  */
+  return can_hardware_single_step ();
+}
+
 /* Enumerate spufs IDs for process PID.  */
 static int
 spu_enumerate_spu_ids (long pid, unsigned char *buf, CORE_ADDR offset, int len)
@@ -5416,6 +5480,7 @@ static struct target_ops linux_target_ops = {
   linux_supports_disable_randomization,
   linux_get_min_fast_tracepoint_insn_len,
   linux_qxfer_libraries_svr4,
+  linux_supports_conditional_breakpoints,
 };
 
 static void
@@ -59,6 +59,10 @@ struct process_info_private
 
   /* &_r_debug.  0 if not yet determined.  -1 if no PT_DYNAMIC in Phdrs.  */
   CORE_ADDR r_debug;
+
+  /* A file descriptor open on /proc/PID/mem, or -1 if not opened
+     yet.  */
+  int mem_fd;
 };
 
 struct lwp_info;
@@ -1089,6 +1089,14 @@ x86_linux_process_qsupported (const char *query)
   x86_linux_update_xmltarget ();
 }
 
+/* The callee-saved registers, which GDB needs to unwind past the
+   innermost frame.  Only the ones in the current target description
+   are used.  */
+
+static const char *x86_unwind_regs[] =
+  { "rbx", "rbp", "r12", "r13", "r14", "r15",
+    "ebx", "ebp", "esi", "edi", NULL };
+
 /* Initialize gdbserver for the architecture of the inferior.  */
 
 static void
@@ -1100,6 +1108,11 @@ x86_arch_setup (void)
   int use_64bit = elf_64_file_p (file);
 
   free (file);
+#endif
+
+  gdbserver_unwind_regs = x86_unwind_regs;
+
+#ifdef __x86_64__
 
   if (use_64bit < 0)
     {
@@ -1235,23 +1248,44 @@ amd64_install_fast_tracepoint_jump_pad (CORE_ADDR tpoint, CORE_ADDR tpaddr,
   i += push_opcode (&buf[i], "48 89 44 24 08"); /* mov %rax,0x8(%rsp) */
   append_insns (&buildaddr, i, buf);
 
-  /* spin-lock.  */
+  /* Pick the collect lock of the thread's trace buffer segment, and
+     save its address in the spare slot after the collecting_t
+     object.  */
   i = 0;
+  i += push_opcode (&buf[i], "48 c1 e8");	/* shr $SHIFT,%rax */
+  buf[i++] = IPA_TRACE_SEGMENT_SHIFT;
+  i += push_opcode (&buf[i], "48 83 e0");	/* and $SEGMENTS-1,%rax */
+  buf[i++] = IPA_TRACE_SEGMENTS - 1;
+  i += push_opcode (&buf[i], "48 c1 e0");	/* shl $LOCK_SIZE_LOG2,%rax */
+  buf[i++] = IPA_COLLECT_LOCK_SIZE_LOG2;
   i += push_opcode (&buf[i], "48 be");		/* movl <lockaddr>,%rsi */
   memcpy (&buf[i], (void *) &lockaddr, 8);
   i += 8;
+  i += push_opcode (&buf[i], "48 01 c6");	/* add %rax,%rsi */
+  i += push_opcode (&buf[i], "48 89 74 24 10"); /* mov %rsi,0x10(%rsp) */
+  append_insns (&buildaddr, i, buf);
+
+  /* spin-lock.  While the lock is held, waiters spin reading it, and
+     only retry the locked cmpxchg once it looks free, so that threads
+     hitting tracepoints concurrently don't keep stealing the lock's
+     cache line from the collecting thread.  */
+  i = 0;
   i += push_opcode (&buf[i], "48 89 e1");       /* mov %rsp,%rcx */
-  i += push_opcode (&buf[i], "31 c0");		/* xor %eax,%eax */
+  i += push_opcode (&buf[i], "31 c0");		/* again: xor %eax,%eax */
   i += push_opcode (&buf[i], "f0 48 0f b1 0e"); /* lock cmpxchg %rcx,(%rsi) */
-  i += push_opcode (&buf[i], "48 85 c0");	/* test %rax,%rax */
-  i += push_opcode (&buf[i], "75 f4");		/* jne <again> */
-  append_insns (&buildaddr, i, buf);
+  i += push_opcode (&buf[i], "74 0a");		/* je <locked> */
+  i += push_opcode (&buf[i], "f3 90");		/* spin: pause */
+  i += push_opcode (&buf[i], "48 83 3e 00");	/* cmpq $0x0,(%rsi) */
+  i += push_opcode (&buf[i], "75 f8");		/* jne <spin> */
+  i += push_opcode (&buf[i], "eb ed");		/* jmp <again> */
+  append_insns (&buildaddr, i, buf);		/* locked: */
 
   /* Set up the gdb_collect call.  */
   /* At this point, (stack pointer + 0x18) is the base of our saved
      register block.  */
 
   i = 0;
+  i += push_opcode (&buf[i], "48 89 f2");	/* mov %rsi,%rdx */
   i += push_opcode (&buf[i], "48 89 e6");	/* mov %rsp,%rsi */
   i += push_opcode (&buf[i], "48 83 c6 18");	/* add $0x18,%rsi */
 
@@ -1272,10 +1306,8 @@ amd64_install_fast_tracepoint_jump_pad (CORE_ADDR tpoint, CORE_ADDR tpaddr,
 
   /* Clear the spin-lock.  */
   i = 0;
-  i += push_opcode (&buf[i], "31 c0");		/* xor %eax,%eax */
-  i += push_opcode (&buf[i], "48 a3");		/* mov %rax, lockaddr */
-  memcpy (buf + i, &lockaddr, 8);
-  i += 8;
+  i += push_opcode (&buf[i], "48 8b 74 24 10"); /* mov 0x10(%rsp),%rsi */
+  i += push_opcode (&buf[i], "48 c7 06 00 00 00 00"); /* movq $0x0,(%rsi) */
   append_insns (&buildaddr, i, buf);
 
   /* Remove stack that had been used for the collect_t object.  */
@@ -1380,9 +1412,10 @@ i386_install_fast_tracepoint_jump_pad (CORE_ADDR tpoint, CORE_ADDR tpaddr,
   buf[i++] = 0x0e; /* push %cs */
   append_insns (&buildaddr, i, buf);
 
-  /* Stack space for the collecting_t object.  */
+  /* Stack space for the collecting_t object, and the address of the
+     collect lock.  */
   i = 0;
-  i += push_opcode (&buf[i], "83 ec 08");	/* sub    $0x8,%esp */
+  i += push_opcode (&buf[i], "83 ec 10");	/* sub    $0x10,%esp */
 
   /* Build the object.  */
   i += push_opcode (&buf[i], "b8");		/* mov    <tpoint>,%eax */
@@ -1394,35 +1427,51 @@ i386_install_fast_tracepoint_jump_pad (CORE_ADDR tpoint, CORE_ADDR tpaddr,
   i += push_opcode (&buf[i], "89 44 24 04");	   /* mov %eax,0x4(%esp) */
   append_insns (&buildaddr, i, buf);
 
-  /* spin-lock.  Note this is using cmpxchg, which leaves i386 behind.
-     If we cared for it, this could be using xchg alternatively.  */
-
+  /* Pick the collect lock of the thread's trace buffer segment, and
+     save its address after the collecting_t object.  */
   i = 0;
-  i += push_opcode (&buf[i], "31 c0");		/* xor %eax,%eax */
-  i += push_opcode (&buf[i], "f0 0f b1 25");    /* lock cmpxchg
-						   %esp,<lockaddr> */
+  i += push_opcode (&buf[i], "c1 e8");		/* shr $SHIFT,%eax */
+  buf[i++] = IPA_TRACE_SEGMENT_SHIFT;
+  i += push_opcode (&buf[i], "83 e0");		/* and $SEGMENTS-1,%eax */
+  buf[i++] = IPA_TRACE_SEGMENTS - 1;
+  i += push_opcode (&buf[i], "c1 e0");		/* shl $LOCK_SIZE_LOG2,%eax */
+  buf[i++] = IPA_COLLECT_LOCK_SIZE_LOG2;
+  i += push_opcode (&buf[i], "8d 88");		/* lea <lockaddr>(%eax),%ecx */
   memcpy (&buf[i], (void *) &lockaddr, 4);
   i += 4;
-  i += push_opcode (&buf[i], "85 c0");		/* test %eax,%eax */
-  i += push_opcode (&buf[i], "75 f2");		/* jne <again> */
+  i += push_opcode (&buf[i], "89 4c 24 08");	/* mov %ecx,0x8(%esp) */
   append_insns (&buildaddr, i, buf);
 
+  /* spin-lock.  Note this is using cmpxchg, which leaves i386 behind.
+     If we cared for it, this could be using xchg alternatively.  As
+     on amd64, waiters spin reading the lock, and only retry the
+     cmpxchg once it looks free.  */
 
-  /* Set up arguments to the gdb_collect call.  */
   i = 0;
-  i += push_opcode (&buf[i], "89 e0");		/* mov %esp,%eax */
-  i += push_opcode (&buf[i], "83 c0 08");	/* add $0x08,%eax */
-  i += push_opcode (&buf[i], "89 44 24 fc");	/* mov %eax,-0x4(%esp) */
-  append_insns (&buildaddr, i, buf);
+  i += push_opcode (&buf[i], "31 c0");		/* again: xor %eax,%eax */
+  i += push_opcode (&buf[i], "f0 0f b1 21");    /* lock cmpxchg
+						   %esp,(%ecx) */
+  i += push_opcode (&buf[i], "74 09");		/* je <locked> */
+  i += push_opcode (&buf[i], "f3 90");		/* spin: pause */
+  i += push_opcode (&buf[i], "83 39 00");	/* cmpl $0x0,(%ecx) */
+  i += push_opcode (&buf[i], "75 f9");		/* jne <spin> */
+  i += push_opcode (&buf[i], "eb ef");		/* jmp <again> */
+  append_insns (&buildaddr, i, buf);		/* locked: */
+
 
+  /* Set up arguments to the gdb_collect call.  */
   i = 0;
-  i += push_opcode (&buf[i], "83 ec 08");	/* sub $0x8,%esp */
+  i += push_opcode (&buf[i], "89 e0");		/* mov %esp,%eax */
+  i += push_opcode (&buf[i], "83 c0 10");	/* add $0x10,%eax */
+  i += push_opcode (&buf[i], "83 ec 0c");	/* sub $0xc,%esp */
   append_insns (&buildaddr, i, buf);
 
   i = 0;
   i += push_opcode (&buf[i], "c7 04 24");       /* movl <addr>,(%esp) */
   memcpy (&buf[i], (void *) &tpoint, 4);
   i += 4;
+  i += push_opcode (&buf[i], "89 44 24 04");	/* mov %eax,0x4(%esp) */
+  i += push_opcode (&buf[i], "89 4c 24 08");	/* mov %ecx,0x8(%esp) */
   append_insns (&buildaddr, i, buf);
 
   buf[0] = 0xe8; /* call <reladdr> */
@@ -1430,25 +1479,23 @@ i386_install_fast_tracepoint_jump_pad (CORE_ADDR tpoint, CORE_ADDR tpaddr,
   memcpy (buf + 1, &offset, 4);
   append_insns (&buildaddr, 5, buf);
   /* Clean up after the call.  */
-  buf[0] = 0x83; /* add $0x8,%esp */
+  buf[0] = 0x83; /* add $0xc,%esp */
   buf[1] = 0xc4;
-  buf[2] = 0x08;
+  buf[2] = 0x0c;
   append_insns (&buildaddr, 3, buf);
 
 
   /* Clear the spin-lock.  This would need the LOCK prefix on older
      broken archs.  */
   i = 0;
-  i += push_opcode (&buf[i], "31 c0");		/* xor %eax,%eax */
-  i += push_opcode (&buf[i], "a3");		/* mov %eax, lockaddr */
-  memcpy (buf + i, &lockaddr, 4);
-  i += 4;
+  i += push_opcode (&buf[i], "8b 4c 24 08");	/* mov 0x8(%esp),%ecx */
+  i += push_opcode (&buf[i], "c7 01 00 00 00 00"); /* movl $0x0,(%ecx) */
   append_insns (&buildaddr, i, buf);
 
 
   /* Remove stack that had been used for the collect_t object.  */
   i = 0;
-  i += push_opcode (&buf[i], "83 c4 08");	/* add $0x08,%esp */
+  i += push_opcode (&buf[i], "83 c4 10");	/* add $0x10,%esp */
   append_insns (&buildaddr, i, buf);
 
   i = 0;
@@ -1706,25 +1753,122 @@ amd64_emit_sub (void)
 static void
 amd64_emit_mul (void)
 {
-  emit_error = 1;
+  EMIT_ASM (amd64_mul,
+	    "imul (%rsp),%rax\n\t"
+	    "lea 0x8(%rsp),%rsp");
 }
 
 static void
 amd64_emit_lsh (void)
 {
-  emit_error = 1;
+  EMIT_ASM (amd64_lsh,
+	    "mov %rax,%rcx\n\t"
+	    "pop %rax\n\t"
+	    "shl %cl,%rax");
 }
 
 static void
 amd64_emit_rsh_signed (void)
 {
-  emit_error = 1;
+  EMIT_ASM (amd64_rsh_signed,
+	    "mov %rax,%rcx\n\t"
+	    "pop %rax\n\t"
+	    "sar %cl,%rax");
 }
 
 static void
 amd64_emit_rsh_unsigned (void)
 {
-  emit_error = 1;
+  EMIT_ASM (amd64_rsh_unsigned,
+	    "mov %rax,%rcx\n\t"
+	    "pop %rax\n\t"
+	    "shr %cl,%rax");
+}
+
+/* Emit code to return ZERO_ERR from the compiled function if the top
+   of the stack, a divisor, is zero.  */
+
+static void
+amd64_emit_zero_divisor_check (int zero_err)
+{
+  unsigned char buf[16];
+  int i;
+  CORE_ADDR buildaddr = current_insn_ptr;
+
+  i = 0;
+  buf[i++] = 0x48; /* test %rax,%rax */
+  buf[i++] = 0x85;
+  buf[i++] = 0xc0;
+  buf[i++] = 0x75; /* jne .+7 */
+  buf[i++] = 0x07;
+  buf[i++] = 0xb8; /* mov $<zero_err>,%eax */
+  memcpy (&buf[i], &zero_err, sizeof (zero_err));
+  i += 4;
+  buf[i++] = 0xc9; /* leave */
+  buf[i++] = 0xc3; /* ret */
+  append_insns (&buildaddr, i, buf);
+  current_insn_ptr = buildaddr;
+}
+
+/* Dividing the most negative number by -1 traps, so the signed
+   division and remainder handle a divisor of -1 separately.  */
+
+static void
+amd64_emit_div_signed (int zero_err)
+{
+  amd64_emit_zero_divisor_check (zero_err);
+  EMIT_ASM (amd64_div_signed,
+	    "mov %rax,%rcx\n\t"
+	    "pop %rax\n\t"
+	    "cmp $-1,%rcx\n\t"
+	    "jne .Lamd64_div_signed_idiv\n\t"
+	    "neg %rax\n\t"
+	    "jmp .Lamd64_div_signed_end\n\t"
+	    ".Lamd64_div_signed_idiv:\n\t"
+	    "cqto\n\t"
+	    "idiv %rcx\n\t"
+	    ".Lamd64_div_signed_end:");
+}
+
+static void
+amd64_emit_div_unsigned (int zero_err)
+{
+  amd64_emit_zero_divisor_check (zero_err);
+  EMIT_ASM (amd64_div_unsigned,
+	    "mov %rax,%rcx\n\t"
+	    "pop %rax\n\t"
+	    "xor %edx,%edx\n\t"
+	    "div %rcx");
+}
+
+static void
+amd64_emit_rem_signed (int zero_err)
+{
+  amd64_emit_zero_divisor_check (zero_err);
+  EMIT_ASM (amd64_rem_signed,
+	    "mov %rax,%rcx\n\t"
+	    "pop %rax\n\t"
+	    "cmp $-1,%rcx\n\t"
+	    "jne .Lamd64_rem_signed_idiv\n\t"
+	    "xor %eax,%eax\n\t"
+	    "jmp .Lamd64_rem_signed_end\n\t"
+	    ".Lamd64_rem_signed_idiv:\n\t"
+	    "cqto\n\t"
+	    "idiv %rcx\n\t"
+	    "mov %rdx,%rax\n\t"
+	    ".Lamd64_rem_signed_end:");
+}
+
+static void
+amd64_emit_rem_unsigned (int zero_err)
+{
+  amd64_emit_zero_divisor_check (zero_err);
+  EMIT_ASM (amd64_rem_unsigned,
+	    "mov %rax,%rcx\n\t"
+	    "pop %rax\n\t"
+	    "xor %edx,%edx\n\t"
+	    "div %rcx\n\t"
+	    "mov %rdx,%rax");
 }
 
 static void
@@ -1841,11 +1985,11 @@ amd64_emit_ref (int size)
     {
     case 1:
       EMIT_ASM (amd64_ref1,
-		"movb (%rax),%al");
+		"movzbq (%rax),%rax");
       break;
     case 2:
       EMIT_ASM (amd64_ref2,
-		"movw (%rax),%ax");
+		"movzwq (%rax),%rax");
       break;
     case 4:
       EMIT_ASM (amd64_ref4,
@@ -2241,7 +2385,11 @@ struct emit_ops amd64_emit_ops =
     amd64_emit_lt_goto,
     amd64_emit_le_goto,
     amd64_emit_gt_goto,
-    amd64_emit_ge_goto
+    amd64_emit_ge_goto,
+    amd64_emit_div_signed,
+    amd64_emit_div_unsigned,
+    amd64_emit_rem_signed,
+    amd64_emit_rem_unsigned
   };
 
 #endif /* __x86_64__ */
@@ -2289,28 +2437,73 @@ i386_emit_sub (void)
 	    "pop %ebx\n\t");
 }
 
+/* The low 64 bits of the product are the same for signed and unsigned
+   operands: lo(a) * lo(b), plus the two cross products shifted into
+   the high word.  */
+
 static void
 i386_emit_mul (void)
 {
-  emit_error = 1;
+  EMIT_ASM32 (i386_mul,
+	    "mov %eax,%ecx\n\t"
+	    "imul 4(%esp),%ecx\n\t"
+	    "imul (%esp),%ebx\n\t"
+	    "add %ecx,%ebx\n\t"
+	    "mull (%esp)\n\t"
+	    "add %edx,%ebx\n\t"
+	    "lea 0x8(%esp),%esp");
 }
 
+/* The 64-bit shifts shift the two halves with shld/shrd, which only
+   look at the low five bits of the count, and then move one half into
+   the other if the count is 32 or more.  */
+
 static void
 i386_emit_lsh (void)
 {
-  emit_error = 1;
+  EMIT_ASM32 (i386_lsh,
+	    "mov %eax,%ecx\n\t"
+	    "pop %eax\n\t"
+	    "pop %ebx\n\t"
+	    "shld %cl,%eax,%ebx\n\t"
+	    "shl %cl,%eax\n\t"
+	    "test $0x20,%cl\n\t"
+	    "je .Li386_lsh_end\n\t"
+	    "mov %eax,%ebx\n\t"
+	    "xor %eax,%eax\n\t"
+	    ".Li386_lsh_end:");
 }
 
 static void
 i386_emit_rsh_signed (void)
 {
-  emit_error = 1;
+  EMIT_ASM32 (i386_rsh_signed,
+	    "mov %eax,%ecx\n\t"
+	    "pop %eax\n\t"
+	    "pop %ebx\n\t"
+	    "shrd %cl,%ebx,%eax\n\t"
+	    "sar %cl,%ebx\n\t"
+	    "test $0x20,%cl\n\t"
+	    "je .Li386_rsh_signed_end\n\t"
+	    "mov %ebx,%eax\n\t"
+	    "sar $31,%ebx\n\t"
+	    ".Li386_rsh_signed_end:");
 }
 
 static void
 i386_emit_rsh_unsigned (void)
 {
-  emit_error = 1;
+  EMIT_ASM32 (i386_rsh_unsigned,
+	    "mov %eax,%ecx\n\t"
+	    "pop %eax\n\t"
+	    "pop %ebx\n\t"
+	    "shrd %cl,%ebx,%eax\n\t"
+	    "shr %cl,%ebx\n\t"
+	    "test $0x20,%cl\n\t"
+	    "je .Li386_rsh_unsigned_end\n\t"
+	    "mov %ebx,%eax\n\t"
+	    "xor %ebx,%ebx\n\t"
+	    ".Li386_rsh_unsigned_end:");
 }
 
 static void
@@ -2450,15 +2643,18 @@ i386_emit_ref (int size)
     {
     case 1:
       EMIT_ASM32 (i386_ref1,
-		"movb (%eax),%al");
+		"movzbl (%eax),%eax\n\t"
+		"xor %ebx,%ebx");
       break;
     case 2:
       EMIT_ASM32 (i386_ref2,
-		"movw (%eax),%ax");
+		"movzwl (%eax),%eax\n\t"
+		"xor %ebx,%ebx");
       break;
     case 4:
       EMIT_ASM32 (i386_ref4,
-		"movl (%eax),%eax");
+		"movl (%eax),%eax\n\t"
+		"xor %ebx,%ebx");
       break;
     case 8:
       EMIT_ASM32 (i386_ref8,
@@ -2910,7 +3106,13 @@ struct emit_ops i386_emit_ops =
     i386_emit_lt_goto,
     i386_emit_le_goto,
     i386_emit_gt_goto,
-    i386_emit_ge_goto
+    i386_emit_ge_goto,
+    /* There's no 64-bit divide instruction; leave division to the
+       interpreter.  */
+    NULL,
+    NULL,
+    NULL,
+    NULL
   };
 
 
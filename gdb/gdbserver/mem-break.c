@@ -85,6 +85,16 @@ enum bkpt_type
     other_breakpoint,
   };
 
+/* A condition GDB asked us to evaluate for one of its breakpoints.  */
+struct point_cond_list
+{
+  /* The condition, as an agent expression.  */
+  struct agent_expr *cond;
+
+  /* The next condition of the same breakpoint.  */
+  struct point_cond_list *next;
+};
+
 /* A high level (in gdbserver's perspective) breakpoint.  */
 struct breakpoint
 {
@@ -101,6 +111,11 @@ struct breakpoint
      the breakpoint shall be deleted; 0 or if this callback is NULL,
      it will be left inserted.  */
   int (*handler) (CORE_ADDR);
+
+  /* For GDB breakpoints, the conditions to evaluate when the
+     breakpoint is hit.  GDB is told about the hit if any of them is
+     true.  NULL if the breakpoint is unconditional.  */
+  struct point_cond_list *cond_list;
 };
 
 static struct raw_breakpoint *
@@ -571,6 +586,20 @@ delete_raw_breakpoint (struct process_info *proc, struct raw_breakpoint *todel)
   return ENOENT;
 }
 
+static void
+free_breakpoint_conditions (struct breakpoint *bp)
+{
+  struct point_cond_list *cond, *next;
+
+  for (cond = bp->cond_list; cond != NULL; cond = next)
+    {
+      next = cond->next;
+      gdb_free_agent_expr (cond->cond);
+      free (cond);
+    }
+  bp->cond_list = NULL;
+}
+
 static int
 release_breakpoint (struct process_info *proc, struct breakpoint *bp)
 {
@@ -587,6 +616,7 @@ release_breakpoint (struct process_info *proc, struct breakpoint *bp)
   else
     bp->raw->refcount = newrefcount;
 
+  free_breakpoint_conditions (bp);
   free (bp);
 
   return 0;
@@ -707,6 +737,63 @@ gdb_breakpoint_here (CORE_ADDR where)
   return (bp != NULL);
 }
 
+int
+add_breakpoint_condition (CORE_ADDR addr, char **condition)
+{
+  struct breakpoint *bp = find_gdb_breakpoint_at (addr);
+  struct point_cond_list *new_cond;
+  struct agent_expr *cond;
+
+  if (bp == NULL)
+    return 0;
+
+  cond = gdb_parse_agent_expr (condition);
+  if (cond == NULL)
+    return 0;
+
+  new_cond = xcalloc (1, sizeof (*new_cond));
+  new_cond->cond = cond;
+  new_cond->next = bp->cond_list;
+  bp->cond_list = new_cond;
+  return 1;
+}
+
+void
+clear_gdb_breakpoint_conditions (CORE_ADDR addr)
+{
+  struct breakpoint *bp = find_gdb_breakpoint_at (addr);
+
+  if (bp != NULL)
+    free_breakpoint_conditions (bp);
+}
+
+int
+gdb_condition_true_at_breakpoint (CORE_ADDR where)
+{
+  struct breakpoint *bp = find_gdb_breakpoint_at (where);
+  struct point_cond_list *cl;
+  struct regcache *regcache;
+
+  if (bp == NULL || bp->cond_list == NULL)
+    return 1;
+
+  regcache = get_thread_regcache (current_inferior, 1);
+  for (cl = bp->cond_list; cl != NULL; cl = cl->next)
+    {
+      ULONGEST value = 0;
+
+      /* If a condition can't be evaluated, let GDB decide.  */
+      if (gdb_eval_breakpoint_condition (regcache, cl->cond, &value)
+	  || value != 0)
+	return 1;
+    }
+
+  if (debug_threads)
+    fprintf (stderr, "Conditions of breakpoint at 0x%s are false.\n",
+	     paddress (where));
+  return 0;
+}
+
 void
 set_reinsert_breakpoint (CORE_ADDR stop_at)
 {
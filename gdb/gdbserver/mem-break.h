@@ -43,6 +43,22 @@ int breakpoint_inserted_here (CORE_ADDR addr);
 
 int gdb_breakpoint_here (CORE_ADDR where);
 
+/* Add the breakpoint condition at *CONDITION, an agent expression
+   sent by GDB, to the GDB breakpoint at ADDR, and advance *CONDITION
+   past it.  Return 0 if it could not be parsed.  */
+
+int add_breakpoint_condition (CORE_ADDR addr, char **condition);
+
+/* Forget the conditions of the GDB breakpoint at ADDR.  */
+
+void clear_gdb_breakpoint_conditions (CORE_ADDR addr);
+
+/* Returns TRUE if GDB wants to hear about the current thread hitting
+   the GDB breakpoint at WHERE: the breakpoint is unconditional, or one
+   of its conditions is true, or could not be evaluated.  */
+
+int gdb_condition_true_at_breakpoint (CORE_ADDR where);
+
 /* Create a new breakpoint at WHERE, and call HANDLER when
    it is hit.  HANDLER should return 1 if the breakpoint
    should be deleted, 0 otherwise.  */
@@ -29,6 +29,7 @@ static struct reg *reg_defs;
 static int num_registers;
 
 const char **gdbserver_expedite_regs;
+const char **gdbserver_unwind_regs;
 
 #ifndef IN_PROCESS_AGENT
 
@@ -100,6 +101,9 @@ init_register_cache (struct regcache *regcache, unsigned char *regbuf)
       regcache->registers_owned = 1;
       regcache->register_status = xcalloc (1, num_registers);
       gdb_assert (REG_UNAVAILABLE == 0);
+      regcache->delta_registers = NULL;
+      regcache->delta_status = NULL;
+      regcache->delta_gen = 0;
     }
   else
 #else
@@ -112,6 +116,9 @@ init_register_cache (struct regcache *regcache, unsigned char *regbuf)
       regcache->registers_owned = 0;
 #ifndef IN_PROCESS_AGENT
       regcache->register_status = NULL;
+      regcache->delta_registers = NULL;
+      regcache->delta_status = NULL;
+      regcache->delta_gen = 0;
 #endif
     }
 
@@ -142,6 +149,8 @@ free_register_cache (struct regcache *regcache)
       if (regcache->registers_owned)
 	free (regcache->registers);
       free (regcache->register_status);
+      free (regcache->delta_registers);
+      free (regcache->delta_status);
       free (regcache);
     }
 }
@@ -254,6 +263,67 @@ registers_from_string (struct regcache *regcache, char *buf)
   convert_ascii_to_int (buf, registers, len / 2);
 }
 
+/* The generation number of the last qDeltaRegs reply, shared by all
+   threads so that a number GDB holds for one thread never matches
+   another's.  */
+static unsigned int delta_gen_counter;
+
+int
+registers_to_delta (struct regcache *regcache, unsigned int gen, char *buf)
+{
+  unsigned char *registers = regcache->registers;
+  unsigned char *base = NULL;
+  unsigned int new_gen;
+  int i, len, offset;
+
+  if (gen != 0 && gen == regcache->delta_gen)
+    base = regcache->delta_registers;
+
+  new_gen = ++delta_gen_counter;
+  if (new_gen == 0)
+    new_gen = ++delta_gen_counter;
+
+  len = sprintf (buf, "D%x;", new_gen);
+  for (i = 0, offset = 0; i < num_registers; offset += register_size (i), i++)
+    {
+      int size = register_size (i);
+      int valid = regcache->register_status[i] == REG_VALID;
+
+      /* Leave out the registers GDB already has.  */
+      if (base != NULL
+	  && regcache->delta_status[i] == regcache->register_status[i]
+	  && (!valid || memcmp (base + offset, registers + offset, size) == 0))
+	continue;
+
+      if (len + 8 + 2 * size > PBUFSIZ - 1)
+	return -1;
+
+      len += sprintf (buf + len, "%x", i);
+      if (valid)
+	{
+	  int consumed;
+
+	  buf[len++] = ':';
+	  len += remote_escape_output (registers + offset, size,
+				       (gdb_byte *) buf + len, &consumed,
+				       PBUFSIZ - 1 - len);
+	}
+      else
+	buf[len++] = 'x';
+    }
+
+  if (regcache->delta_registers == NULL)
+    {
+      regcache->delta_registers = xmalloc (register_bytes);
+      regcache->delta_status = xmalloc (num_registers);
+    }
+  memcpy (regcache->delta_registers, registers, register_bytes);
+  memcpy (regcache->delta_status, regcache->register_status, num_registers);
+  regcache->delta_gen = new_gen;
+
+  return len;
+}
+
 struct reg *
 find_register_by_name (const char *name)
 {
@@ -266,6 +336,17 @@ find_register_by_name (const char *name)
   return 0;
 }
 
+int
+find_regno_if_exists (const char *name)
+{
+  int i;
+
+  for (i = 0; i < num_registers; i++)
+    if (!strcmp (name, reg_defs[i].name))
+      return i;
+  return -1;
+}
+
 int
 find_regno (const char *name)
 {
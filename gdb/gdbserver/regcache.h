@@ -46,6 +46,13 @@ struct regcache
 #ifndef IN_PROCESS_AGENT
   /* One of REG_UNAVAILBLE or REG_VALID.  */
   unsigned char *register_status;
+
+  /* The registers and their status as last sent to GDB in reply to a
+     qDeltaRegs packet, and the generation number of that reply, or
+     zero if there was none.  */
+  unsigned char *delta_registers;
+  unsigned char *delta_status;
+  unsigned int delta_gen;
 #endif
 };
 
@@ -78,6 +85,14 @@ void registers_to_string (struct regcache *regcache, char *buf);
 
 void registers_from_string (struct regcache *regcache, char *buf);
 
+/* Write to BUF a reply to a qDeltaRegs packet asking for the
+   registers that changed since the reply numbered GEN.  Returns the
+   length of the reply, which is binary, or -1 if it doesn't fit in a
+   packet.  */
+
+int registers_to_delta (struct regcache *regcache, unsigned int gen,
+			char *buf);
+
 CORE_ADDR regcache_read_pc (struct regcache *regcache);
 
 void regcache_write_pc (struct regcache *regcache, CORE_ADDR pc);
@@ -97,6 +112,16 @@ int find_regno (const char *name);
 extern const char **gdbserver_expedite_regs;
 extern const char *gdbserver_xmltarget;
 
+/* The registers GDB needs to unwind frames, which --expedite=unwind
+   adds to stop replies.  Set by the low target if it knows them;
+   names of registers the current target description lacks are
+   skipped.  */
+extern const char **gdbserver_unwind_regs;
+
+/* Return the number of the register named NAME, or -1 if there is
+   none.  */
+int find_regno_if_exists (const char *name);
+
 void supply_register (struct regcache *regcache, int n, const void *buf);
 
 void supply_register_zeroed (struct regcache *regcache, int n);
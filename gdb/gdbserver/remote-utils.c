@@ -19,6 +19,7 @@
 #include "server.h"
 #include "terminal.h"
 #include "target.h"
+#include "rsp-lz.h"
 #include <stdio.h>
 #include <string.h>
 #if HAVE_SYS_IOCTL_H
@@ -117,6 +118,9 @@ int noack_mode = 0;
 /* If true, then we tell GDB to use noack mode by default.  */
 int transport_is_reliable = 0;
 
+/* Nonzero if GDB asked for large packets to be compressed.  */
+int compressed_packets = 0;
+
 #ifdef USE_WIN32API
 # define read(fd, buf, len) recv (fd, (char *) buf, len, 0)
 # define write(fd, buf, len) send (fd, (char *) buf, len, 0)
@@ -729,6 +733,79 @@ read_ptid (char *buf, char **obuf)
   return ptid_build (pid, tid, 0);
 }
 
+/* If BUF, CNT bytes long, is worth compressing, return a malloc'd
+   compressed payload for it and store its length in *ZCNT.  Otherwise
+   return NULL.  */
+
+static char *
+compress_packet (const char *buf, int cnt, int *zcnt)
+{
+  unsigned char *data;
+  char *zbuf;
+  int data_len, header_len, out_len, consumed;
+
+  data = xmalloc (cnt);
+  data_len = rsp_lz_compress ((const unsigned char *) buf, cnt, data, cnt);
+  if (data_len < 0)
+    {
+      free (data);
+      return NULL;
+    }
+
+  zbuf = xmalloc (cnt);
+  header_len = sprintf (zbuf, "%c%x:", RSP_LZ_MARKER, cnt);
+  out_len = remote_escape_output (data, data_len,
+				  (unsigned char *) zbuf + header_len,
+				  &consumed, cnt - header_len - 1);
+  free (data);
+  if (consumed < data_len)
+    {
+      free (zbuf);
+      return NULL;
+    }
+
+  *zcnt = header_len + out_len;
+  return zbuf;
+}
+
+/* If BUF, CNT bytes long, holds a compressed packet, replace it with
+   the packet it expands to, at most PBUFSIZ bytes including the
+   trailing NUL.  Return the length of the packet, or -1 if it is
+   malformed.  Packets are only expanded if GDB asked for compression
+   in qSupported.  */
+
+static int
+decompress_packet (char *buf, int cnt)
+{
+  unsigned char *data;
+  char *p;
+  int len = 0, data_len, res, nib;
+
+  if (!compressed_packets || cnt == 0 || buf[0] != RSP_LZ_MARKER)
+    return cnt;
+
+  for (p = buf + 1; p < buf + cnt && ishex (*p, &nib); p++)
+    {
+      len = (len << 4) | nib;
+      if (len >= PBUFSIZ)
+	return -1;
+    }
+  if (p == buf + 1 || p >= buf + cnt || *p != ':')
+    return -1;
+  p++;
+
+  data = xmalloc (cnt);
+  data_len = remote_unescape_input ((const gdb_byte *) p, cnt - (p - buf),
+				    data, cnt);
+  res = rsp_lz_decompress (data, data_len, (unsigned char *) buf, len);
+  free (data);
+  if (res < 0)
+    return -1;
+
+  buf[len] = '\0';
+  return len;
+}
+
 /* Send a packet to the remote machine, with error checking.
    The data of the packet is in BUF, and the length of the
    packet is in CNT.  Returns >= 0 on success, -1 otherwise.  */
@@ -741,6 +818,18 @@ putpkt_binary_1 (char *buf, int cnt, int is_notif)
   char *buf2;
   char *p;
   int cc;
+  char *zbuf = NULL;
+  int zcnt;
+
+  if (compressed_packets && cnt >= RSP_LZ_MIN_LENGTH)
+    zbuf = compress_packet (buf, cnt, &zcnt);
+  if (zbuf != NULL)
+    {
+      if (remote_debug)
+	fprintf (stderr, "putpkt: compressed %d bytes to %d\n", cnt, zcnt);
+      buf = zbuf;
+      cnt = zcnt;
+    }
 
   buf2 = xmalloc (strlen ("$") + cnt + strlen ("#nn") + 1);
 
@@ -755,6 +844,7 @@ putpkt_binary_1 (char *buf, int cnt, int is_notif)
 
   for (i = 0; i < cnt;)
     i += try_rle (buf + i, cnt - i, &csum, &p);
+  free (zbuf);
 
   *p++ = '#';
   *p++ = tohex ((csum >> 4) & 0xf);
@@ -1053,10 +1143,11 @@ reschedule (void)
 }
 
 /* Read a packet from the remote machine, with error checking,
-   and store it in BUF.  Returns length of packet, or negative if error. */
+   and store it in BUF, without expanding it.  Returns length of
+   packet, or negative if error.  */
 
-int
-getpkt (char *buf)
+static int
+getpkt_1 (char *buf)
 {
   char *bp;
   unsigned char csum, c1, c2;
@@ -1145,6 +1236,31 @@ getpkt (char *buf)
   return bp - buf;
 }
 
+/* Read a packet from the remote machine, with error checking,
+   and store it in BUF.  Returns length of packet, or negative if error. */
+
+int
+getpkt (char *buf)
+{
+  while (1)
+    {
+      int len = getpkt_1 (buf);
+
+      if (len < 0)
+	return len;
+
+      len = decompress_packet (buf, len);
+      if (len >= 0)
+	return len;
+
+      /* The packet arrived intact but does not expand.  Reject it
+	 like any other bad request, and keep the connection.  */
+      fprintf (stderr, "Malformed compressed packet\n");
+      if (putpkt ("E01") < 0)
+	return -1;
+    }
+}
+
 void
 write_ok (char *buf)
 {
@@ -1212,6 +1328,70 @@ outreg (struct regcache *regcache, int regno, char *buf)
   return buf;
 }
 
+/* Return the number of entries in the NULL-terminated NAMES.  */
+
+static int
+count_names (const char **names)
+{
+  int n = 0;
+
+  if (names != NULL)
+    while (names[n] != NULL)
+      n++;
+  return n;
+}
+
+/* Append to BUF the registers named in NAMES that exist in the
+   current target description and that the target doesn't already
+   expedite.  The name "unwind" stands for GDBSERVER_UNWIND_REGS.
+   SENT holds the *N_SENT register numbers appended so far, which are
+   not sent again.  Registers that would not fit before LIMIT are
+   left out.  */
+
+static char *
+outreg_names (struct regcache *regcache, const char **names, char *buf,
+	      const char *limit, int *sent, int *n_sent)
+{
+  for (; *names != NULL; names++)
+    {
+      const char **regp;
+      int regno, i;
+
+      if (strcmp (*names, "unwind") == 0)
+	{
+	  if (gdbserver_unwind_regs != NULL)
+	    buf = outreg_names (regcache, gdbserver_unwind_regs, buf,
+				limit, sent, n_sent);
+	  continue;
+	}
+
+      regno = find_regno_if_exists (*names);
+      if (regno < 0)
+	continue;
+
+      for (regp = gdbserver_expedite_regs; *regp != NULL; regp++)
+	if (strcmp (*regp, *names) == 0)
+	  break;
+      if (*regp != NULL)
+	continue;
+
+      for (i = 0; i < *n_sent; i++)
+	if (sent[i] == regno)
+	  break;
+      if (i < *n_sent)
+	continue;
+
+      /* Up to four digits, ':', the value and ';'.  */
+      if (buf + 4 + 1 + 2 * register_size (regno) + 1 > limit)
+	continue;
+
+      buf = outreg (regcache, regno, buf);
+      sent[(*n_sent)++] = regno;
+    }
+
+  return buf;
+}
+
 void
 new_thread_notify (int id)
 {
@@ -1260,6 +1440,9 @@ prepare_resume_reply (char *buf, ptid_t ptid,
 	struct thread_info *saved_inferior;
 	const char **regp;
 	struct regcache *regcache;
+	/* Leave room for the thread, core and library fields that follow
+	   the registers, and for a "Stop:" prefix in BUF.  */
+	const char *limit = buf + PBUFSIZ - 256;
 
 	sprintf (buf, "T%02x", status->value.sig);
 	buf += strlen (buf);
@@ -1297,6 +1480,16 @@ prepare_resume_reply (char *buf, ptid_t ptid,
 	    buf = outreg (regcache, find_regno (*regp), buf);
 	    regp ++;
 	  }
+	if (extra_expedite_regs != NULL)
+	  {
+	    int n_sent = 0;
+	    int *sent = alloca ((count_names (extra_expedite_regs)
+				 + count_names (gdbserver_unwind_regs))
+				* sizeof (int));
+
+	    buf = outreg_names (regcache, extra_expedite_regs, buf,
+				limit, sent, &n_sent);
+	  }
 	*buf = '\0';
 
 	/* Formerly, if the debugger had not used any thread features
@@ -1519,6 +1712,47 @@ clear_symbol_cache (struct sym_cache **symcache_p)
    MAY_ASK_GDB is false, assume symbol cache misses are failures.
    Returns 1 if the symbol is found, 0 if it is not, -1 on error.  */
 
+/* Answer the "m" or "x" memory read request in OWN_BUF, which is
+   OWN_BUF_SIZE bytes long, in place, reading no more than fits in the
+   reply.  Return the length of the reply.  */
+
+static int
+answer_nested_memory_read (char *own_buf, int own_buf_size)
+{
+  CORE_ADDR mem_addr;
+  unsigned char *mem_buf;
+  unsigned int mem_len;
+  int binary = own_buf[0] == 'x';
+  int len, out_len;
+
+  decode_m_packet (&own_buf[1], &mem_addr, &mem_len);
+  if (binary && mem_len > own_buf_size - 2)
+    mem_len = own_buf_size - 2;
+  else if (!binary && mem_len > (own_buf_size - 1) / 2)
+    mem_len = (own_buf_size - 1) / 2;
+
+  mem_buf = xmalloc (mem_len);
+  if (read_inferior_memory (mem_addr, mem_buf, mem_len) != 0)
+    {
+      write_enn (own_buf);
+      len = strlen (own_buf);
+    }
+  else if (binary)
+    {
+      own_buf[0] = 'b';
+      len = remote_escape_output (mem_buf, mem_len,
+				  (unsigned char *) own_buf + 1, &out_len,
+				  own_buf_size - 2) + 1;
+    }
+  else
+    {
+      convert_int_to_ascii (mem_buf, own_buf, mem_len);
+      len = strlen (own_buf);
+    }
+  free (mem_buf);
+  return len;
+}
+
 int
 look_up_one_symbol (const char *name, CORE_ADDR *addrp, int may_ask_gdb)
 {
@@ -1558,20 +1792,10 @@ look_up_one_symbol (const char *name, CORE_ADDR *addrp, int may_ask_gdb)
      main loop.  For now, this is an adequate approximation; allow
      GDB to read from memory while it figures out the address of the
      symbol.  */
-  while (own_buf[0] == 'm')
+  while (own_buf[0] == 'm' || own_buf[0] == 'x')
     {
-      CORE_ADDR mem_addr;
-      unsigned char *mem_buf;
-      unsigned int mem_len;
-
-      decode_m_packet (&own_buf[1], &mem_addr, &mem_len);
-      mem_buf = xmalloc (mem_len);
-      if (read_inferior_memory (mem_addr, mem_buf, mem_len) == 0)
-	convert_int_to_ascii (mem_buf, own_buf, mem_len);
-      else
-	write_enn (own_buf);
-      free (mem_buf);
-      if (putpkt (own_buf) < 0)
+      len = answer_nested_memory_read (own_buf, sizeof (own_buf));
+      if (putpkt_binary (own_buf, len) < 0)
 	return -1;
       len = getpkt (own_buf);
       if (len < 0)
@@ -1640,40 +1864,39 @@ relocate_instruction (CORE_ADDR *to, CORE_ADDR oldloc)
      wait for the qRelocInsn "response".  That requires re-entering
      the main loop.  For now, this is an adequate approximation; allow
      GDB to access memory.  */
-  while (own_buf[0] == 'm' || own_buf[0] == 'M' || own_buf[0] == 'X')
+  while (own_buf[0] == 'm' || own_buf[0] == 'x'
+	 || own_buf[0] == 'M' || own_buf[0] == 'X')
     {
       CORE_ADDR mem_addr;
       unsigned char *mem_buf = NULL;
       unsigned int mem_len;
+      int reply_len;
 
-      if (own_buf[0] == 'm')
-	{
-	  decode_m_packet (&own_buf[1], &mem_addr, &mem_len);
-	  mem_buf = xmalloc (mem_len);
-	  if (read_inferior_memory (mem_addr, mem_buf, mem_len) == 0)
-	    convert_int_to_ascii (mem_buf, own_buf, mem_len);
-	  else
-	    write_enn (own_buf);
-	}
-      else if (own_buf[0] == 'X')
-	{
-	  if (decode_X_packet (&own_buf[1], len - 1, &mem_addr,
-			       &mem_len, &mem_buf) < 0
-	      || write_inferior_memory (mem_addr, mem_buf, mem_len) != 0)
-	    write_enn (own_buf);
-	  else
-	    write_ok (own_buf);
-	}
+      if (own_buf[0] == 'm' || own_buf[0] == 'x')
+	reply_len = answer_nested_memory_read (own_buf, sizeof (own_buf));
       else
 	{
-	  decode_M_packet (&own_buf[1], &mem_addr, &mem_len, &mem_buf);
-	  if (write_inferior_memory (mem_addr, mem_buf, mem_len) == 0)
-	    write_ok (own_buf);
+	  if (own_buf[0] == 'X')
+	    {
+	      if (decode_X_packet (&own_buf[1], len - 1, &mem_addr,
+				   &mem_len, &mem_buf) < 0
+		  || write_inferior_memory (mem_addr, mem_buf, mem_len) != 0)
+		write_enn (own_buf);
+	      else
+		write_ok (own_buf);
+	    }
 	  else
-	    write_enn (own_buf);
+	    {
+	      decode_M_packet (&own_buf[1], &mem_addr, &mem_len, &mem_buf);
+	      if (write_inferior_memory (mem_addr, mem_buf, mem_len) == 0)
+		write_ok (own_buf);
+	      else
+		write_enn (own_buf);
+	    }
+	  reply_len = strlen (own_buf);
 	}
       free (mem_buf);
-      if (putpkt (own_buf) < 0)
+      if (putpkt_binary (own_buf, reply_len) < 0)
 	return -1;
       len = getpkt (own_buf);
       if (len < 0)
@@ -94,6 +94,10 @@ int disable_packet_Tthread;
 int disable_packet_qC;
 int disable_packet_qfThreadInfo;
 
+/* Registers to include in stop replies besides the ones the target
+   expedites, as given by --expedite.  NULL-terminated, or NULL.  */
+const char **extra_expedite_regs;
+
 /* Last status reported to GDB.  */
 static struct target_waitstatus last_status;
 static ptid_t last_ptid;
@@ -1510,6 +1514,7 @@ handle_query (char *own_buf, int packet_len, int *new_packet_len_p)
 
       /* Start processing qSupported packet.  */
       target_process_qsupported (NULL);
+      compressed_packets = 0;
 
       /* Process each feature being provided by GDB.  The first
 	 feature will follow a ':', and latter features will follow
@@ -1546,6 +1551,12 @@ handle_query (char *own_buf, int packet_len, int *new_packet_len_p)
 		  /* GDB supports relocate instruction requests.  */
 		  gdb_supports_qRelocInsn = 1;
 		}
+	      else if (strcmp (p, "compressed-packets+") == 0)
+		{
+		  /* GDB can expand compressed packets; it only compresses
+		     its own once it sees our reply.  */
+		  compressed_packets = 1;
+		}
 	      else
 		target_process_qsupported (p);
 
@@ -1557,6 +1568,17 @@ handle_query (char *own_buf, int packet_len, int *new_packet_len_p)
 
       sprintf (own_buf, "PacketSize=%x;QPassSignals+", PBUFSIZ - 1);
 
+      strcat (own_buf, ";binary-upload+");
+
+      strcat (own_buf, ";qDeltaRegs+");
+
+      if (compressed_packets)
+	strcat (own_buf, ";compressed-packets+");
+
+      /* Packets that arrive while we are still busy with an earlier one
+	 are buffered and handled in order, see process_remaining.  */
+      strcat (own_buf, ";PipelinedReads+");
+
       if (the_target->qxfer_libraries_svr4 != NULL)
 	strcat (own_buf, ";qXfer:libraries-svr4:read+");
       else
@@ -1601,6 +1623,9 @@ handle_query (char *own_buf, int packet_len, int *new_packet_len_p)
 
       strcat (own_buf, ";qXfer:threads:read+");
 
+      if (target_supports_conditional_breakpoints ())
+	strcat (own_buf, ";ConditionalBreakpoints+");
+
       if (target_supports_tracepoints ())
 	{
 	  strcat (own_buf, ";ConditionalTracepoints+");
@@ -1774,6 +1799,31 @@ handle_query (char *own_buf, int packet_len, int *new_packet_len_p)
       return;
     }
 
+  if (strncmp ("qDeltaRegs:", own_buf, 11) == 0)
+    {
+      struct regcache *regcache;
+      ULONGEST gen;
+      int len;
+
+      require_running (own_buf);
+      /* Traceframe registers are fetched with 'g'.  */
+      if (current_traceframe >= 0)
+	{
+	  write_enn (own_buf);
+	  return;
+	}
+
+      unpack_varlen_hex (own_buf + 11, &gen);
+      set_desired_inferior (1);
+      regcache = get_thread_regcache (current_inferior, 1);
+      len = registers_to_delta (regcache, (unsigned int) gen, own_buf);
+      if (len < 0)
+	write_enn (own_buf);
+      else
+	*new_packet_len_p = len;
+      return;
+    }
+
   if (strncmp ("qCRC:", own_buf, 5) == 0)
     {
       /* CRC check (compare-section).  */
@@ -2391,6 +2441,11 @@ gdbserver_usage (FILE *stream)
 	   "  --remote-debug        Enable remote protocol debugging output.\n"
 	   "  --version             Display version information and exit.\n"
 	   "  --wrapper WRAPPER --  Run WRAPPER to start new programs.\n"
+	   "  --expedite=REGS       Also send the comma-separated REGS "
+								"in stop\n"
+	   "                        replies; \"unwind\" stands for the "
+						    "registers\n"
+	   "                        needed to unwind frames.\n"
 	   "  --once                Exit after the first connection has "
 								  "closed.\n");
   if (REPORT_BUGS_TO[0] && stream == stdout)
@@ -2605,6 +2660,22 @@ main (int argc, char *argv[])
 		}
 	    }
 	}
+      else if (strncmp (*next_arg,
+			"--expedite=",
+			sizeof ("--expedite=") - 1) == 0)
+	{
+	  char *regs, *tok;
+	  int n = 0;
+
+	  regs = *next_arg + sizeof ("--expedite=") - 1;
+	  extra_expedite_regs = xmalloc ((strlen (regs) / 2 + 2)
+					 * sizeof (char *));
+	  for (tok = strtok (regs, ",");
+	       tok != NULL;
+	       tok = strtok (NULL, ","))
+	    extra_expedite_regs[n++] = tok;
+	  extra_expedite_regs[n] = NULL;
+	}
       else if (strcmp (*next_arg, "--disable-randomization") == 0)
 	disable_randomization = 1;
       else if (strcmp (*next_arg, "--no-disable-randomization") == 0)
@@ -2727,6 +2798,7 @@ main (int argc, char *argv[])
   while (1)
     {
       noack_mode = 0;
+      compressed_packets = 0;
       multi_process = 0;
       /* Be sure we're out of tfind mode.  */
       current_traceframe = -1;
@@ -2791,6 +2863,44 @@ main (int argc, char *argv[])
     }
 }
 
+/* Process the options that follow the kind of a Z0 packet, at
+   *PACKET, for the breakpoint at POINT_ADDR.  Each option starts with
+   a ';'.  The only one defined is a condition, 'X' followed by an
+   agent expression.  If a condition can't be parsed, leave the
+   breakpoint unconditional; GDB checks the conditions anyway.  */
+
+static void
+process_point_options (CORE_ADDR point_addr, char **packet)
+{
+  char *dataptr = *packet;
+
+  while (*dataptr == ';')
+    {
+      dataptr++;
+
+      if (*dataptr == 'X')
+	{
+	  if (!add_breakpoint_condition (point_addr, &dataptr))
+	    {
+	      if (debug_threads)
+		fprintf (stderr, "Malformed condition for breakpoint at "
+			 "0x%s; ignoring its conditions.\n",
+			 paddress (point_addr));
+	      clear_gdb_breakpoint_conditions (point_addr);
+	      break;
+	    }
+	}
+      else
+	{
+	  /* Skip options we don't know about.  */
+	  while (*dataptr != '\0' && *dataptr != ';')
+	    dataptr++;
+	}
+    }
+
+  *packet = dataptr;
+}
+
 /* Event loop callback that handles a serial event.  The first byte in
    the serial buffer gets us here.  We expect characters to arrive at
    a brisk pace, so we read the rest of the packet with a blocking
@@ -3045,6 +3155,26 @@ process_serial_event (void)
       else
 	convert_int_to_ascii (mem_buf, own_buf, res);
       break;
+    case 'x':
+      require_running (own_buf);
+      decode_m_packet (&own_buf[1], &mem_addr, &len);
+      /* The reply can't carry more than a packet's worth, even if
+	 nothing needs escaping.  */
+      if (len > PBUFSIZ - 2)
+	len = PBUFSIZ - 2;
+      res = gdb_read_memory (mem_addr, mem_buf, len);
+      if (res < 0)
+	write_enn (own_buf);
+      else
+	{
+	  int out_len;
+
+	  own_buf[0] = 'b';
+	  new_packet_len = remote_escape_output (mem_buf, res,
+						 (unsigned char *) own_buf + 1,
+						 &out_len, PBUFSIZ - 2) + 1;
+	}
+      break;
     case 'M':
       require_running (own_buf);
       decode_M_packet (&own_buf[1], &mem_addr, &len, &mem_buf);
@@ -3113,7 +3243,19 @@ process_serial_event (void)
 	  case '4': /* access watchpoint */
 	    require_running (own_buf);
 	    if (insert && the_target->insert_point != NULL)
-	      res = (*the_target->insert_point) (type, addr, len);
+	      {
+		res = (*the_target->insert_point) (type, addr, len);
+
+		/* GDB may have sent the conditions under which it wants
+		   to hear about the breakpoint being hit.  They replace
+		   any the breakpoint had.  */
+		if (res == 0 && type == '0'
+		    && target_supports_conditional_breakpoints ())
+		  {
+		    clear_gdb_breakpoint_conditions (addr);
+		    process_point_options (addr, &dataptr);
+		  }
+	      }
 	    else if (!insert && the_target->remove_point != NULL)
 	      res = (*the_target->remove_point) (type, addr, len);
 	    break;
@@ -118,16 +118,33 @@ typedef long long LONGEST;
 typedef unsigned long long ULONGEST;
 
 /* Generic information for tracking a list of ``inferiors'' - threads,
-   processes, etc.  */
+   processes, etc.  Besides the list proper, which keeps the entries in
+   the order they were added, entries are indexed by ID in a hash
+   table, so that finding an entry by ID does not require walking the
+   list.  A zero-initialized inferior_list is an empty list.  */
 struct inferior_list
 {
   struct inferior_list_entry *head;
   struct inferior_list_entry *tail;
+
+  /* Hash table of the entries, chained through HASH_NEXT.  NULL until
+     the first entry is added.  */
+  struct inferior_list_entry **buckets;
+
+  /* The number of buckets (a power of two), and of entries.  */
+  int nbuckets;
+  int count;
 };
 struct inferior_list_entry
 {
   ptid_t id;
   struct inferior_list_entry *next;
+  struct inferior_list_entry *prev;
+
+  /* The next entry in the same hash bucket, and the pointer pointing
+     at this entry from the bucket chain.  */
+  struct inferior_list_entry *hash_next;
+  struct inferior_list_entry **hash_pprev;
 };
 
 struct thread_info;
@@ -245,6 +262,7 @@ void for_each_inferior (struct inferior_list *list,
 extern struct thread_info *current_inferior;
 void remove_inferior (struct inferior_list *list,
 		      struct inferior_list_entry *entry);
+void clear_inferior_list (struct inferior_list *list);
 void remove_thread (struct thread_info *thread);
 void add_thread (ptid_t ptid, void *target_data);
 
@@ -268,6 +286,8 @@ struct inferior_list_entry *find_inferior
       void *arg);
 struct inferior_list_entry *find_inferior_id (struct inferior_list *list,
 					      ptid_t id);
+struct inferior_list_entry *find_inferior_lwp (struct inferior_list *list,
+					       int lwp);
 void *inferior_target_data (struct thread_info *);
 void set_inferior_target_data (struct thread_info *, void *);
 void *inferior_regcache_data (struct thread_info *);
@@ -295,6 +315,8 @@ extern int disable_packet_Tthread;
 extern int disable_packet_qC;
 extern int disable_packet_qfThreadInfo;
 
+extern const char **extra_expedite_regs;
+
 extern int run_once;
 extern int multi_process;
 extern int non_stop;
@@ -339,6 +361,7 @@ extern void hostio_last_error_from_errno (char *own_buf);
 extern int remote_debug;
 extern int noack_mode;
 extern int transport_is_reliable;
+extern int compressed_packets;
 
 int gdb_connected (void);
 
@@ -452,6 +475,12 @@ int tracepoint_was_hit (struct thread_info *tinfo, CORE_ADDR stop_pc);
 
 void release_while_stepping_state_list (struct thread_info *tinfo);
 
+struct agent_expr;
+struct agent_expr *gdb_parse_agent_expr (char **actparm);
+void gdb_free_agent_expr (struct agent_expr *aexpr);
+int gdb_eval_breakpoint_condition (struct regcache *regcache,
+				   struct agent_expr *cond, ULONGEST *value);
+
 extern int current_traceframe;
 
 int in_readonly_region (CORE_ADDR addr, ULONGEST length);
@@ -482,12 +511,31 @@ struct fast_tpoint_collect_status
      to.  */
   CORE_ADDR adjusted_insn_addr;
   CORE_ADDR adjusted_insn_addr_end;
+
+  /* The thread area of the thread that is collecting.  */
+  CORE_ADDR thread_area;
 };
 
 int fast_tracepoint_collecting (CORE_ADDR thread_area,
 				CORE_ADDR stop_pc,
 				struct fast_tpoint_collect_status *status);
-void force_unlock_trace_buffer (void);
+void force_unlock_trace_buffer (CORE_ADDR thread_area);
+
+/* The in-process agent splits its trace buffer in IPA_TRACE_SEGMENTS
+   segments, each guarded by a fast tracepoint collect lock of its
+   own, so that threads hitting fast tracepoints at the same time
+   don't all serialize on a single lock.  A thread collects into
+   segment IPA_TRACE_SEGMENT of its thread area, that is, of bits
+   IPA_TRACE_SEGMENT_SHIFT and up, which differ between the TCBs of
+   threads.  The locks are 1 << IPA_COLLECT_LOCK_SIZE_LOG2 bytes
+   apart, so that each has a cache line to itself, starting at the
+   lock address passed to install_fast_tracepoint_jump_pad.  */
+
+#define IPA_TRACE_SEGMENTS 8
+#define IPA_TRACE_SEGMENT_SHIFT 12
+#define IPA_TRACE_SEGMENT(THREAD_AREA) \
+  (((THREAD_AREA) >> IPA_TRACE_SEGMENT_SHIFT) & (IPA_TRACE_SEGMENTS - 1))
+#define IPA_COLLECT_LOCK_SIZE_LOG2 6
 
 int handle_tracepoint_bkpts (struct thread_info *tinfo, CORE_ADDR stop_pc);
 
@@ -558,6 +606,15 @@ struct emit_ops
   void (*emit_le_goto) (int *offset_p, int *size_p);
   void (*emit_gt_goto) (int *offset_p, int *size_p);
   void (*emit_ge_goto) (int *offset_p, int *size_p);
+
+  /* Emit code for division and remainder.  If the divisor is zero,
+     the emitted code must return ZERO_ERR from the compiled function
+     straight away.  These may be NULL, in which case expressions using
+     them are left to the interpreter.  */
+  void (*emit_div_signed) (int zero_err);
+  void (*emit_div_unsigned) (int zero_err);
+  void (*emit_rem_signed) (int zero_err);
+  void (*emit_rem_unsigned) (int zero_err);
 };
 
 /* Returns the address of the get_raw_reg function in the IPA.  */
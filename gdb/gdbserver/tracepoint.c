@@ -124,13 +124,7 @@ trace_vdebug (const char *fmt, ...)
 # define error_tracepoint gdb_agent_error_tracepoint
 # define tracepoints gdb_agent_tracepoints
 # define tracing gdb_agent_tracing
-# define trace_buffer_ctrl gdb_agent_trace_buffer_ctrl
-# define trace_buffer_ctrl_curr gdb_agent_trace_buffer_ctrl_curr
-# define trace_buffer_lo gdb_agent_trace_buffer_lo
-# define trace_buffer_hi gdb_agent_trace_buffer_hi
-# define traceframe_read_count gdb_agent_traceframe_read_count
-# define traceframe_write_count gdb_agent_traceframe_write_count
-# define traceframes_created gdb_agent_traceframes_created
+# define trace_buffer_segments gdb_agent_trace_buffer_segments
 # define trace_state_variables gdb_agent_trace_state_variables
 # define get_raw_reg gdb_agent_get_raw_reg
 # define get_trace_state_variable_value \
@@ -165,13 +159,7 @@ struct ipa_sym_addresses
   CORE_ADDR addr_error_tracepoint;
   CORE_ADDR addr_tracepoints;
   CORE_ADDR addr_tracing;
-  CORE_ADDR addr_trace_buffer_ctrl;
-  CORE_ADDR addr_trace_buffer_ctrl_curr;
-  CORE_ADDR addr_trace_buffer_lo;
-  CORE_ADDR addr_trace_buffer_hi;
-  CORE_ADDR addr_traceframe_read_count;
-  CORE_ADDR addr_traceframe_write_count;
-  CORE_ADDR addr_traceframes_created;
+  CORE_ADDR addr_trace_buffer_segments;
   CORE_ADDR addr_trace_state_variables;
   CORE_ADDR addr_get_raw_reg;
   CORE_ADDR addr_get_trace_state_variable_value;
@@ -212,13 +200,7 @@ static struct
   IPA_SYM(error_tracepoint),
   IPA_SYM(tracepoints),
   IPA_SYM(tracing),
-  IPA_SYM(trace_buffer_ctrl),
-  IPA_SYM(trace_buffer_ctrl_curr),
-  IPA_SYM(trace_buffer_lo),
-  IPA_SYM(trace_buffer_hi),
-  IPA_SYM(traceframe_read_count),
-  IPA_SYM(traceframe_write_count),
-  IPA_SYM(traceframes_created),
+  IPA_SYM(trace_buffer_segments),
   IPA_SYM(trace_state_variables),
   IPA_SYM(get_raw_reg),
   IPA_SYM(get_trace_state_variable_value),
@@ -581,7 +563,11 @@ enum tracepoint_type
 
 struct tracepoint_hit_ctx;
 
-typedef enum eval_result_type (*condfn) (struct tracepoint_hit_ctx *,
+/* Compiled conditions take the raw register block saved by the fast
+   tracepoint jump pad, which the emitted code hands to
+   get_raw_reg.  */
+
+typedef enum eval_result_type (*condfn) (unsigned char *,
 					 ULONGEST *);
 
 /* The definition of a tracepoint.  */
@@ -865,11 +851,34 @@ struct traceframe
      tracepoint hit.  */
   unsigned int data_size : 32;
 
+#ifdef IN_PROCESS_AGENT
+  /* When the traceframe was collected, as returned by get_timestamp.
+     GDBserver uses this to upload the traceframes of all the
+     in-process agent's trace buffer segments in the order they were
+     collected.  */
+  LONGEST timestamp;
+#endif
+
   /* The base of the trace data, which is contiguous from this point.  */
   unsigned char data[0];
 
 } ATTR_PACKED;
 
+#ifndef IN_PROCESS_AGENT
+
+/* Same as above, as laid out in the in-process agent's trace
+   buffer.  */
+
+struct ipa_traceframe
+{
+  int tpnum : 16;
+  unsigned int data_size : 32;
+  LONGEST timestamp;
+  unsigned char data[0];
+} ATTR_PACKED;
+
+#endif
+
 /* The traceframe to be used as the source of data to send back to
    GDB.  A value of -1 means to get data from the live program.  */
 
@@ -883,6 +892,8 @@ int current_traceframe = -1;
 static int circular_trace_buffer;
 #endif
 
+#ifndef IN_PROCESS_AGENT
+
 /* Pointer to the block of memory that traceframes all go into.  */
 
 static unsigned char *trace_buffer_lo;
@@ -892,6 +903,8 @@ static unsigned char *trace_buffer_lo;
 
 static unsigned char *trace_buffer_hi;
 
+#endif
+
 /* Control structure holding the read/write/etc. pointers into the
    trace buffer.  We need more than one of these to implement a
    transaction-like mechanism to garantees that both GDBserver and the
@@ -1043,15 +1056,77 @@ A GDBserver update of `trace_buffer_ctrl_curr' does:
    always stamps this bit as set.  */
 #define GDBSERVER_UPDATED_FLUSH_COUNT_BIT 0x80000000
 
+#ifndef ATTR_ALIGNED
+#  if defined(__GNUC__)
+#    define ATTR_ALIGNED(N) __attribute__ ((aligned (N)))
+#  else
+#    define ATTR_ALIGNED(N) /* nothing */
+#  endif
+#endif
+
 #ifdef IN_PROCESS_AGENT
-IP_AGENT_EXPORT struct trace_buffer_control trace_buffer_ctrl[3];
-IP_AGENT_EXPORT unsigned int trace_buffer_ctrl_curr;
+
+/* A segment of the in-process agent's trace buffer (see
+   IPA_TRACE_SEGMENTS).  Each segment is a trace buffer of its own,
+   with the synching scheme described above, written to only by the
+   thread holding the segment's collect lock.  Segments are cache line
+   aligned, so that threads collecting into different segments don't
+   share lines.  */
+
+struct trace_buffer_segment
+{
+  /* The part of the trace buffer this segment uses.  */
+  unsigned char *lo;
+  unsigned char *hi;
+
+  /* The segment's trace buffer controls and token.  */
+  struct trace_buffer_control ctrl[3];
+  unsigned int ctrl_curr;
+
+  /* The segment's traceframe counters.  */
+  unsigned int write_count;
+  unsigned int read_count;
+  int traceframes_created;
+} ATTR_ALIGNED (64);
+
+IP_AGENT_EXPORT struct trace_buffer_segment
+  trace_buffer_segments[IPA_TRACE_SEGMENTS];
+
+/* The segment the current thread collects into, set by gdb_collect
+   and gdb_probe.  This uses the initial-exec TLS model, so that
+   accessing it is a single instruction, and never calls into the
+   dynamic linker from a jump pad.  */
+
+static __thread struct trace_buffer_segment *current_trace_buffer_segment
+  __attribute__ ((tls_model ("initial-exec")));
+
+/* The trace buffer code shared with GDBserver works on the current
+   segment.  */
+# define trace_buffer_lo (current_trace_buffer_segment->lo)
+# define trace_buffer_hi (current_trace_buffer_segment->hi)
+# define trace_buffer_ctrl (current_trace_buffer_segment->ctrl)
+# define trace_buffer_ctrl_curr (current_trace_buffer_segment->ctrl_curr)
 
 # define TRACE_BUFFER_CTRL_CURR \
   (trace_buffer_ctrl_curr & ~GDBSERVER_FLUSH_COUNT_MASK)
 
 #else
 
+/* Same as above, to be used by GDBserver when uploading from the
+   in-process agent.  */
+
+struct ipa_trace_buffer_segment
+{
+  uintptr_t lo;
+  uintptr_t hi;
+  struct ipa_trace_buffer_control ctrl[3];
+  unsigned int ctrl_curr;
+  unsigned int write_count;
+  unsigned int read_count;
+  int traceframes_created;
+} ATTR_ALIGNED (64);
+
+
 /* The GDBserver side agent only needs one instance of this object, as
    it doesn't need to sync with itself.  Define it as array anyway so
    that the rest of the code base doesn't need to care for the
@@ -1090,8 +1165,13 @@ struct trace_buffer_control trace_buffer_ctrl[1];
    of complete traceframes present in the trace buffer.  The IP agent
    writes to the write count, GDBserver writes to read count.  */
 
-IP_AGENT_EXPORT unsigned int traceframe_write_count;
-IP_AGENT_EXPORT unsigned int traceframe_read_count;
+#ifdef IN_PROCESS_AGENT
+# define traceframe_write_count (current_trace_buffer_segment->write_count)
+# define traceframe_read_count (current_trace_buffer_segment->read_count)
+#else
+static unsigned int traceframe_write_count;
+static unsigned int traceframe_read_count;
+#endif
 
 /* Convenience macro.  */
 
@@ -1101,7 +1181,12 @@ IP_AGENT_EXPORT unsigned int traceframe_read_count;
 /* The count of all traceframes created in the current run, including
    ones that were discarded to make room.  */
 
-IP_AGENT_EXPORT int traceframes_created;
+#ifdef IN_PROCESS_AGENT
+# define traceframes_created \
+  (current_trace_buffer_segment->traceframes_created)
+#else
+static int traceframes_created;
+#endif
 
 #ifndef IN_PROCESS_AGENT
 
@@ -1352,36 +1437,37 @@ clear_trace_buffer (void)
 static void
 clear_inferior_trace_buffer (void)
 {
-  CORE_ADDR ipa_trace_buffer_lo;
-  CORE_ADDR ipa_trace_buffer_hi;
-  struct traceframe ipa_traceframe = { 0 };
-  struct ipa_trace_buffer_control ipa_trace_buffer_ctrl;
-
-  read_inferior_data_pointer (ipa_sym_addrs.addr_trace_buffer_lo,
-			      &ipa_trace_buffer_lo);
-  read_inferior_data_pointer (ipa_sym_addrs.addr_trace_buffer_hi,
-			      &ipa_trace_buffer_hi);
+  struct ipa_traceframe ipa_traceframe = { 0 };
+  int i;
 
-  ipa_trace_buffer_ctrl.start = ipa_trace_buffer_lo;
-  ipa_trace_buffer_ctrl.free = ipa_trace_buffer_lo;
-  ipa_trace_buffer_ctrl.end_free = ipa_trace_buffer_hi;
-  ipa_trace_buffer_ctrl.wrap = ipa_trace_buffer_hi;
+  for (i = 0; i < IPA_TRACE_SEGMENTS; i++)
+    {
+      CORE_ADDR segment_addr;
+      struct ipa_trace_buffer_segment segment;
 
-  /* A traceframe with zeroed fields marks the end of trace data.  */
-  write_inferior_memory (ipa_sym_addrs.addr_trace_buffer_ctrl,
-			 (unsigned char *) &ipa_trace_buffer_ctrl,
-			 sizeof (ipa_trace_buffer_ctrl));
+      segment_addr = (ipa_sym_addrs.addr_trace_buffer_segments
+		      + i * sizeof (segment));
+      if (read_inferior_memory (segment_addr, (unsigned char *) &segment,
+				sizeof (segment)))
+	continue;
 
-  write_inferior_uinteger (ipa_sym_addrs.addr_trace_buffer_ctrl_curr, 0);
+      segment.ctrl[0].start = segment.lo;
+      segment.ctrl[0].free = segment.lo;
+      segment.ctrl[0].end_free = segment.hi;
+      segment.ctrl[0].wrap = segment.hi;
+      segment.ctrl_curr = 0;
+      segment.write_count = 0;
+      segment.read_count = 0;
+      segment.traceframes_created = 0;
 
-  /* A traceframe with zeroed fields marks the end of trace data.  */
-  write_inferior_memory (ipa_trace_buffer_lo,
-			 (unsigned char *) &ipa_traceframe,
-			 sizeof (ipa_traceframe));
+      write_inferior_memory (segment_addr, (unsigned char *) &segment,
+			     sizeof (segment));
 
-  write_inferior_uinteger (ipa_sym_addrs.addr_traceframe_write_count, 0);
-  write_inferior_uinteger (ipa_sym_addrs.addr_traceframe_read_count, 0);
-  write_inferior_integer (ipa_sym_addrs.addr_traceframes_created, 0);
+      /* A traceframe with zeroed fields marks the end of trace data.  */
+      write_inferior_memory (segment.lo,
+			     (unsigned char *) &ipa_traceframe,
+			     sizeof (ipa_traceframe));
+    }
 }
 
 #endif
@@ -1389,10 +1475,27 @@ clear_inferior_trace_buffer (void)
 static void
 init_trace_buffer (unsigned char *buf, int bufsize)
 {
+#ifdef IN_PROCESS_AGENT
+  /* Give each segment an equal part of BUF.  */
+  int segment_size = bufsize / IPA_TRACE_SEGMENTS;
+  int i;
+
+  for (i = 0; i < IPA_TRACE_SEGMENTS; i++)
+    {
+      current_trace_buffer_segment = &trace_buffer_segments[i];
+      trace_buffer_lo = buf + i * segment_size;
+      trace_buffer_hi = trace_buffer_lo + segment_size;
+
+      clear_trace_buffer ();
+    }
+
+  current_trace_buffer_segment = NULL;
+#else
   trace_buffer_lo = buf;
   trace_buffer_hi = trace_buffer_lo + bufsize;
 
   clear_trace_buffer ();
+#endif
 }
 
 #ifdef IN_PROCESS_AGENT
@@ -2074,6 +2177,9 @@ add_traceframe (struct tracepoint *tpoint)
 
   tframe->tpnum = tpoint->number;
   tframe->data_size = 0;
+#ifdef IN_PROCESS_AGENT
+  tframe->timestamp = get_timestamp ();
+#endif
 
   return tframe;
 }
@@ -4586,7 +4692,12 @@ condition_true_at_tracepoint (struct tracepoint_hit_ctx *ctx,
      used.  */
 #ifdef IN_PROCESS_AGENT
   if (tpoint->compiled_cond)
-    err = ((condfn) (uintptr_t) (tpoint->compiled_cond)) (ctx, &value);
+    {
+      struct fast_tracepoint_ctx *fctx = (struct fast_tracepoint_ctx *) ctx;
+
+      err = ((condfn) (uintptr_t) (tpoint->compiled_cond)) (fctx->regs,
+							     &value);
+    }
   else
 #endif
     err = eval_agent_expr (ctx, NULL, tpoint->cond, &value);
@@ -4627,6 +4738,58 @@ parse_agent_expr (char **actparm)
   return aexpr;
 }
 
+/* Parse the agent expression at *ACTPARM, as sent with a Z0 packet
+   for the breakpoint's condition, and advance *ACTPARM past it.
+   Unlike parse_agent_expr, check that the expression is well formed,
+   and return NULL if it is not.  */
+
+struct agent_expr *
+gdb_parse_agent_expr (char **actparm)
+{
+  char *act = *actparm;
+  ULONGEST xlen;
+
+  if (*act != 'X')
+    return NULL;
+  act = unpack_varlen_hex (act + 1, &xlen);
+  if (*act != ',' || xlen == 0 || strlen (act + 1) < 2 * xlen)
+    return NULL;
+
+  return parse_agent_expr (actparm);
+}
+
+/* Free an agent expression returned by gdb_parse_agent_expr.  */
+
+void
+gdb_free_agent_expr (struct agent_expr *aexpr)
+{
+  if (aexpr != NULL)
+    {
+      free (aexpr->bytes);
+      free (aexpr);
+    }
+}
+
+/* Evaluate COND, the condition of a GDB breakpoint, against the
+   registers in REGCACHE, and store its value in *VALUE.  Return
+   nonzero if the condition could not be evaluated.  */
+
+int
+gdb_eval_breakpoint_condition (struct regcache *regcache,
+			       struct agent_expr *cond, ULONGEST *value)
+{
+  struct trap_tracepoint_ctx ctx;
+
+  /* Breakpoint conditions never collect data, so evaluate them as if
+     for a trap tracepoint without a traceframe.  */
+  ctx.base.type = trap_tracepoint;
+  ctx.regcache = regcache;
+
+  return (eval_agent_expr ((struct tracepoint_hit_ctx *) &ctx, NULL,
+			   cond, value)
+	  != expr_eval_no_error);
+}
+
 /* Convert the bytes of an agent expression back into hex digits, so
    they can be printed or uploaded.  This allocates the buffer,
    callers should free when they are done with it.  */
@@ -5664,10 +5827,38 @@ typedef struct collecting_t
 
 #ifndef IN_PROCESS_AGENT
 
+/* Return the address of the collect lock the jump pads have the
+   thread identified by THREAD_AREA take.  */
+
+static CORE_ADDR
+ipa_collect_lock_address (CORE_ADDR thread_area)
+{
+  return (ipa_sym_addrs.addr_collecting
+	  + ((CORE_ADDR) IPA_TRACE_SEGMENT (thread_area)
+	     << IPA_COLLECT_LOCK_SIZE_LOG2));
+}
+
+/* Release the collect lock held by the thread identified by
+   THREAD_AREA, if it holds it.  */
+
 void
-force_unlock_trace_buffer (void)
+force_unlock_trace_buffer (CORE_ADDR thread_area)
 {
-  write_inferior_data_pointer (ipa_sym_addrs.addr_collecting, 0);
+  CORE_ADDR lock_addr = ipa_collect_lock_address (thread_area);
+  CORE_ADDR ipa_collecting;
+  collecting_t ipa_collecting_obj;
+
+  if (read_inferior_data_pointer (lock_addr, &ipa_collecting)
+      || ipa_collecting == 0)
+    return;
+
+  if (read_inferior_memory (ipa_collecting,
+			    (unsigned char *) &ipa_collecting_obj,
+			    sizeof (ipa_collecting_obj)) == 0
+      && ipa_collecting_obj.thread_area != thread_area)
+    return;
+
+  write_inferior_data_pointer (lock_addr, 0);
 }
 
 /* Check if the thread identified by THREAD_AREA which is stopped at
@@ -5790,11 +5981,11 @@ fast_tracepoint_collecting (CORE_ADDR thread_area,
     {
       collecting_t ipa_collecting_obj;
 
-      /* If `collecting' is set/locked, then the THREAD_AREA thread
-	 may or not be the one holding the lock.  We have to read the
-	 lock to find out.  */
+      /* If the collect lock of THREAD_AREA's trace buffer segment is
+	 set/locked, then the THREAD_AREA thread may or not be the one
+	 holding the lock.  We have to read the lock to find out.  */
 
-      if (read_inferior_data_pointer (ipa_sym_addrs.addr_collecting,
+      if (read_inferior_data_pointer (ipa_collect_lock_address (thread_area),
 				      &ipa_collecting))
 	{
 	  trace_debug ("fast_tracepoint_collecting:"
@@ -5844,6 +6035,7 @@ fast_tracepoint_collecting (CORE_ADDR thread_area,
       status->tpoint_addr = tpoint->address;
       status->adjusted_insn_addr = tpoint->adjusted_insn_addr;
       status->adjusted_insn_addr_end = tpoint->adjusted_insn_addr_end;
+      status->thread_area = thread_area;
     }
 
   if (needs_breakpoint)
@@ -5875,19 +6067,29 @@ fast_tracepoint_collecting, returning continue-until-break at %s",
 
 #ifdef IN_PROCESS_AGENT
 
-/* The global fast tracepoint collect lock.  Points to a collecting_t
-   object built on the stack by the jump pad, if presently locked;
-   NULL if it isn't locked.  Note that this lock *must* be set while
-   executing any *function other than the jump pad.  See
+/* A fast tracepoint collect lock.  Points to a collecting_t object
+   built on the stack by the jump pad, if presently locked; NULL if it
+   isn't locked.  */
+
+struct collect_lock
+{
+  collecting_t *owner;
+} ATTR_ALIGNED (1 << IPA_COLLECT_LOCK_SIZE_LOG2);
+
+/* The collect locks of the trace buffer segments.  Note that the lock
+   of a thread's segment *must* be set while the thread executes any
+   *function other than the jump pad.  See
    fast_tracepoint_collecting.  */
-static collecting_t * ATTR_USED collecting;
+static struct collect_lock ATTR_USED collecting[IPA_TRACE_SEGMENTS];
 
 /* This routine, called from the jump pad (in asm) is designed to be
    called from the jump pads of fast tracepoints, thus it is on the
-   critical path.  */
+   critical path.  LOCK is the collect lock the jump pad took, that of
+   the trace buffer segment to collect into.  */
 
 IP_AGENT_EXPORT void ATTR_USED
-gdb_collect (struct tracepoint *tpoint, unsigned char *regs)
+gdb_collect (struct tracepoint *tpoint, unsigned char *regs,
+	     struct collect_lock *lock)
 {
   struct fast_tracepoint_ctx ctx;
 
@@ -5895,6 +6097,8 @@ gdb_collect (struct tracepoint *tpoint, unsigned char *regs)
   if (!tracing)
     return;
 
+  current_trace_buffer_segment = &trace_buffer_segments[lock - collecting];
+
   ctx.base.type = fast_tracepoint;
   ctx.regs = regs;
   ctx.regcache_initted = 0;
@@ -6199,6 +6403,30 @@ emit_le_goto (int *offset_p, int *size_p)
   target_emit_ops ()->emit_le_goto (offset_p, size_p);
 }
 
+static void
+emit_div_signed (void)
+{
+  target_emit_ops ()->emit_div_signed (expr_eval_divide_by_zero);
+}
+
+static void
+emit_div_unsigned (void)
+{
+  target_emit_ops ()->emit_div_unsigned (expr_eval_divide_by_zero);
+}
+
+static void
+emit_rem_signed (void)
+{
+  target_emit_ops ()->emit_rem_signed (expr_eval_divide_by_zero);
+}
+
+static void
+emit_rem_unsigned (void)
+{
+  target_emit_ops ()->emit_rem_unsigned (expr_eval_divide_by_zero);
+}
+
 static enum eval_result_type compile_bytecodes (struct agent_expr *aexpr);
 
 static void
@@ -6335,19 +6563,27 @@ compile_bytecodes (struct agent_expr *aexpr)
 	  break;
 
 	case gdb_agent_op_div_signed:
-	  UNHANDLED;
+	  if (target_emit_ops ()->emit_div_signed == NULL)
+	    UNHANDLED;
+	  emit_div_signed ();
 	  break;
 
 	case gdb_agent_op_div_unsigned:
-	  UNHANDLED;
+	  if (target_emit_ops ()->emit_div_unsigned == NULL)
+	    UNHANDLED;
+	  emit_div_unsigned ();
 	  break;
 
 	case gdb_agent_op_rem_signed:
-	  UNHANDLED;
+	  if (target_emit_ops ()->emit_rem_signed == NULL)
+	    UNHANDLED;
+	  emit_rem_signed ();
 	  break;
 
 	case gdb_agent_op_rem_unsigned:
-	  UNHANDLED;
+	  if (target_emit_ops ()->emit_rem_unsigned == NULL)
+	    UNHANDLED;
+	  emit_rem_unsigned ();
 	  break;
 
 	case gdb_agent_op_lsh:
@@ -7022,252 +7258,310 @@ download_trace_state_variables (void)
     }
 }
 
-/* Upload complete trace frames out of the IP Agent's trace buffer
-   into GDBserver's trace buffer.  This always uploads either all or
-   no trace frames.  This is the counter part of
-   `trace_alloc_trace_buffer'.  See its description of the atomic
-   synching mechanism.  */
+/* The state of uploading the traceframes of one of the in-process
+   agent's trace buffer segments.  */
 
-static void
-upload_fast_traceframes (void)
+struct ipa_segment_upload
 {
-  unsigned int ipa_traceframe_read_count, ipa_traceframe_write_count;
-  unsigned int ipa_traceframe_read_count_racy, ipa_traceframe_write_count_racy;
-  CORE_ADDR tf;
-  struct ipa_trace_buffer_control ipa_trace_buffer_ctrl;
-  unsigned int curr_tbctrl_idx;
-  unsigned int ipa_trace_buffer_ctrl_curr;
-  unsigned int ipa_trace_buffer_ctrl_curr_old;
-  CORE_ADDR ipa_trace_buffer_ctrl_addr;
-  struct breakpoint *about_to_request_buffer_space_bkpt;
-  CORE_ADDR ipa_trace_buffer_lo;
-  CORE_ADDR ipa_trace_buffer_hi;
-
-  if (read_inferior_uinteger (ipa_sym_addrs.addr_traceframe_read_count,
-			      &ipa_traceframe_read_count_racy))
-    {
-      /* This will happen in most targets if the current thread is
-	 running.  */
-      return;
-    }
+  /* Address of the segment in the inferior, and a copy of it.  */
+  CORE_ADDR addr;
+  struct ipa_trace_buffer_segment segment;
 
-  if (read_inferior_uinteger (ipa_sym_addrs.addr_traceframe_write_count,
-			      &ipa_traceframe_write_count_racy))
-    return;
+  /* Nonzero if GDBserver stamped the segment's token, and so must
+     write back its trace buffer control and read count.  */
+  int stamped;
 
-  trace_debug ("ipa_traceframe_count (racy area): %d (w=%d, r=%d)",
-	       ipa_traceframe_write_count_racy
-	       - ipa_traceframe_read_count_racy,
-	       ipa_traceframe_write_count_racy,
-	       ipa_traceframe_read_count_racy);
+  /* Index of the segment's current trace buffer control, and our
+     updated copy of it.  */
+  unsigned int curr_tbctrl_idx;
+  struct ipa_trace_buffer_control ctrl;
 
-  if (ipa_traceframe_write_count_racy == ipa_traceframe_read_count_racy)
-    return;
+  /* Address and header of the oldest traceframe of the segment not
+     uploaded yet.  Only valid while the segment's read count is
+     behind its write count.  */
+  CORE_ADDR tf;
+  struct ipa_traceframe tframe;
+};
 
-  about_to_request_buffer_space_bkpt
-    = set_breakpoint_at (ipa_sym_addrs.addr_about_to_request_buffer_space,
-			 NULL);
+/* Return the number of traceframes of UP not uploaded yet.  */
 
-  if (read_inferior_uinteger (ipa_sym_addrs.addr_trace_buffer_ctrl_curr,
-			      &ipa_trace_buffer_ctrl_curr))
-    return;
+static unsigned int
+ipa_segment_traceframe_count (struct ipa_segment_upload *up)
+{
+  return up->segment.write_count - up->segment.read_count;
+}
 
-  ipa_trace_buffer_ctrl_curr_old = ipa_trace_buffer_ctrl_curr;
+/* Read the header of UP's traceframe at UP->tf.  */
 
-  curr_tbctrl_idx = ipa_trace_buffer_ctrl_curr & ~GDBSERVER_FLUSH_COUNT_MASK;
+static void
+ipa_segment_read_traceframe (struct ipa_segment_upload *up)
+{
+  if (read_inferior_memory (up->tf, (unsigned char *) &up->tframe,
+			    offsetof (struct ipa_traceframe, data)))
+    error ("Uploading: couldn't read traceframe at %s\n",
+	   paddress (up->tf));
 
-  {
-    unsigned int prev, counter;
+  if (up->tframe.tpnum == 0)
+    fatal ("Uploading: No (more) fast traceframes, but "
+	   "ipa_traceframe_count == %u??\n",
+	   ipa_segment_traceframe_count (up));
+}
 
-    /* Update the token, with new counters, and the GDBserver stamp
-       bit.  Alway reuse the current TBC index.  */
-    prev = ipa_trace_buffer_ctrl_curr & GDBSERVER_FLUSH_COUNT_MASK_CURR;
-    counter = (prev + 0x100) & GDBSERVER_FLUSH_COUNT_MASK_CURR;
+/* Stamp the token of UP's segment, so that a thread about to commit
+   an allocation in the segment notices GDBserver has been there, and
+   read the segment's current state.  Must be called with the
+   `about_to_request_buffer_space' breakpoint inserted.  Returns 0 on
+   success.  */
 
-    ipa_trace_buffer_ctrl_curr = (GDBSERVER_UPDATED_FLUSH_COUNT_BIT
-				  | (prev << 12)
-				  | counter
-				  | curr_tbctrl_idx);
-  }
+static int
+ipa_segment_begin_upload (struct ipa_segment_upload *up)
+{
+  CORE_ADDR token_addr;
+  unsigned int token, token_old;
+  unsigned int prev, counter;
 
-  if (write_inferior_uinteger (ipa_sym_addrs.addr_trace_buffer_ctrl_curr,
-			       ipa_trace_buffer_ctrl_curr))
-    return;
+  token_addr = up->addr + offsetof (struct ipa_trace_buffer_segment,
+				    ctrl_curr);
+  if (read_inferior_uinteger (token_addr, &token))
+    return -1;
 
-  trace_debug ("Lib: Committed %08x -> %08x",
-	       ipa_trace_buffer_ctrl_curr_old,
-	       ipa_trace_buffer_ctrl_curr);
+  token_old = token;
+  up->curr_tbctrl_idx = token & ~GDBSERVER_FLUSH_COUNT_MASK;
 
-  /* Re-read these, now that we've installed the
-     `about_to_request_buffer_space' breakpoint/lock.  A thread could
-     have finished a traceframe between the last read of these
-     counters and setting the breakpoint above.  If we start
-     uploading, we never want to leave this function with
-     traceframe_read_count != 0, otherwise, GDBserver could end up
-     incrementing the counter tokens more than once (due to event loop
-     nesting), which would break the IP agent's "effective" detection
-     (see trace_alloc_trace_buffer).  */
-  if (read_inferior_uinteger (ipa_sym_addrs.addr_traceframe_read_count,
-			      &ipa_traceframe_read_count))
-    return;
-  if (read_inferior_uinteger (ipa_sym_addrs.addr_traceframe_write_count,
-			      &ipa_traceframe_write_count))
-    return;
+  /* Update the token, with new counters, and the GDBserver stamp
+     bit.  Alway reuse the current TBC index.  */
+  prev = token & GDBSERVER_FLUSH_COUNT_MASK_CURR;
+  counter = (prev + 0x100) & GDBSERVER_FLUSH_COUNT_MASK_CURR;
 
-  if (debug_threads)
-    {
-      trace_debug ("ipa_traceframe_count (blocked area): %d (w=%d, r=%d)",
-		   ipa_traceframe_write_count - ipa_traceframe_read_count,
-		   ipa_traceframe_write_count, ipa_traceframe_read_count);
+  token = (GDBSERVER_UPDATED_FLUSH_COUNT_BIT
+	   | (prev << 12)
+	   | counter
+	   | up->curr_tbctrl_idx);
 
-      if (ipa_traceframe_write_count != ipa_traceframe_write_count_racy
-	  || ipa_traceframe_read_count != ipa_traceframe_read_count_racy)
-	trace_debug ("note that ipa_traceframe_count's parts changed");
-    }
+  if (write_inferior_uinteger (token_addr, token))
+    return -1;
 
-  /* Get the address of the current TBC object (the IP agent has an
-     array of 3 such objects).  The index is stored in the TBC
-     token.  */
-  ipa_trace_buffer_ctrl_addr = ipa_sym_addrs.addr_trace_buffer_ctrl;
-  ipa_trace_buffer_ctrl_addr
-    += sizeof (struct ipa_trace_buffer_control) * curr_tbctrl_idx;
+  up->stamped = 1;
 
-  if (read_inferior_memory (ipa_trace_buffer_ctrl_addr,
-			    (unsigned char *) &ipa_trace_buffer_ctrl,
-			    sizeof (struct ipa_trace_buffer_control)))
-    return;
+  trace_debug ("Lib: Committed %08x -> %08x", token_old, token);
 
-  if (read_inferior_data_pointer (ipa_sym_addrs.addr_trace_buffer_lo,
-				  &ipa_trace_buffer_lo))
-    return;
-  if (read_inferior_data_pointer (ipa_sym_addrs.addr_trace_buffer_hi,
-				  &ipa_trace_buffer_hi))
-    return;
+  /* Re-read the segment, now that we've installed the
+     `about_to_request_buffer_space' breakpoint/lock.  A thread could
+     have finished a traceframe between the last read of its counters
+     and setting the breakpoint.  If we start uploading, we never want
+     to leave upload_fast_traceframes with the segment's read count
+     behind, otherwise, GDBserver could end up incrementing the
+     counter tokens more than once (due to event loop nesting), which
+     would break the IP agent's "effective" detection (see
+     trace_buffer_alloc).  */
+  if (read_inferior_memory (up->addr, (unsigned char *) &up->segment,
+			    sizeof (up->segment)))
+    return -1;
+
+  trace_debug ("ipa_traceframe_count (blocked area): %d (w=%d, r=%d)",
+	       ipa_segment_traceframe_count (up),
+	       up->segment.write_count, up->segment.read_count);
+
+  up->ctrl = up->segment.ctrl[up->curr_tbctrl_idx];
 
   /* Offsets are easier to grok for debugging than raw addresses,
      especially for the small trace buffer sizes that are useful for
      testing.  */
   trace_debug ("Lib: Trace buffer [%d] start=%d free=%d "
 	       "endfree=%d wrap=%d hi=%d",
-	       curr_tbctrl_idx,
-	       (int) (ipa_trace_buffer_ctrl.start - ipa_trace_buffer_lo),
-	       (int) (ipa_trace_buffer_ctrl.free - ipa_trace_buffer_lo),
-	       (int) (ipa_trace_buffer_ctrl.end_free - ipa_trace_buffer_lo),
-	       (int) (ipa_trace_buffer_ctrl.wrap - ipa_trace_buffer_lo),
-	       (int) (ipa_trace_buffer_hi - ipa_trace_buffer_lo));
+	       up->curr_tbctrl_idx,
+	       (int) (up->ctrl.start - up->segment.lo),
+	       (int) (up->ctrl.free - up->segment.lo),
+	       (int) (up->ctrl.end_free - up->segment.lo),
+	       (int) (up->ctrl.wrap - up->segment.lo),
+	       (int) (up->segment.hi - up->segment.lo));
 
   /* Note that the IPA's buffer is always circular.  */
+  up->tf = up->ctrl.start;
+  if (ipa_segment_traceframe_count (up) != 0)
+    ipa_segment_read_traceframe (up);
 
-#define IPA_FIRST_TRACEFRAME() (ipa_trace_buffer_ctrl.start)
+  return 0;
+}
+
+/* Copy UP's oldest traceframe to GDBserver's trace buffer, and
+   discard it from the segment.  */
+
+static void
+ipa_segment_upload_traceframe (struct ipa_segment_upload *up)
+{
+  struct tracepoint *tpoint;
+  struct traceframe *tframe;
+  unsigned char *block;
+  CORE_ADDR data = up->tf + offsetof (struct ipa_traceframe, data);
+
+  /* Note that this will be incorrect for multi-location
+     tracepoints...  */
+  tpoint = find_next_tracepoint_by_number (NULL, up->tframe.tpnum);
+
+  tframe = add_traceframe (tpoint);
+  if (tframe == NULL)
+    {
+      trace_buffer_is_full = 1;
+      trace_debug ("Uploading: trace buffer is full");
+    }
+  else
+    {
+      /* Copy the whole set of blocks in one go for now.  FIXME:
+	 split this in smaller blocks.  */
+      block = add_traceframe_block (tframe, up->tframe.data_size);
+      if (block != NULL)
+	{
+	  if (read_inferior_memory (data, block, up->tframe.data_size))
+	    error ("Uploading: Couldn't read traceframe data at %s\n",
+		   paddress (data));
+	}
 
-#define IPA_NEXT_TRACEFRAME_1(TF, TFOBJ)		\
-  ((TF) + sizeof (struct traceframe) + (TFOBJ)->data_size)
+      trace_debug ("Uploading: traceframe didn't fit");
+      finish_traceframe (tframe);
+    }
 
-#define IPA_NEXT_TRACEFRAME(TF, TFOBJ)					\
-  (IPA_NEXT_TRACEFRAME_1 (TF, TFOBJ)					\
-   - ((IPA_NEXT_TRACEFRAME_1 (TF, TFOBJ) >= ipa_trace_buffer_ctrl.wrap) \
-      ? (ipa_trace_buffer_ctrl.wrap - ipa_trace_buffer_lo)		\
-      : 0))
+  /* Move to the next traceframe.  If the computed location is beyond
+     the wraparound point, subtract the offset of the wraparound.  */
+  up->tf = data + up->tframe.data_size;
+  if (up->tf >= up->ctrl.wrap)
+    up->tf -= up->ctrl.wrap - up->segment.lo;
 
-  tf = IPA_FIRST_TRACEFRAME ();
+  /* If we freed the traceframe that wrapped around, go back to the
+     non-wrap case.  */
+  if (up->tf < up->ctrl.start)
+    {
+      trace_debug ("Lib: Discarding past the wraparound");
+      up->ctrl.wrap = up->segment.hi;
+    }
+  up->ctrl.start = up->tf;
+  up->ctrl.end_free = up->ctrl.start;
+  ++up->segment.read_count;
 
-  while (ipa_traceframe_write_count - ipa_traceframe_read_count)
+  if (up->ctrl.start == up->ctrl.free
+      && up->ctrl.start == up->ctrl.end_free)
     {
-      struct tracepoint *tpoint;
-      struct traceframe *tframe;
-      unsigned char *block;
-      struct traceframe ipa_tframe;
+      trace_debug ("Lib: buffer is fully empty.  "
+		   "Trace buffer [%d] start=%d free=%d endfree=%d",
+		   up->curr_tbctrl_idx,
+		   (int) (up->ctrl.start - up->segment.lo),
+		   (int) (up->ctrl.free - up->segment.lo),
+		   (int) (up->ctrl.end_free - up->segment.lo));
 
-      if (read_inferior_memory (tf, (unsigned char *) &ipa_tframe,
-				offsetof (struct traceframe, data)))
-	error ("Uploading: couldn't read traceframe at %s\n", paddress (tf));
+      up->ctrl.start = up->segment.lo;
+      up->ctrl.free = up->segment.lo;
+      up->ctrl.end_free = up->segment.hi;
+      up->ctrl.wrap = up->segment.hi;
+    }
 
-      if (ipa_tframe.tpnum == 0)
-	fatal ("Uploading: No (more) fast traceframes, but "
-	       "ipa_traceframe_count == %u??\n",
-	       ipa_traceframe_write_count - ipa_traceframe_read_count);
+  trace_debug ("Uploaded a traceframe\n"
+	       "Lib: Trace buffer [%d] start=%d free=%d "
+	       "endfree=%d wrap=%d hi=%d",
+	       up->curr_tbctrl_idx,
+	       (int) (up->ctrl.start - up->segment.lo),
+	       (int) (up->ctrl.free - up->segment.lo),
+	       (int) (up->ctrl.end_free - up->segment.lo),
+	       (int) (up->ctrl.wrap - up->segment.lo),
+	       (int) (up->segment.hi - up->segment.lo));
 
-      /* Note that this will be incorrect for multi-location
-	 tracepoints...  */
-      tpoint = find_next_tracepoint_by_number (NULL, ipa_tframe.tpnum);
+  if (ipa_segment_traceframe_count (up) != 0)
+    ipa_segment_read_traceframe (up);
+}
 
-      tframe = add_traceframe (tpoint);
-      if (tframe == NULL)
-	{
-	  trace_buffer_is_full = 1;
-	  trace_debug ("Uploading: trace buffer is full");
-	}
-      else
-	{
-	  /* Copy the whole set of blocks in one go for now.  FIXME:
-	     split this in smaller blocks.  */
-	  block = add_traceframe_block (tframe, ipa_tframe.data_size);
-	  if (block != NULL)
-	    {
-	      if (read_inferior_memory (tf
-					+ offsetof (struct traceframe, data),
-					block, ipa_tframe.data_size))
-		error ("Uploading: Couldn't read traceframe data at %s\n",
-		       paddress (tf + offsetof (struct traceframe, data)));
-	    }
+/* Write back the trace buffer control and read count of UP's
+   segment.  */
 
-	  trace_debug ("Uploading: traceframe didn't fit");
-	  finish_traceframe (tframe);
-	}
+static void
+ipa_segment_end_upload (struct ipa_segment_upload *up)
+{
+  CORE_ADDR ctrl_addr;
 
-      tf = IPA_NEXT_TRACEFRAME (tf, &ipa_tframe);
+  ctrl_addr = (up->addr
+	       + offsetof (struct ipa_trace_buffer_segment, ctrl)
+	       + (sizeof (struct ipa_trace_buffer_control)
+		  * up->curr_tbctrl_idx));
+  if (write_inferior_memory (ctrl_addr, (unsigned char *) &up->ctrl,
+			     sizeof (struct ipa_trace_buffer_control)))
+    return;
 
-      /* If we freed the traceframe that wrapped around, go back
-	 to the non-wrap case.  */
-      if (tf < ipa_trace_buffer_ctrl.start)
-	{
-	  trace_debug ("Lib: Discarding past the wraparound");
-	  ipa_trace_buffer_ctrl.wrap = ipa_trace_buffer_hi;
-	}
-      ipa_trace_buffer_ctrl.start = tf;
-      ipa_trace_buffer_ctrl.end_free = ipa_trace_buffer_ctrl.start;
-      ++ipa_traceframe_read_count;
+  write_inferior_uinteger (up->addr
+			   + offsetof (struct ipa_trace_buffer_segment,
+				       read_count),
+			   up->segment.read_count);
 
-      if (ipa_trace_buffer_ctrl.start == ipa_trace_buffer_ctrl.free
-	  && ipa_trace_buffer_ctrl.start == ipa_trace_buffer_ctrl.end_free)
-	{
-	  trace_debug ("Lib: buffer is fully empty.  "
-		       "Trace buffer [%d] start=%d free=%d endfree=%d",
-		       curr_tbctrl_idx,
-		       (int) (ipa_trace_buffer_ctrl.start
-			      - ipa_trace_buffer_lo),
-		       (int) (ipa_trace_buffer_ctrl.free
-			      - ipa_trace_buffer_lo),
-		       (int) (ipa_trace_buffer_ctrl.end_free
-			      - ipa_trace_buffer_lo));
-
-	  ipa_trace_buffer_ctrl.start = ipa_trace_buffer_lo;
-	  ipa_trace_buffer_ctrl.free = ipa_trace_buffer_lo;
-	  ipa_trace_buffer_ctrl.end_free = ipa_trace_buffer_hi;
-	  ipa_trace_buffer_ctrl.wrap = ipa_trace_buffer_hi;
-	}
+  trace_debug ("Done uploading traceframes [%d]\n", up->curr_tbctrl_idx);
+}
 
-      trace_debug ("Uploaded a traceframe\n"
-		   "Lib: Trace buffer [%d] start=%d free=%d "
-		   "endfree=%d wrap=%d hi=%d",
-		   curr_tbctrl_idx,
-		   (int) (ipa_trace_buffer_ctrl.start - ipa_trace_buffer_lo),
-		   (int) (ipa_trace_buffer_ctrl.free - ipa_trace_buffer_lo),
-		   (int) (ipa_trace_buffer_ctrl.end_free
-			  - ipa_trace_buffer_lo),
-		   (int) (ipa_trace_buffer_ctrl.wrap - ipa_trace_buffer_lo),
-		   (int) (ipa_trace_buffer_hi - ipa_trace_buffer_lo));
+/* Upload complete trace frames out of the IP Agent's trace buffer
+   into GDBserver's trace buffer.  This always uploads either all or
+   no trace frames of each segment, merging the segments' traceframes
+   in the order they were collected.  This is the counter part of
+   `trace_buffer_alloc'.  See its description of the atomic synching
+   mechanism.  */
+
+static void
+upload_fast_traceframes (void)
+{
+  struct ipa_segment_upload up[IPA_TRACE_SEGMENTS];
+  struct ipa_trace_buffer_segment segments[IPA_TRACE_SEGMENTS];
+  struct breakpoint *about_to_request_buffer_space_bkpt;
+  unsigned int count = 0;
+  int i;
+
+  if (read_inferior_memory (ipa_sym_addrs.addr_trace_buffer_segments,
+			    (unsigned char *) segments, sizeof (segments)))
+    {
+      /* This will happen in most targets if the current thread is
+	 running.  */
+      return;
     }
 
-  if (write_inferior_memory (ipa_trace_buffer_ctrl_addr,
-			     (unsigned char *) &ipa_trace_buffer_ctrl,
-			     sizeof (struct ipa_trace_buffer_control)))
+  for (i = 0; i < IPA_TRACE_SEGMENTS; i++)
+    count += segments[i].write_count - segments[i].read_count;
+
+  trace_debug ("ipa_traceframe_count (racy area): %d", count);
+
+  if (count == 0)
     return;
 
-  write_inferior_integer (ipa_sym_addrs.addr_traceframe_read_count,
-			  ipa_traceframe_read_count);
+  about_to_request_buffer_space_bkpt
+    = set_breakpoint_at (ipa_sym_addrs.addr_about_to_request_buffer_space,
+			 NULL);
+
+  memset (up, 0, sizeof (up));
+  for (i = 0; i < IPA_TRACE_SEGMENTS; i++)
+    {
+      up[i].addr = (ipa_sym_addrs.addr_trace_buffer_segments
+		    + i * sizeof (struct ipa_trace_buffer_segment));
 
-  trace_debug ("Done uploading traceframes [%d]\n", curr_tbctrl_idx);
+      /* Leave segments that had nothing to upload alone; whatever
+	 they collect meanwhile is uploaded on the next flush.  */
+      if (segments[i].write_count != segments[i].read_count)
+	ipa_segment_begin_upload (&up[i]);
+    }
+
+  /* Each segment's traceframes are in collection order already;
+     repeatedly take the oldest of the segments' oldest ones.  */
+  while (1)
+    {
+      struct ipa_segment_upload *oldest = NULL;
+
+      for (i = 0; i < IPA_TRACE_SEGMENTS; i++)
+	if (up[i].stamped
+	    && ipa_segment_traceframe_count (&up[i]) != 0
+	    && (oldest == NULL
+		|| up[i].tframe.timestamp < oldest->tframe.timestamp))
+	  oldest = &up[i];
+
+      if (oldest == NULL)
+	break;
+
+      ipa_segment_upload_traceframe (oldest);
+    }
+
+  for (i = 0; i < IPA_TRACE_SEGMENTS; i++)
+    if (up[i].stamped)
+      ipa_segment_end_upload (&up[i]);
 
   pause_all (1);
   cancel_breakpoints ();
@@ -7405,6 +7699,11 @@ gdb_probe (const struct marker *mdata, void *probe_private,
       return;
     }
 
+  /* Static tracepoint probes are not called from a jump pad, and
+     take no collect lock; they always collect into the first trace
+     buffer segment.  */
+  current_trace_buffer_segment = &trace_buffer_segments[0];
+
   ctx.base.type = static_tracepoint;
   ctx.regcache_initted = 0;
   ctx.regs = regs;
@@ -23,6 +23,7 @@
 #include "jit-reader.h"
 #include "block.h"
 #include "breakpoint.h"
+#include "buildsym.h"
 #include "command.h"
 #include "dictionary.h"
 #include "frame-unwind.h"
@@ -578,6 +579,7 @@ finalize_symtab (struct gdb_symtab *stab, struct objfile *objfile)
                   + sizeof (struct linetable));
       LINETABLE (symtab) = obstack_alloc (&objfile->objfile_obstack, size);
       memcpy (LINETABLE (symtab), stab->linetable, size);
+      sort_linetable (LINETABLE (symtab));
     }
   else
     {
@@ -663,6 +665,8 @@ finalize_symtab (struct gdb_symtab *stab, struct objfile *objfile)
           gdb_block_iter->parent->real_block;
     }
 
+  add_symtab_to_pc_map (symtab);
+
   /* Free memory.  */
   gdb_block_iter = stab->blocks;
 
@@ -286,6 +286,18 @@ struct lwp_info;
 static struct lwp_info *add_lwp (ptid_t ptid);
 static void purge_lwp_list (int pid);
 static struct lwp_info *find_lwp_pid (ptid_t ptid);
+static void linux_proc_mem_invalidate (int pid);
+
+/* A file descriptor open on /proc/PID/mem of the process we last
+   transferred memory from, or -1.  Opening the file is far more
+   expensive than the pread64/pwrite64 done through it, so keep it
+   around for as long as the address space it refers to exists.  */
+
+static int linux_proc_mem_fd = -1;
+
+/* The thread group id of the process LINUX_PROC_MEM_FD refers to.  */
+
+static int linux_proc_mem_pid;
 
 
 /* Trivial list manipulation functions to keep track of a list of
@@ -597,6 +609,10 @@ linux_child_follow_fork (struct target_ops *ops, int follow_child)
     parent_pid = ptid_get_pid (inferior_ptid);
   child_pid = PIDGET (inferior_thread ()->pending_follow.value.related_pid);
 
+  /* We may be about to detach from the parent, after which its pid
+     can be reused.  */
+  linux_proc_mem_invalidate (ptid_get_pid (inferior_ptid));
+
   if (!detach_fork)
     linux_enable_event_reporting (pid_to_ptid (child_pid));
 
@@ -1784,6 +1800,7 @@ linux_nat_detach (struct target_ops *ops, char *args, int from_tty)
     }
 
   delete_lwp (main_lwp->ptid);
+  linux_proc_mem_invalidate (pid);
 
   if (forks_exist_p ())
     {
@@ -2353,6 +2370,9 @@ linux_handle_extended_wait (struct lwp_info *lp, int status,
       ourstatus->value.execd_pathname
 	= xstrdup (linux_child_pid_to_exec_file (pid));
 
+      /* The old address space is gone.  */
+      linux_proc_mem_invalidate (GET_PID (lp->ptid));
+
       return 0;
     }
 
@@ -4123,6 +4143,7 @@ static void
 linux_nat_mourn_inferior (struct target_ops *ops)
 {
   purge_lwp_list (ptid_get_pid (inferior_ptid));
+  linux_proc_mem_invalidate (ptid_get_pid (inferior_ptid));
 
   if (! forks_exist_p ())
     /* Normal case, no other forks available.  */
@@ -5084,50 +5105,135 @@ linux_nat_info_proc_cmd_all (char *args, int from_tty)
   linux_nat_info_proc_cmd_1 (args, IP_ALL, from_tty);
 }
 
-/* Implement the to_xfer_partial interface for memory reads using the /proc
-   filesystem.  Because we can use a single read() call for /proc, this
-   can be much more efficient than banging away at PTRACE_PEEKTEXT,
-   but it doesn't support writes.  */
+/* Forget the cached /proc/PID/mem file of process PID, if that is
+   the one we have open.  This must be called whenever the address
+   space of PID goes away: on exec, on exit and on detach (after
+   which the pid may be reused).  */
 
-static LONGEST
-linux_proc_xfer_partial (struct target_ops *ops, enum target_object object,
-			 const char *annex, gdb_byte *readbuf,
-			 const gdb_byte *writebuf,
-			 ULONGEST offset, LONGEST len)
+static void
+linux_proc_mem_invalidate (int pid)
 {
-  LONGEST ret;
-  int fd;
+  if (linux_proc_mem_fd != -1 && linux_proc_mem_pid == pid)
+    {
+      close (linux_proc_mem_fd);
+      linux_proc_mem_fd = -1;
+    }
+}
+
+/* Return a file descriptor open on the memory of thread LWPID, or -1
+   if /proc/LWPID/mem can't be opened.  The file is opened for
+   writing too if the kernel lets us.  */
+
+static int
+linux_proc_mem_open (int lwpid)
+{
+  struct lwp_info *lp;
+  int pid, fd;
   char filename[64];
 
-  if (object != TARGET_OBJECT_MEMORY || !readbuf)
-    return 0;
+  /* All the threads of a process share the same address space, so
+     cache the file per thread group; the descriptor stays usable
+     even if the thread we opened it through exits.  */
+  lp = find_lwp_pid (pid_to_ptid (lwpid));
+  pid = lp != NULL ? GET_PID (lp->ptid) : lwpid;
 
-  /* Don't bother for one word.  */
-  if (len < 3 * sizeof (long))
-    return 0;
+  if (linux_proc_mem_fd != -1)
+    {
+      if (linux_proc_mem_pid == pid)
+	return linux_proc_mem_fd;
+      linux_proc_mem_invalidate (linux_proc_mem_pid);
+    }
 
-  /* We could keep this file open and cache it - possibly one per
-     thread.  That requires some juggling, but is even faster.  */
-  sprintf (filename, "/proc/%d/mem", PIDGET (inferior_ptid));
-  fd = open (filename, O_RDONLY | O_LARGEFILE);
+  xsnprintf (filename, sizeof filename, "/proc/%d/mem", lwpid);
+  fd = open (filename, O_RDWR | O_LARGEFILE);
   if (fd == -1)
-    return 0;
+    fd = open (filename, O_RDONLY | O_LARGEFILE);
+  if (fd == -1)
+    return -1;
+
+  /* Don't leak the inferior's memory into processes we spawn.  */
+  fcntl (fd, F_SETFD, FD_CLOEXEC);
+
+  linux_proc_mem_fd = fd;
+  linux_proc_mem_pid = pid;
+  return fd;
+}
+
+/* Transfer LEN bytes at OFFSET through the /proc/PID/mem file FD.
+   Returns LEN on success, -1 on failure, and 0 if the file no longer
+   refers to a live address space.  */
+
+static LONGEST
+linux_proc_mem_xfer (int fd, gdb_byte *readbuf, const gdb_byte *writebuf,
+		     ULONGEST offset, LONGEST len)
+{
+  ssize_t ret;
 
   /* If pread64 is available, use it.  It's faster if the kernel
      supports it (only one syscall), and it's 64-bit safe even on
      32-bit platforms (for instance, SPARC debugging a SPARC64
      application).  */
+  if (readbuf != NULL)
+    {
 #ifdef HAVE_PREAD64
-  if (pread64 (fd, readbuf, len, offset) != len)
+      ret = pread64 (fd, readbuf, len, offset);
 #else
-  if (lseek (fd, offset, SEEK_SET) == -1 || read (fd, readbuf, len) != len)
+      ret = (lseek (fd, offset, SEEK_SET) == -1
+	     ? -1 : read (fd, readbuf, len));
 #endif
-    ret = 0;
+    }
   else
-    ret = len;
+    {
+#ifdef HAVE_PWRITE64
+      ret = pwrite64 (fd, writebuf, len, offset);
+#else
+      ret = (lseek (fd, offset, SEEK_SET) == -1
+	     ? -1 : write (fd, writebuf, len));
+#endif
+    }
 
-  close (fd);
-  return ret;
+  if (ret == 0 && len > 0)
+    return 0;
+  return ret == len ? len : -1;
+}
+
+/* Implement the to_xfer_partial interface for memory reads and
+   writes using the /proc filesystem.  Because we can use a single
+   pread/pwrite call for /proc, this can be much more efficient than
+   banging away at PTRACE_PEEKTEXT and PTRACE_POKETEXT.  Kernels
+   older than 2.6.39 refuse writes to /proc/PID/mem; we return 0 then
+   and let the ptrace layer below do them.  */
+
+static LONGEST
+linux_proc_xfer_partial (struct target_ops *ops, enum target_object object,
+			 const char *annex, gdb_byte *readbuf,
+			 const gdb_byte *writebuf,
+			 ULONGEST offset, LONGEST len)
+{
+  LONGEST ret;
+  int fd;
+
+  if (object != TARGET_OBJECT_MEMORY)
+    return 0;
+
+  fd = linux_proc_mem_open (PIDGET (inferior_ptid));
+  if (fd == -1)
+    return 0;
+
+  ret = linux_proc_mem_xfer (fd, readbuf, writebuf, offset, len);
+  if (ret == 0)
+    {
+      /* A descriptor opened before the process exec'd reads as empty.
+	 We don't see every exec (e.g., when exec events aren't being
+	 traced), so retry once with a fresh file before giving up.  */
+      linux_proc_mem_invalidate (linux_proc_mem_pid);
+      fd = linux_proc_mem_open (PIDGET (inferior_ptid));
+      if (fd == -1)
+	return 0;
+      ret = linux_proc_mem_xfer (fd, readbuf, writebuf, offset, len);
+    }
+
+  return ret > 0 ? ret : 0;
 }
 
 
@@ -5668,6 +5774,8 @@ linux_nat_close (int quitting)
   if (target_is_async_p ())
     target_async (NULL, 0);
 
+  linux_proc_mem_invalidate (linux_proc_mem_pid);
+
   if (linux_ops->to_close)
     linux_ops->to_close (quitting);
 }
@@ -4324,6 +4324,7 @@ psymtab_to_symtab_1 (struct partial_symtab *pst, const char *filename)
 				     (sizeof (struct linetable)
 				      + size * sizeof (lines->item)));
       xfree (lines);
+      sort_linetable (LINETABLE (st));
 
       /* .. and our share of externals.
          XXX use the global list to speed up things here.  How?
@@ -4357,6 +4358,7 @@ psymtab_to_symtab_1 (struct partial_symtab *pst, const char *filename)
       st->primary = 1;
 
       sort_blocks (st);
+      add_symtab_to_pc_map (st);
     }
 
   /* Now link the psymtab and the symtab.  */
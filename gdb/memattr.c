@@ -222,10 +222,14 @@ create_mem_region (CORE_ADDR lo, CORE_ADDR hi,
 /*
  * Look up the memory region cooresponding to ADDR.
  */
+/* The region returned by lookup_mem_region for addresses outside of
+   any defined region.  */
+static struct mem_region undefined_region;
+
 struct mem_region *
 lookup_mem_region (CORE_ADDR addr)
 {
-  static struct mem_region region;
+  struct mem_region *region = &undefined_region;
   struct mem_region *m;
   CORE_ADDR lo;
   CORE_ADDR hi;
@@ -275,18 +279,26 @@ lookup_mem_region (CORE_ADDR addr)
 
   /* Because no region was found, we must cons up one based on what
      was learned above.  */
-  region.lo = lo;
-  region.hi = hi;
+  region->lo = lo;
+  region->hi = hi;
 
   /* When no memory map is defined at all, we always return 
      'default_mem_attrib', so that we do not make all memory 
      inaccessible for targets that don't provide a memory map.  */
   if (inaccessible_by_default && !VEC_empty (mem_region_s, mem_region_list))
-    region.attrib = unknown_mem_attrib;
+    region->attrib = unknown_mem_attrib;
   else
-    region.attrib = default_mem_attrib;
+    region->attrib = default_mem_attrib;
+
+  return region;
+}
 
-  return &region;
+/* See memattr.h.  */
+
+int
+mem_region_defined_p (struct mem_region *region)
+{
+  return region != &undefined_region;
 }
 
 /* Invalidate any memory regions fetched from the target.  */
@@ -100,6 +100,11 @@ DEF_VEC_O(mem_region_s);
 
 extern struct mem_region *lookup_mem_region(CORE_ADDR);
 
+/* Return nonzero if REGION, as returned by lookup_mem_region, is one
+   defined by the user or by the target's memory map, as opposed to
+   one made up for memory outside of any defined region.  */
+extern int mem_region_defined_p (struct mem_region *region);
+
 void invalidate_target_mem_regions (void);
 
 void mem_region_init (struct mem_region *);
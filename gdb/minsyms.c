@@ -50,6 +50,7 @@
 #include "target.h"
 #include "cp-support.h"
 #include "language.h"
+#include "gdbcmd.h"
 
 /* Accumulate the minimal symbols for each objfile in bunches of BUNCH_SIZE.
    At the end, copy them all into one newly allocated location on an objfile's
@@ -108,52 +109,95 @@ msymbol_hash (const char *string)
   return hash;
 }
 
-/* Add the minimal symbol SYM to an objfile's minsym hash table, TABLE.  */
-void
-add_minsym_to_hash_table (struct minimal_symbol *sym,
-			  struct minimal_symbol **table)
+/* The minimal symbol hash tables of an objfile use open addressing
+   with linear probing, and have at least twice as many slots as
+   symbols, so every probe sequence ends at an empty slot.  A
+   symbol's home slot is taken from the high bits of its name's hash
+   times a large odd constant, since the low bits of msymbol_hash
+   alone spread similar names poorly.  */
+
+/* Return the first slot to probe in TABLE for a name whose hash is
+   HASH.  */
+
+static unsigned int
+msymbol_hash_home (const struct msymbol_hash_table *table, unsigned int hash)
+{
+  return ((hash * 0x9e3779b1U) & 0xffffffffU) >> (32 - table->bits);
+}
+
+/* State for walking the symbols in a minimal symbol hash table whose
+   names have a given hash.  */
+
+struct msymbol_hash_iterator
+{
+  const struct msymbol_hash_table *table;
+  unsigned int hash;
+  unsigned int pos;
+};
+
+/* Return the next symbol for ITER, or NULL if there are no more.  */
+
+static struct minimal_symbol *
+msymbol_hash_next (struct msymbol_hash_iterator *iter)
 {
-  if (sym->hash_next == NULL)
+  const struct msymbol_hash_table *table = iter->table;
+
+  while (1)
     {
-      unsigned int hash
-	= msymbol_hash (SYMBOL_LINKAGE_NAME (sym)) % MINIMAL_SYMBOL_HASH_SIZE;
+      struct msymbol_hash_slot *slot = &table->slots[iter->pos];
 
-      sym->hash_next = table[hash];
-      table[hash] = sym;
+      if (slot->msymbol == NULL)
+	return NULL;
+      iter->pos = (iter->pos + 1) & (table->size - 1);
+      if (slot->hash == iter->hash)
+	return slot->msymbol;
     }
 }
 
-/* Add the minimal symbol SYM to an objfile's minsym demangled hash table,
-   TABLE.  */
-static void
-add_minsym_to_demangled_hash_table (struct minimal_symbol *sym,
-                                  struct minimal_symbol **table)
+/* Start walking the symbols in TABLE whose names hash to HASH, and
+   return the first one, or NULL if there are none.  Symbols with the
+   same name come out in the order they were added.  */
+
+static struct minimal_symbol *
+msymbol_hash_first (const struct msymbol_hash_table *table,
+		    unsigned int hash, struct msymbol_hash_iterator *iter)
 {
-  if (sym->demangled_hash_next == NULL)
-    {
-      unsigned int hash = msymbol_hash_iw (SYMBOL_SEARCH_NAME (sym))
-	% MINIMAL_SYMBOL_HASH_SIZE;
+  if (table->size == 0)
+    return NULL;
 
-      sym->demangled_hash_next = table[hash];
-      table[hash] = sym;
-    }
+  iter->table = table;
+  iter->hash = hash;
+  iter->pos = msymbol_hash_home (table, hash);
+  return msymbol_hash_next (iter);
 }
 
+/* Add the minimal symbol SYM, whose name hashes to HASH, to an
+   objfile's minsym hash table, TABLE.  */
+
+static void
+add_minsym_to_hash_table (struct minimal_symbol *sym, unsigned int hash,
+			  struct msymbol_hash_table *table)
+{
+  unsigned int pos = msymbol_hash_home (table, hash);
+
+  while (table->slots[pos].msymbol != NULL)
+    pos = (pos + 1) & (table->size - 1);
+
+  table->slots[pos].hash = hash;
+  table->slots[pos].msymbol = sym;
+  table->count++;
+}
 
 /* Return OBJFILE where minimal symbol SYM is defined.  */
 struct objfile *
 msymbol_objfile (struct minimal_symbol *sym)
 {
   struct objfile *objf;
-  struct minimal_symbol *tsym;
-
-  unsigned int hash
-    = msymbol_hash (SYMBOL_LINKAGE_NAME (sym)) % MINIMAL_SYMBOL_HASH_SIZE;
 
   for (objf = object_files; objf; objf = objf->next)
-    for (tsym = objf->msymbol_hash[hash]; tsym; tsym = tsym->hash_next)
-      if (tsym == sym)
-	return objf;
+    if (sym >= objf->msymbols
+	&& sym < objf->msymbols + objf->minimal_symbol_count)
+      return objf;
 
   /* We should always be able to find the objfile ...  */
   internal_error (__FILE__, __LINE__, _("failed internal consistency check"));
@@ -189,9 +233,10 @@ lookup_minimal_symbol (const char *name, const char *sfile,
   struct minimal_symbol *found_symbol = NULL;
   struct minimal_symbol *found_file_symbol = NULL;
   struct minimal_symbol *trampoline_symbol = NULL;
+  struct msymbol_hash_iterator iter;
 
-  unsigned int hash = msymbol_hash (name) % MINIMAL_SYMBOL_HASH_SIZE;
-  unsigned int dem_hash = msymbol_hash_iw (name) % MINIMAL_SYMBOL_HASH_SIZE;
+  unsigned int hash = msymbol_hash (name);
+  unsigned int dem_hash = msymbol_hash_iw (name);
 
   int needtofreename = 0;
   const char *modified_name;
@@ -227,9 +272,11 @@ lookup_minimal_symbol (const char *name, const char *sfile,
 	    {
             /* Select hash list according to pass.  */
             if (pass == 1)
-              msymbol = objfile->msymbol_hash[hash];
+              msymbol = msymbol_hash_first (&objfile->msymbol_hash,
+					    hash, &iter);
             else
-              msymbol = objfile->msymbol_demangled_hash[dem_hash];
+              msymbol = msymbol_hash_first (&objfile->msymbol_demangled_hash,
+					    dem_hash, &iter);
 
             while (msymbol != NULL && found_symbol == NULL)
 		{
@@ -280,11 +327,8 @@ lookup_minimal_symbol (const char *name, const char *sfile,
                       }
 		    }
 
-                /* Find the next symbol on the hash chain.  */
-                if (pass == 1)
-                  msymbol = msymbol->hash_next;
-                else
-                  msymbol = msymbol->demangled_hash_next;
+                /* Find the next symbol with the same hash.  */
+                msymbol = msymbol_hash_next (&iter);
 		}
 	    }
 	}
@@ -322,29 +366,29 @@ iterate_over_minimal_symbols (struct objfile *objf, const char *name,
 						void *),
 			      void *user_data)
 {
-  unsigned int hash;
+  struct msymbol_hash_iterator hash_iter;
   struct minimal_symbol *iter;
   int (*cmp) (const char *, const char *);
 
   /* The first pass is over the ordinary hash table.  */
-  hash = msymbol_hash (name) % MINIMAL_SYMBOL_HASH_SIZE;
-  iter = objf->msymbol_hash[hash];
+  iter = msymbol_hash_first (&objf->msymbol_hash, msymbol_hash (name),
+			     &hash_iter);
   cmp = (case_sensitivity == case_sensitive_on ? strcmp : strcasecmp);
   while (iter)
     {
       if (cmp (SYMBOL_LINKAGE_NAME (iter), name) == 0)
 	(*callback) (iter, user_data);
-      iter = iter->hash_next;
+      iter = msymbol_hash_next (&hash_iter);
     }
 
   /* The second pass is over the demangled table.  */
-  hash = msymbol_hash_iw (name) % MINIMAL_SYMBOL_HASH_SIZE;
-  iter = objf->msymbol_demangled_hash[hash];
+  iter = msymbol_hash_first (&objf->msymbol_demangled_hash,
+			     msymbol_hash_iw (name), &hash_iter);
   while (iter)
     {
       if (SYMBOL_MATCHES_SEARCH_NAME (iter, name))
 	(*callback) (iter, user_data);
-      iter = iter->demangled_hash_next;
+      iter = msymbol_hash_next (&hash_iter);
     }
 }
 
@@ -363,7 +407,8 @@ lookup_minimal_symbol_text (const char *name, struct objfile *objf)
   struct minimal_symbol *found_symbol = NULL;
   struct minimal_symbol *found_file_symbol = NULL;
 
-  unsigned int hash = msymbol_hash (name) % MINIMAL_SYMBOL_HASH_SIZE;
+  struct msymbol_hash_iterator iter;
+  unsigned int hash = msymbol_hash (name);
 
   for (objfile = object_files;
        objfile != NULL && found_symbol == NULL;
@@ -372,9 +417,10 @@ lookup_minimal_symbol_text (const char *name, struct objfile *objf)
       if (objf == NULL || objf == objfile
 	  || objf == objfile->separate_debug_objfile_backlink)
 	{
-	  for (msymbol = objfile->msymbol_hash[hash];
+	  for (msymbol = msymbol_hash_first (&objfile->msymbol_hash, hash,
+					     &iter);
 	       msymbol != NULL && found_symbol == NULL;
-	       msymbol = msymbol->hash_next)
+	       msymbol = msymbol_hash_next (&iter))
 	    {
 	      if (strcmp (SYMBOL_LINKAGE_NAME (msymbol), name) == 0 &&
 		  (MSYMBOL_TYPE (msymbol) == mst_text
@@ -417,7 +463,8 @@ lookup_minimal_symbol_by_pc_name (CORE_ADDR pc, const char *name,
   struct objfile *objfile;
   struct minimal_symbol *msymbol;
 
-  unsigned int hash = msymbol_hash (name) % MINIMAL_SYMBOL_HASH_SIZE;
+  struct msymbol_hash_iterator iter;
+  unsigned int hash = msymbol_hash (name);
 
   for (objfile = object_files;
        objfile != NULL;
@@ -426,9 +473,10 @@ lookup_minimal_symbol_by_pc_name (CORE_ADDR pc, const char *name,
       if (objf == NULL || objf == objfile
 	  || objf == objfile->separate_debug_objfile_backlink)
 	{
-	  for (msymbol = objfile->msymbol_hash[hash];
+	  for (msymbol = msymbol_hash_first (&objfile->msymbol_hash, hash,
+					     &iter);
 	       msymbol != NULL;
-	       msymbol = msymbol->hash_next)
+	       msymbol = msymbol_hash_next (&iter))
 	    {
 	      if (SYMBOL_VALUE_ADDRESS (msymbol) == pc
 		  && strcmp (SYMBOL_LINKAGE_NAME (msymbol), name) == 0)
@@ -456,7 +504,8 @@ lookup_minimal_symbol_solib_trampoline (const char *name,
   struct minimal_symbol *msymbol;
   struct minimal_symbol *found_symbol = NULL;
 
-  unsigned int hash = msymbol_hash (name) % MINIMAL_SYMBOL_HASH_SIZE;
+  struct msymbol_hash_iterator iter;
+  unsigned int hash = msymbol_hash (name);
 
   for (objfile = object_files;
        objfile != NULL && found_symbol == NULL;
@@ -465,9 +514,10 @@ lookup_minimal_symbol_solib_trampoline (const char *name,
       if (objf == NULL || objf == objfile
 	  || objf == objfile->separate_debug_objfile_backlink)
 	{
-	  for (msymbol = objfile->msymbol_hash[hash];
+	  for (msymbol = msymbol_hash_first (&objfile->msymbol_hash, hash,
+					     &iter);
 	       msymbol != NULL && found_symbol == NULL;
-	       msymbol = msymbol->hash_next)
+	       msymbol = msymbol_hash_next (&iter))
 	    {
 	      if (strcmp (SYMBOL_LINKAGE_NAME (msymbol), name) == 0 &&
 		  MSYMBOL_TYPE (msymbol) == mst_solib_trampoline)
@@ -814,15 +864,16 @@ lookup_minimal_symbol_and_objfile (const char *name,
 				   struct objfile **objfile_p)
 {
   struct objfile *objfile;
-  unsigned int hash = msymbol_hash (name) % MINIMAL_SYMBOL_HASH_SIZE;
+  struct msymbol_hash_iterator iter;
+  unsigned int hash = msymbol_hash (name);
 
   ALL_OBJFILES (objfile)
     {
       struct minimal_symbol *msym;
 
-      for (msym = objfile->msymbol_hash[hash];
+      for (msym = msymbol_hash_first (&objfile->msymbol_hash, hash, &iter);
 	   msym != NULL;
-	   msym = msym->hash_next)
+	   msym = msymbol_hash_next (&iter))
 	{
 	  if (strcmp (SYMBOL_LINKAGE_NAME (msym), name) == 0)
 	    {
@@ -961,11 +1012,6 @@ prim_record_minimal_symbol_full (const char *name, int name_len, int copy_name,
   MSYMBOL_TARGET_FLAG_2 (msymbol) = 0;
   MSYMBOL_SIZE (msymbol) = 0;
 
-  /* The hash pointers must be cleared! If they're not,
-     add_minsym_to_hash_table will NOT add this msymbol to the hash table.  */
-  msymbol->hash_next = NULL;
-  msymbol->demangled_hash_next = NULL;
-
   msym_bunch_index++;
   msym_count++;
   OBJSTAT (objfile, n_minsyms++);
@@ -1122,6 +1168,40 @@ compact_minimal_symbols (struct minimal_symbol *msymbol, int mcount,
   return (mcount);
 }
 
+/* Make TABLE, one of OBJFILE's minimal symbol hash tables, empty and
+   big enough for COUNT symbols.  Reuse its slots if they are already
+   the right size.  */
+
+static void
+init_minimal_symbol_hash_table (struct objfile *objfile,
+				struct msymbol_hash_table *table,
+				unsigned int count)
+{
+  int bits;
+
+  if (count == 0)
+    {
+      memset (table, 0, sizeof (*table));
+      return;
+    }
+
+  /* Keep the table at most half full, so that probe sequences stay
+     short and always end.  */
+  bits = 4;
+  while ((1U << bits) < 2 * count)
+    bits++;
+
+  if (table->bits != bits || table->slots == NULL)
+    {
+      table->bits = bits;
+      table->size = 1U << bits;
+      table->slots = obstack_alloc (&objfile->objfile_obstack,
+				    table->size * sizeof (*table->slots));
+    }
+  memset (table->slots, 0, table->size * sizeof (*table->slots));
+  table->count = 0;
+}
+
 /* Build (or rebuild) the minimal symbol hash tables.  This is necessary
    after compacting or sorting the table since the entries move around
    thus causing the internal minimal_symbol pointers to become jumbled.  */
@@ -1130,27 +1210,35 @@ static void
 build_minimal_symbol_hash_tables (struct objfile *objfile)
 {
   int i;
+  unsigned int demangled_count = 0;
   struct minimal_symbol *msym;
 
-  /* Clear the hash tables.  */
-  for (i = 0; i < MINIMAL_SYMBOL_HASH_SIZE; i++)
-    {
-      objfile->msymbol_hash[i] = 0;
-      objfile->msymbol_demangled_hash[i] = 0;
-    }
-
-  /* Now, (re)insert the actual entries.  */
   for (i = objfile->minimal_symbol_count, msym = objfile->msymbols;
        i > 0;
        i--, msym++)
+    if (SYMBOL_SEARCH_NAME (msym) != SYMBOL_LINKAGE_NAME (msym))
+      demangled_count++;
+
+  init_minimal_symbol_hash_table (objfile, &objfile->msymbol_hash,
+				  objfile->minimal_symbol_count);
+  init_minimal_symbol_hash_table (objfile, &objfile->msymbol_demangled_hash,
+				  demangled_count);
+
+  /* Now, (re)insert the actual entries.  Go from the highest address
+     down, so that lookups see symbols with the same name in the order
+     they always have.  */
+  for (i = objfile->minimal_symbol_count,
+	 msym = objfile->msymbols + objfile->minimal_symbol_count - 1;
+       i > 0;
+       i--, msym--)
     {
-      msym->hash_next = 0;
-      add_minsym_to_hash_table (msym, objfile->msymbol_hash);
+      add_minsym_to_hash_table (msym, msymbol_hash (SYMBOL_LINKAGE_NAME (msym)),
+				&objfile->msymbol_hash);
 
-      msym->demangled_hash_next = 0;
       if (SYMBOL_SEARCH_NAME (msym) != SYMBOL_LINKAGE_NAME (msym))
-	add_minsym_to_demangled_hash_table (msym,
-                                            objfile->msymbol_demangled_hash);
+	add_minsym_to_hash_table (msym,
+				  msymbol_hash_iw (SYMBOL_SEARCH_NAME (msym)),
+				  &objfile->msymbol_demangled_hash);
     }
 }
 
@@ -1365,3 +1453,76 @@ find_solib_trampoline_target (struct frame_info *frame, CORE_ADDR pc)
     }
   return 0;
 }
+
+/* Print statistics about the minimal symbol hash table TABLE, called
+   NAME.  */
+
+static void
+print_msymbol_hash_table_statistics (const char *name,
+				     const struct msymbol_hash_table *table)
+{
+  unsigned long total_probes = 0;
+  unsigned int max_probes = 0;
+  unsigned int i;
+
+  for (i = 0; i < table->size; i++)
+    {
+      const struct msymbol_hash_slot *slot = &table->slots[i];
+      unsigned int probes;
+
+      if (slot->msymbol == NULL)
+	continue;
+
+      probes = ((i - msymbol_hash_home (table, slot->hash))
+		& (table->size - 1)) + 1;
+      total_probes += probes;
+      if (probes > max_probes)
+	max_probes = probes;
+    }
+
+  printf_filtered (_("  %s hash table: %u symbols in %u slots"),
+		   name, table->count, table->size);
+  if (table->count > 0)
+    printf_filtered (_(", average probe length %.2f, longest %u"),
+		     (double) total_probes / table->count, max_probes);
+  printf_filtered ("\n");
+}
+
+/* Implement the "maint info msymbol-hash" command.  */
+
+static void
+maintenance_info_msymbol_hash (char *args, int from_tty)
+{
+  struct objfile *objfile;
+
+  ALL_OBJFILES (objfile)
+    {
+      QUIT;
+
+      if (objfile->minimal_symbol_count == 0)
+	continue;
+
+      printf_filtered (_("Objfile %s: %d minimal symbols, "
+			 "%lu bytes of hash tables\n"),
+		       objfile->name, objfile->minimal_symbol_count,
+		       (unsigned long) ((objfile->msymbol_hash.size
+					 + objfile->msymbol_demangled_hash.size)
+					* sizeof (struct msymbol_hash_slot)));
+      print_msymbol_hash_table_statistics (_("Name"),
+					   &objfile->msymbol_hash);
+      print_msymbol_hash_table_statistics (_("Demangled name"),
+					   &objfile->msymbol_demangled_hash);
+    }
+}
+
+/* Provide a prototype to silence -Wmissing-prototypes.  */
+extern initialize_file_ftype _initialize_minsyms;
+
+void
+_initialize_minsyms (void)
+{
+  add_cmd ("msymbol-hash", class_maintenance,
+	   maintenance_info_msymbol_hash, _("\
+Show statistics about the minimal symbol hash tables of each objfile."),
+	   &maintenanceinfolist);
+}
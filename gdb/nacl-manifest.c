@@ -27,23 +27,35 @@
 
 #include <stdio.h>
 #include <string.h>
+#include "gdb_obstack.h"
+#include "hashtab.h"
 
 #define MANIFEST_MAX_NESTING 4
 
-#define MANIFEST_MAX_STRING_SIZE 256
 
+/* Mapping from the file name seen by the NaCl program to the real file
+   name.  Both strings are interned in the manifest obstack.  */
 
-struct file_list
+struct file_entry
   {
-    struct file_list *next;
+    /* Next entry in parse order, only used while building the table.  */
+    struct file_entry *next;
 
-    char original_name[MANIFEST_MAX_STRING_SIZE];
+    const char *original_name;
 
-    char name[MANIFEST_MAX_STRING_SIZE];
+    const char *name;
   };
 
 
-static struct file_list *nacl_file_list;
+/* Storage for the current manifest entries and their strings.  NULL if
+   no manifest is loaded.  */
+
+static struct obstack *nacl_manifest_obstack;
+
+
+/* Hash table of struct file_entry, keyed by original_name.  */
+
+static htab_t nacl_file_table;
 
 
 static char *nacl_program_filename;
@@ -52,6 +64,9 @@ static char *nacl_program_filename;
 static char *nacl_irt_filename;
 
 
+static int nacl_manifest_gen;
+
+
 const char *
 nacl_manifest_program (void)
 {
@@ -66,21 +81,50 @@ nacl_manifest_irt (void)
 }
 
 
+int
+nacl_manifest_generation (void)
+{
+  return nacl_manifest_gen;
+}
+
+
+static hashval_t
+hash_file_entry (const void *p)
+{
+  const struct file_entry *e = p;
+
+  return htab_hash_string (e->original_name);
+}
+
+
+static int
+eq_file_entry (const void *a, const void *b)
+{
+  const struct file_entry *lhs = a;
+  const struct file_entry *rhs = b;
+
+  return strcmp (lhs->original_name, rhs->original_name) == 0;
+}
+
+
 const char *
 nacl_manifest_find (const char *original_name)
 {
-  struct file_list *curr;
-
   /* HACK: NaCl uses "/lib/" library path to inform service runtime that the
            file should be opened as solib vs. ordinary file. Split that prefix
            here so that GDB can find these files via manifest or as is.  */
   if (strncmp (original_name, "/lib/", 5) == 0)
     original_name += 5;
 
-  for (curr = nacl_file_list; curr; curr = curr->next)
+  if (nacl_file_table)
     {
-      if (strcmp (original_name, curr->original_name) == 0)
-        return curr->name;
+      struct file_entry key;
+      struct file_entry *found;
+
+      key.original_name = original_name;
+      found = htab_find (nacl_file_table, &key);
+      if (found)
+        return found->name;
     }
 
   /* TODO: Should we complain if we have a manifest but failed to find
@@ -90,15 +134,29 @@ nacl_manifest_find (const char *original_name)
 }
 
 
+static void
+free_manifest_storage (void *arg)
+{
+  struct obstack *storage = arg;
+
+  obstack_free (storage, NULL);
+  xfree (storage);
+}
+
+
 static void
 nacl_manifest_free (void)
 {
-  while (nacl_file_list)
+  if (nacl_file_table)
     {
-      struct file_list *next = nacl_file_list->next;
+      htab_delete (nacl_file_table);
+      nacl_file_table = NULL;
+    }
 
-      xfree (nacl_file_list);
-      nacl_file_list = next;
+  if (nacl_manifest_obstack)
+    {
+      free_manifest_storage (nacl_manifest_obstack);
+      nacl_manifest_obstack = NULL;
     }
 
   xfree (nacl_program_filename);
@@ -125,8 +183,18 @@ struct json_manifest_reader
     /* Manifest file dirname, with slash at the end if non-empty. */
     char* dirname;
 
-    /* Where to append new file_list.  */
-    struct file_list **link_ptr;
+    /* Strings being parsed.  Released in LIFO order as parsing goes.  */
+    struct obstack scratch;
+
+    /* Where the resulting entries and their strings are interned.  */
+    struct obstack *storage;
+
+    /* Entries parsed so far, in reverse order, and their count.  */
+    struct file_entry *entries;
+    int entries_count;
+
+    /* Real filename for the program, allocated in STORAGE.  */
+    const char *program_filename;
   };
 
 
@@ -148,25 +216,27 @@ json_on_end_member (struct json_manifest_reader *r, const char *member)
 }
 
 
-static struct file_list *
-json_append_file_list (struct json_manifest_reader *r,
-                       const char *original_name,
-                       const char *name)
+static struct file_entry *
+json_append_file_entry (struct json_manifest_reader *r,
+                        const char *original_name,
+                        const char *name)
 {
-  struct file_list *curr = XZALLOC (struct file_list);
+  struct file_entry *curr = OBSTACK_ZALLOC (r->storage, struct file_entry);
 
-  strcpy (curr->original_name, original_name);
+  curr->original_name = obstack_copy0 (r->storage, original_name,
+                                       strlen (original_name));
 
-  /* TODO: Check if the result fits!  */
   if (r->dirname)
     {
-      strcpy (curr->name, r->dirname);
-      strcat (curr->name, SLASH_STRING);
+      obstack_grow_str (r->storage, r->dirname);
+      obstack_grow_str (r->storage, SLASH_STRING);
     }
-  strcat (curr->name, name);
+  obstack_grow_str0 (r->storage, name);
+  curr->name = obstack_finish (r->storage);
 
-  *r->link_ptr = curr;
-  r->link_ptr = &curr->next;
+  curr->next = r->entries;
+  r->entries = curr;
+  ++r->entries_count;
 
   return curr;
 }
@@ -184,18 +254,18 @@ json_on_string_value (struct json_manifest_reader *r, const char *value)
                It used to always name itself NaClMain, we support this by
                substituting nacl_manifest_program () in solib-nacl.c.
                New style is to name itself with its own basename, we support
-               this by adding a fake file_list entry.  */
-      struct file_list *p = json_append_file_list (r, lbasename (value), value);
+               this by adding a fake file_entry.  */
+      struct file_entry *p = json_append_file_entry (r, lbasename (value),
+                                                     value);
 
-      /* We'll xfree nacl_program_filename.  */
-      nacl_program_filename = xstrdup (p->name);
+      r->program_filename = p->name;
     }
   else if (r->nesting == 4 &&
            strcmp (r->members[0], "files") == 0 &&
            strcmp (r->members[2], "x86-64") == 0 &&
            strcmp (r->members[3], "url") == 0)
     {
-      json_append_file_list (r, r->members[1], value);
+      json_append_file_entry (r, r->members[1], value);
     }
 }
 
@@ -232,24 +302,27 @@ json_getc_nonspace (struct json_manifest_reader *r)
 static void json_parse_value (struct json_manifest_reader *r);
 
 
-static void
-json_finish_parse_string (struct json_manifest_reader *r, char *buf, int len)
+/* Read the rest of a string into the scratch obstack and return it.
+   The caller releases it with obstack_free when done.  */
+
+static char *
+json_finish_parse_string (struct json_manifest_reader *r)
 {
   int c;
 
-  for (; len; --len)
+  for (;;)
     {
       c = json_getc (r);
       if (c == '"')
         {
-          *buf = '\0';
-          return;
+          obstack_1grow (&r->scratch, '\0');
+          return obstack_finish (&r->scratch);
         }
 
       if (c == '\n' || c == EOF)
         break;
 
-      *buf++ = (char)c;
+      obstack_1grow (&r->scratch, c);
     }
 
   error (_("Invalid manifest file."));
@@ -262,14 +335,14 @@ static void
 json_finish_parse_object (struct json_manifest_reader *r)
 {
   int c;
-  char buf[MANIFEST_MAX_STRING_SIZE];
+  char *buf;
 
   do
     {
       if (json_getc_nonspace (r) != '\"')
         error (_("Invalid manifest file."));
 
-      json_finish_parse_string (r, buf, MANIFEST_MAX_STRING_SIZE);
+      buf = json_finish_parse_string (r);
       json_on_member (r, buf);
 
       if (json_getc_nonspace (r) != ':')
@@ -277,6 +350,7 @@ json_finish_parse_object (struct json_manifest_reader *r)
 
       json_parse_value (r);
       json_on_end_member (r, buf);
+      obstack_free (&r->scratch, buf);
     }
   while ((c = json_getc_nonspace (r)) == ',');
 
@@ -298,10 +372,10 @@ json_parse_value (struct json_manifest_reader *r)
     }
   else if (c == '\"')
     {
-      char buf[MANIFEST_MAX_STRING_SIZE];
+      char *buf = json_finish_parse_string (r);
 
-      json_finish_parse_string (r, buf, MANIFEST_MAX_STRING_SIZE);
       json_on_string_value (r, buf);
+      obstack_free (&r->scratch, buf);
     }
   else
     {
@@ -320,6 +394,7 @@ nacl_file_command (char *args, int from_tty)
     {
       nacl_manifest_free ();
       nacl_program_filename = tilde_expand (args);
+      nacl_manifest_gen++;
 
       solib_add (NULL, from_tty, NULL, 1);
     }
@@ -333,12 +408,38 @@ nacl_irt_command (char *args, int from_tty)
     {
       xfree (nacl_irt_filename);
       nacl_irt_filename = tilde_expand (args);
+      nacl_manifest_gen++;
 
       solib_add (NULL, from_tty, NULL, 1);
     }
 }
 
 
+/* Build the lookup table for the entries parsed by R.  The table is
+   sized to the manifest, so it never needs to grow.  */
+
+static htab_t
+json_build_file_table (struct json_manifest_reader *r)
+{
+  htab_t table;
+  struct file_entry *curr;
+
+  table = htab_create_alloc (r->entries_count, hash_file_entry,
+                             eq_file_entry, NULL, xcalloc, xfree);
+
+  /* Entries are kept in reverse order, and the first entry in the manifest
+     wins, so let later entries be replaced.  */
+  for (curr = r->entries; curr; curr = curr->next)
+    {
+      void **slot = htab_find_slot (table, curr, INSERT);
+
+      *slot = curr;
+    }
+
+  return table;
+}
+
+
 static void
 nacl_manifest_command (char *args, int from_tty)
 {
@@ -346,6 +447,7 @@ nacl_manifest_command (char *args, int from_tty)
     {
       char* manifest_filename;
       struct json_manifest_reader r = { 0 };
+      struct cleanup *storage_cleanup;
 
       manifest_filename = tilde_expand (args);
       make_cleanup (xfree, manifest_filename);
@@ -358,12 +460,26 @@ nacl_manifest_command (char *args, int from_tty)
       r.dirname = ldirname (manifest_filename);
       make_cleanup (xfree, r.dirname);
 
-      r.link_ptr = &nacl_file_list;
+      obstack_init (&r.scratch);
+      make_cleanup_obstack_free (&r.scratch);
+
+      r.storage = XNEW (struct obstack);
+      obstack_init (r.storage);
+      storage_cleanup = make_cleanup (free_manifest_storage, r.storage);
 
-      /* TODO: Kill existing manifest only if new one parsed OK!  */
-      nacl_manifest_free ();
       json_parse_value (&r);
 
+      /* The new manifest parsed OK, replace the existing one.  */
+      nacl_manifest_free ();
+      discard_cleanups (storage_cleanup);
+      nacl_manifest_obstack = r.storage;
+      nacl_file_table = json_build_file_table (&r);
+
+      /* We'll xfree nacl_program_filename.  */
+      if (r.program_filename)
+        nacl_program_filename = xstrdup (r.program_filename);
+      nacl_manifest_gen++;
+
       solib_add (NULL, from_tty, NULL, 1);
 
       /* Caller will cleanup for us... hopefully.  */
@@ -29,4 +29,7 @@ const char *nacl_manifest_irt (void);
 /* Real filename for Native Client original_name.  */
 const char *nacl_manifest_find (const char *original_name);
 
+/* Incremented each time the mapping above changes.  */
+int nacl_manifest_generation (void);
+
 #endif
@@ -19,9 +19,13 @@
 
 #include "defs.h"
 #include "arch-utils.h"
+#include "command.h"
+#include "gdbcmd.h"
 #include "inferior.h"
 #include "observer.h"
 #include "regcache.h"
+#include "tracepoint.h"
+#include "hashtab.h"
 
 #include "solib-nacl.h"
 
@@ -29,6 +33,240 @@
 static struct target_ops nacl_ops;
 
 
+/* Sandbox memory cache.
+
+   Untrusted code mostly does 32-bit pointer chasing within the sandbox, and
+   the code region is read over and over by disassembly and prologue
+   analysis.  Cache sandbox memory in pages, keyed by inferior and
+   sandbox-relative address.  Pages of the validated static code can not
+   change while the program runs, so they are kept until a library is
+   loaded or unloaded; the dynamic code interface only writes above them.
+   All other pages are dropped when the inferior resumes.
+
+   All memory writes go through this layer, so cached pages are updated
+   in place, which also keeps them in sync with breakpoint insertion.  */
+
+#define NACL_CACHE_PAGE_SIZE 4096
+
+/* Maximum number of cached pages.  */
+
+#define NACL_CACHE_MAX_PAGES 1024
+
+struct nacl_cache_page
+  {
+    /* Number of the inferior the page was read from.  */
+    int inf_num;
+
+    CORE_ADDR sandbox_base;
+
+    /* Sandbox-relative address, multiple of NACL_CACHE_PAGE_SIZE.  */
+    CORE_ADDR offset;
+
+    /* Nonzero if the page is entirely within the static code and so is
+       kept across resumes.  */
+    int static_text_p;
+
+    gdb_byte data[NACL_CACHE_PAGE_SIZE];
+  };
+
+
+static htab_t nacl_cache;
+
+/* Value of "set nacl-memory-cache".  */
+
+static int nacl_cache_enabled_p = 1;
+
+
+static hashval_t
+hash_nacl_cache_page (const void *p)
+{
+  const struct nacl_cache_page *page = p;
+
+  return (hashval_t) (page->offset / NACL_CACHE_PAGE_SIZE)
+         ^ (hashval_t) (page->sandbox_base >> 32)
+         ^ ((hashval_t) page->inf_num << 20);
+}
+
+
+static int
+eq_nacl_cache_page (const void *a, const void *b)
+{
+  const struct nacl_cache_page *lhs = a;
+  const struct nacl_cache_page *rhs = b;
+
+  return (lhs->inf_num == rhs->inf_num
+          && lhs->sandbox_base == rhs->sandbox_base
+          && lhs->offset == rhs->offset);
+}
+
+
+/* Drop all cached pages.  */
+
+static void
+nacl_cache_invalidate (void)
+{
+  if (nacl_cache)
+    htab_empty (nacl_cache);
+}
+
+
+/* htab_traverse callback to drop a page that may change while the
+   inferior runs.  */
+
+static int
+nacl_cache_drop_volatile_page (void **slot, void *data)
+{
+  struct nacl_cache_page *page = *slot;
+
+  if (!page->static_text_p)
+    htab_clear_slot (nacl_cache, slot);
+
+  return 1;
+}
+
+
+/* Drop the cached pages that may change while the inferior runs.  */
+
+static void
+nacl_cache_invalidate_volatile (void)
+{
+  if (nacl_cache)
+    htab_traverse_noresize (nacl_cache, nacl_cache_drop_volatile_page, NULL);
+}
+
+
+/* Return the cached page matching KEY, or NULL.  */
+
+static struct nacl_cache_page *
+nacl_cache_find (const struct nacl_cache_page *key)
+{
+  if (!nacl_cache)
+    return NULL;
+
+  return htab_find (nacl_cache, key);
+}
+
+
+/* Read the page described by KEY into the cache from OPS_BENEATH.
+   Return the page or NULL if it is not entirely readable.  */
+
+static struct nacl_cache_page *
+nacl_cache_fill (struct target_ops *ops_beneath,
+                 const struct nacl_cache_page *key)
+{
+  struct nacl_cache_page *page;
+  CORE_ADDR addr = key->sandbox_base + key->offset;
+  LONGEST done = 0;
+  void **slot;
+
+  if (!nacl_cache)
+    nacl_cache = htab_create_alloc (NACL_CACHE_MAX_PAGES,
+                                    hash_nacl_cache_page, eq_nacl_cache_page,
+                                    xfree, xcalloc, xfree);
+  else if (htab_elements (nacl_cache) >= NACL_CACHE_MAX_PAGES)
+    nacl_cache_invalidate ();
+
+  page = XNEW (struct nacl_cache_page);
+
+  while (done < NACL_CACHE_PAGE_SIZE)
+    {
+      LONGEST res;
+
+      res = ops_beneath->to_xfer_partial (ops_beneath, TARGET_OBJECT_MEMORY,
+                                          NULL, page->data + done, NULL,
+                                          addr + done,
+                                          NACL_CACHE_PAGE_SIZE - done);
+      if (res <= 0)
+        {
+          xfree (page);
+          return NULL;
+        }
+
+      done += res;
+    }
+
+  page->inf_num = key->inf_num;
+  page->sandbox_base = key->sandbox_base;
+  page->offset = key->offset;
+  page->static_text_p = key->static_text_p;
+
+  slot = htab_find_slot (nacl_cache, page, INSERT);
+  gdb_assert (*slot == NULL);
+  *slot = page;
+
+  return page;
+}
+
+
+/* Return nonzero if the sandbox memory cache can be used for MEMADDR.
+   If so, fill in KEY to look up the page containing MEMADDR.  */
+
+static int
+nacl_cache_usable_p (ULONGEST memaddr, struct nacl_cache_page *key)
+{
+  struct inferior *inf;
+  ULONGEST sandbox_size;
+  ULONGEST static_text_end;
+
+  if (!nacl_cache_enabled_p
+      || non_stop
+      || get_traceframe_number () != -1
+      || ptid_equal (inferior_ptid, null_ptid))
+    return 0;
+
+  inf = find_inferior_pid (ptid_get_pid (inferior_ptid));
+  if (!inf
+      || !nacl_sandbox_range (inf, memaddr, &key->sandbox_base, &sandbox_size,
+                              &static_text_end))
+    return 0;
+
+  key->inf_num = inf->num;
+  key->offset = ((memaddr - key->sandbox_base)
+                 & ~(CORE_ADDR) (NACL_CACHE_PAGE_SIZE - 1));
+  if (key->offset + NACL_CACHE_PAGE_SIZE > sandbox_size)
+    return 0;
+
+  key->static_text_p = key->offset + NACL_CACHE_PAGE_SIZE <= static_text_end;
+  return 1;
+}
+
+
+/* Update cached copies of [MEMADDR, MEMADDR + LEN) after a write.  */
+
+static void
+nacl_cache_update (const gdb_byte *writebuf, ULONGEST memaddr, LONGEST len)
+{
+  while (len > 0)
+    {
+      struct nacl_cache_page key;
+      struct nacl_cache_page *page;
+      LONGEST chunk;
+
+      if (!nacl_cache_usable_p (memaddr, &key))
+        chunk = NACL_CACHE_PAGE_SIZE - (memaddr & (NACL_CACHE_PAGE_SIZE - 1));
+      else
+        {
+          CORE_ADDR in_page = memaddr - key.sandbox_base - key.offset;
+
+          chunk = NACL_CACHE_PAGE_SIZE - in_page;
+          if (chunk > len)
+            chunk = len;
+
+          page = nacl_cache_find (&key);
+          if (page)
+            memcpy (page->data + in_page, writebuf, chunk);
+        }
+
+      if (chunk > len)
+        chunk = len;
+
+      writebuf += chunk;
+      memaddr += chunk;
+      len -= chunk;
+    }
+}
+
+
 static void
 nacl_mourn_inferior (struct target_ops *ops)
 {
@@ -38,6 +276,7 @@ nacl_mourn_inferior (struct target_ops *ops)
   gdb_assert (ops_beneath);
   ops_beneath->to_mourn_inferior (ops_beneath);
 
+  nacl_cache_invalidate ();
   unpush_target (&nacl_ops);
   registers_changed ();
 }
@@ -71,10 +310,41 @@ nacl_xfer_partial (struct target_ops *ops, enum target_object object,
 		   const gdb_byte *writebuf, ULONGEST offset, LONGEST len)
 {
   struct target_ops *ops_beneath = find_target_beneath (ops);
+  LONGEST res;
+
   while (ops_beneath && !ops_beneath->to_xfer_partial)
     ops_beneath = find_target_beneath (ops_beneath);
   gdb_assert (ops_beneath);
-  return ops_beneath->to_xfer_partial (ops_beneath, object, annex, readbuf, writebuf, offset, len);
+
+  if (object == TARGET_OBJECT_MEMORY && readbuf)
+    {
+      struct nacl_cache_page key;
+      struct nacl_cache_page *page;
+
+      if (nacl_cache_usable_p (offset, &key))
+        {
+          page = nacl_cache_find (&key);
+          if (!page)
+            page = nacl_cache_fill (ops_beneath, &key);
+
+          if (page)
+            {
+              CORE_ADDR in_page = offset - key.sandbox_base - key.offset;
+
+              if (len > NACL_CACHE_PAGE_SIZE - in_page)
+                len = NACL_CACHE_PAGE_SIZE - in_page;
+              memcpy (readbuf, page->data + in_page, len);
+              return len;
+            }
+        }
+    }
+
+  res = ops_beneath->to_xfer_partial (ops_beneath, object, annex, readbuf, writebuf, offset, len);
+
+  if (object == TARGET_OBJECT_MEMORY && writebuf && res > 0 && nacl_cache)
+    nacl_cache_update (writebuf, offset, res);
+
+  return res;
 }
 
 
@@ -106,28 +376,22 @@ nacl_region_ok_for_hw_watchpoint (CORE_ADDR addr, int len)
 static struct gdbarch *
 nacl_thread_architecture (struct target_ops *ops, ptid_t ptid)
 {
+  struct inferior *inf;
   struct regcache *regcache;
+  struct gdbarch *gdbarch;
   CORE_ADDR pc;
 
+  inf = find_inferior_pid (ptid_get_pid (ptid));
+  if (!inf)
+    return target_gdbarch;
+
   /* Get runtime-side pc.  */
   regcache = get_thread_arch_regcache (ptid, target_gdbarch);
   pc = regcache_read_pc (regcache);
 
-  /* TODO: fix this hacky check that only works for 4gb x86_64 sandbox!  */
-  if (nacl_sandbox_address_p (pc))
-    {
-      struct gdbarch_info info;
-      struct gdbarch *gdbarch;
-
-      /* NaCl and runtime architectures differ by OS ABI only.  */
-      gdbarch_info_init (&info);
-      info.bfd_arch_info = gdbarch_bfd_arch_info (target_gdbarch);
-      info.osabi = GDB_OSABI_NACL;
-
-      gdbarch = gdbarch_find_by_info (info);
-      if (gdbarch)
-        return gdbarch;
-    }
+  gdbarch = nacl_sandbox_gdbarch (inf, pc);
+  if (gdbarch)
+    return gdbarch;
 
   return target_gdbarch;
 }
@@ -136,6 +400,7 @@ nacl_thread_architecture (struct target_ops *ops, ptid_t ptid)
 static void
 nacl_multiarch_inferior_created (struct target_ops *ops, int from_tty)
 {
+  nacl_cache_invalidate ();
   push_target (&nacl_ops);
   registers_changed ();
 }
@@ -159,6 +424,42 @@ init_nacl_ops (void)
 }
 
 
+static void
+nacl_cache_target_resumed (ptid_t ptid)
+{
+  nacl_cache_invalidate_volatile ();
+}
+
+
+/* Libraries are loaded into the dynamic code area, and a different
+   program may now be in the sandbox.  */
+
+static void
+nacl_cache_solib_changed (struct so_list *so)
+{
+  nacl_cache_invalidate ();
+}
+
+
+static void
+set_nacl_memory_cache (char *args, int from_tty, struct cmd_list_element *c)
+{
+  nacl_cache_invalidate ();
+}
+
+
+static void
+show_nacl_memory_cache (struct ui_file *file, int from_tty,
+                        struct cmd_list_element *c, const char *value)
+{
+  fprintf_filtered (file, _("Caching of Native Client sandbox memory "
+                            "is %s.\n"), value);
+}
+
+
+/* Provide a prototype to silence -Wmissing-prototypes.  */
+extern initialize_file_ftype _initialize_nacl_multiarch;
+
 void
 _initialize_nacl_multiarch (void)
 {
@@ -166,4 +467,17 @@ _initialize_nacl_multiarch (void)
   add_target (&nacl_ops);
 
   observer_attach_inferior_created (nacl_multiarch_inferior_created);
+  observer_attach_target_resumed (nacl_cache_target_resumed);
+  observer_attach_solib_loaded (nacl_cache_solib_changed);
+  observer_attach_solib_unloaded (nacl_cache_solib_changed);
+
+  add_setshow_boolean_cmd ("nacl-memory-cache", class_support,
+                           &nacl_cache_enabled_p, _("\
+Set caching of Native Client sandbox memory."), _("\
+Show caching of Native Client sandbox memory."), _("\
+When on, sandbox memory reads are cached in pages.  Pages of validated\n\
+static code are kept until a library is loaded or unloaded, all other\n\
+pages are dropped when the program resumes."),
+                           set_nacl_memory_cache, show_nacl_memory_cache,
+                           &setlist, &showlist);
 }
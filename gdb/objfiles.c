@@ -258,6 +258,7 @@ allocate_objfile (bfd *abfd, int flags)
 
   /* Rebuild section map next time we need it.  */
   get_objfile_pspace_data (objfile->pspace)->objfiles_changed_p = 1;
+  clear_pc_symtab_map (objfile->pspace);
 
   return objfile;
 }
@@ -650,6 +651,7 @@ free_objfile (struct objfile *objfile)
 
   /* Rebuild section map next time we need it.  */
   get_objfile_pspace_data (objfile->pspace)->objfiles_changed_p = 1;
+  clear_pc_symtab_map (objfile->pspace);
 
   xfree (objfile);
 }
@@ -749,6 +751,7 @@ objfile_relocate1 (struct objfile *objfile,
 	  for (i = 0; i < l->nitems; ++i)
 	    l->item[i].pc += ANOFFSET (delta, s->block_line_section);
 	}
+      clear_symtab_pc_line_cache (s);
 
       /* Don't relocate a shared blockvector more than once.  */
       if (!s->primary)
@@ -824,6 +827,7 @@ objfile_relocate1 (struct objfile *objfile,
 
   /* Rebuild section map next time we need it.  */
   get_objfile_pspace_data (objfile->pspace)->objfiles_changed_p = 1;
+  clear_pc_symtab_map (objfile->pspace);
 
   /* Update the table in exec_ops, used to read memory.  */
   ALL_OBJFILE_OSECTIONS (objfile, s)
@@ -1486,6 +1490,7 @@ objfiles_changed (void)
 {
   /* Rebuild section map next time we need it.  */
   get_objfile_pspace_data (current_program_space)->objfiles_changed_p = 1;
+  clear_pc_symtab_map (current_program_space);
 }
 
 /* Close ABFD, and warn if that fails.  */
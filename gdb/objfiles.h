@@ -156,8 +156,35 @@ struct objstats
 extern void print_objfile_statistics (void);
 extern void print_symbol_bcache_statistics (void);
 
-/* Number of entries in the minimal symbol hash table.  */
-#define MINIMAL_SYMBOL_HASH_SIZE 2039
+/* One slot of a minimal symbol hash table.  */
+
+struct msymbol_hash_slot
+{
+  /* The full hash of the symbol's name, so that probing only has to
+     compare the names of symbols whose hashes match.  */
+  unsigned int hash;
+
+  /* The symbol, or NULL if the slot is empty.  */
+  struct minimal_symbol *msymbol;
+};
+
+/* A hash table of minimal symbols, using open addressing with linear
+   probing.  It is sized to the number of symbols it holds; see
+   minsyms.c.  */
+
+struct msymbol_hash_table
+{
+  /* The number of slots, which is 1 << BITS, or zero if the table is
+     empty.  */
+  unsigned int size;
+  int bits;
+
+  /* The number of symbols in the table.  */
+  unsigned int count;
+
+  /* The slots, allocated on the objfile_obstack.  */
+  struct msymbol_hash_slot *slots;
+};
 
 /* Master structure for keeping track of each file from which
    gdb reads symbols.  There are several ways these get allocated: 1.
@@ -278,12 +305,12 @@ struct objfile
 
     /* This is a hash table used to index the minimal symbols by name.  */
 
-    struct minimal_symbol *msymbol_hash[MINIMAL_SYMBOL_HASH_SIZE];
+    struct msymbol_hash_table msymbol_hash;
 
     /* This hash table is used to index the minimal symbols by their
        demangled names.  */
 
-    struct minimal_symbol *msymbol_demangled_hash[MINIMAL_SYMBOL_HASH_SIZE];
+    struct msymbol_hash_table msymbol_demangled_hash;
 
     /* Structure which keeps track of functions that manipulate objfile's
        of the same type as this objfile.  I.e. the function to read partial
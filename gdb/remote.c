@@ -65,6 +65,7 @@
 #include "tracepoint.h"
 #include "ax.h"
 #include "ax-gdb.h"
+#include "rsp-lz.h"
 
 /* Temp hacks for tracepoint encoding migration.  */
 static char *target_buf;
@@ -123,12 +124,17 @@ static int readchar (int timeout);
 
 static void remote_kill (struct target_ops *ops);
 
+static int remote_unescape_input (const gdb_byte *buffer, int len,
+				  gdb_byte *out_buf, int out_maxlen);
+
 static int tohex (int nib);
 
 static int remote_can_async_p (void);
 
 static int remote_is_async_p (void);
 
+static int remote_supports_cond_breakpoints (void);
+
 static void remote_async (void (*callback) (enum inferior_event_type event_type,
 					    void *context), void *context);
 
@@ -315,6 +321,10 @@ struct remote_state
   /* True if the stub reports support for conditional tracepoints.  */
   int cond_tracepoints;
 
+  /* True if the stub reports support for evaluating the conditions of
+     Z0 breakpoints.  */
+  int cond_breakpoints;
+
   /* True if the stub reports support for fast tracepoints.  */
   int fast_tracepoints;
 
@@ -336,6 +346,25 @@ struct remote_state
   /* True if the stub can collect strings using tracenz bytecode.  */
   int string_tracing;
 
+  /* True if the stub processes memory read requests sent before it
+     replied to the previous ones, in order.  */
+  int pipelined_reads;
+
+  /* True if the stub can expand compressed packets.  */
+  int compressed_packets;
+
+  /* True if compressed packets from the stub are expanded.  This is
+     set as soon as compression is offered in qSupported, since the
+     reply to that may already be compressed, while COMPRESSED_PACKETS
+     waits for the stub to agree.  */
+  int accept_compressed;
+
+  /* Counts of compressed packets sent and received, their payload
+     bytes before compression and after compression and escaping.  */
+  ULONGEST compressed_sent, compressed_sent_bytes, compressed_sent_wire;
+  ULONGEST compressed_received, compressed_received_bytes;
+  ULONGEST compressed_received_wire;
+
   /* Nonzero if the user has pressed Ctrl-C, but the target hasn't
      responded to that.  */
   int ctrlc_pending_p;
@@ -346,12 +375,24 @@ struct private_thread_info
 {
   char *extra;
   int core;
+
+  /* The thread's registers as of the last qDeltaRegs reply, laid out
+     as in the 'g' packet, the availability of each of them (indexed
+     by GDB register number), and the generation number the stub
+     gave that reply.  A generation of zero means we have no
+     baseline.  */
+  gdb_byte *delta_regs;
+  char *delta_avail;
+  int delta_size;
+  ULONGEST delta_gen;
 };
 
 static void
 free_private_thread_info (struct private_thread_info *info)
 {
   xfree (info->extra);
+  xfree (info->delta_regs);
+  xfree (info->delta_avail);
   xfree (info);
 }
 
@@ -1004,6 +1045,13 @@ show_memory_read_packet_size (char *args, int from_tty)
   show_memory_packet_size (&memory_read_packet_config);
 }
 
+/* The most memory read requests to have outstanding at once, when
+   the stub supports it.  Values below 2 disable pipelining.  */
+static int remote_memory_read_pipeline = 8;
+
+/* Nonzero if GDB should offer to exchange compressed packets.  */
+static int remote_compressed_packets_p = 1;
+
 static long
 get_memory_read_packet_size (void)
 {
@@ -1225,6 +1273,7 @@ packet_ok (const char *buf, struct packet_config *config)
 enum {
   PACKET_vCont = 0,
   PACKET_X,
+  PACKET_x,
   PACKET_qSymbol,
   PACKET_P,
   PACKET_p,
@@ -1271,6 +1320,7 @@ enum {
   PACKET_QAllow,
   PACKET_qXfer_fdpic,
   PACKET_QDisableRandomization,
+  PACKET_qDeltaRegs,
   PACKET_MAX
 };
 
@@ -1583,6 +1633,10 @@ demand_private_info (ptid_t ptid)
       info->private_dtor = free_private_thread_info;
       info->private->core = -1;
       info->private->extra = 0;
+      info->private->delta_regs = NULL;
+      info->private->delta_avail = NULL;
+      info->private->delta_size = 0;
+      info->private->delta_gen = 0;
     }
 
   return info->private;
@@ -3679,6 +3733,16 @@ remote_cond_tracepoint_feature (const struct protocol_feature *feature,
   rs->cond_tracepoints = (support == PACKET_ENABLE);
 }
 
+static void
+remote_cond_breakpoint_feature (const struct protocol_feature *feature,
+				enum packet_support support,
+				const char *value)
+{
+  struct remote_state *rs = get_remote_state ();
+
+  rs->cond_breakpoints = (support == PACKET_ENABLE);
+}
+
 static void
 remote_fast_tracepoint_feature (const struct protocol_feature *feature,
 				enum packet_support support,
@@ -3739,8 +3803,32 @@ remote_string_tracing_feature (const struct protocol_feature *feature,
   rs->string_tracing = (support == PACKET_ENABLE);
 }
 
+static void
+remote_compressed_packets_feature (const struct protocol_feature *feature,
+				   enum packet_support support,
+				   const char *value)
+{
+  struct remote_state *rs = get_remote_state ();
+
+  /* Only believe the stub if we offered.  */
+  rs->compressed_packets = (support == PACKET_ENABLE
+			    && remote_compressed_packets_p);
+  rs->accept_compressed = rs->compressed_packets;
+}
+
+static void
+remote_pipelined_reads_feature (const struct protocol_feature *feature,
+				enum packet_support support,
+				const char *value)
+{
+  struct remote_state *rs = get_remote_state ();
+
+  rs->pipelined_reads = (support == PACKET_ENABLE);
+}
+
 static struct protocol_feature remote_protocol_features[] = {
   { "PacketSize", PACKET_DISABLE, remote_packet_size, -1 },
+  { "binary-upload", PACKET_DISABLE, remote_supported_packet, PACKET_x },
   { "qXfer:auxv:read", PACKET_DISABLE, remote_supported_packet,
     PACKET_qXfer_auxv },
   { "qXfer:features:read", PACKET_DISABLE, remote_supported_packet,
@@ -3795,8 +3883,16 @@ static struct protocol_feature remote_protocol_features[] = {
     PACKET_qXfer_fdpic },
   { "QDisableRandomization", PACKET_DISABLE, remote_supported_packet,
     PACKET_QDisableRandomization },
+  { "qDeltaRegs", PACKET_DISABLE, remote_supported_packet,
+    PACKET_qDeltaRegs },
   { "tracenz", PACKET_DISABLE,
     remote_string_tracing_feature, -1 },
+  { "ConditionalBreakpoints", PACKET_DISABLE,
+    remote_cond_breakpoint_feature, -1 },
+  { "PipelinedReads", PACKET_DISABLE,
+    remote_pipelined_reads_feature, -1 },
+  { "compressed-packets", PACKET_DISABLE,
+    remote_compressed_packets_feature, -1 },
 };
 
 static char *remote_support_xml;
@@ -3871,6 +3967,14 @@ remote_query_supported (void)
 
       q = remote_query_supported_append (q, "qRelocInsn+");
 
+      /* A stub that accepts compression may already compress its
+	 reply to this packet, so be ready to expand it.  Nothing is
+	 sent compressed until the reply says the stub agrees.  */
+      rs->compressed_packets = 0;
+      rs->accept_compressed = remote_compressed_packets_p;
+      if (remote_compressed_packets_p)
+	q = remote_query_supported_append (q, "compressed-packets+");
+
       q = reconcat (q, "qSupported:", q, (char *) NULL);
       putpkt (q);
 
@@ -4079,6 +4183,14 @@ remote_open_1 (char *name, int from_tty,
   rs->cached_wait_status = 0;
   rs->explicit_packet_size = 0;
   rs->noack_mode = 0;
+  rs->compressed_packets = 0;
+  rs->accept_compressed = 0;
+  rs->compressed_sent = 0;
+  rs->compressed_sent_bytes = 0;
+  rs->compressed_sent_wire = 0;
+  rs->compressed_received = 0;
+  rs->compressed_received_bytes = 0;
+  rs->compressed_received_wire = 0;
   rs->multi_process_aware = 0;
   rs->extended = extended_p;
   rs->non_stop_aware = 0;
@@ -5848,9 +5960,139 @@ process_g_packet (struct regcache *regcache)
     }
 }
 
+/* Fetch the registers included in the 'g' packet with qDeltaRegs,
+   which only transfers the registers that changed since the last
+   reply for the current thread.  Return 1 if REGCACHE was filled in,
+   0 if the caller should fall back to 'g'.  */
+
+static int
+fetch_registers_using_delta (struct regcache *regcache)
+{
+  struct gdbarch *gdbarch = get_regcache_arch (regcache);
+  struct remote_state *rs = get_remote_state ();
+  struct remote_arch_state *rsa = get_remote_arch_state ();
+  struct thread_info *tp;
+  struct private_thread_info *priv;
+  gdb_byte *data;
+  char *p;
+  long len;
+  int i, data_len;
+  ULONGEST gen;
+
+  if (remote_protocol_packets[PACKET_qDeltaRegs].support == PACKET_DISABLE)
+    return 0;
+
+  /* Traceframe registers are not tracked by generation.  Also wait
+     for a first 'g' to settle the size of the register block.  */
+  if (get_traceframe_number () != -1
+      || rsa->actual_register_packet_size == 0)
+    return 0;
+
+  tp = find_thread_ptid (inferior_ptid);
+  if (tp == NULL)
+    return 0;
+
+  priv = demand_private_info (inferior_ptid);
+  if (priv->delta_size != rsa->sizeof_g_packet)
+    {
+      xfree (priv->delta_regs);
+      xfree (priv->delta_avail);
+      priv->delta_size = rsa->sizeof_g_packet;
+      priv->delta_regs = xzalloc (priv->delta_size);
+      priv->delta_avail = xzalloc (gdbarch_num_regs (gdbarch));
+      priv->delta_gen = 0;
+    }
+
+  xsnprintf (rs->buf, get_remote_packet_size (), "qDeltaRegs:%s",
+	     phex_nz (priv->delta_gen, 0));
+  putpkt (rs->buf);
+  len = getpkt_sane (&rs->buf, &rs->buf_size, 0);
+  if (len <= 0)
+    return 0;
+
+  switch (packet_ok (rs->buf, &remote_protocol_packets[PACKET_qDeltaRegs]))
+    {
+    case PACKET_OK:
+      break;
+    case PACKET_UNKNOWN:
+    case PACKET_ERROR:
+      return 0;
+    }
+
+  if (rs->buf[0] != 'D')
+    error (_("Bad qDeltaRegs reply: %s"), rs->buf);
+  p = unpack_varlen_hex (rs->buf + 1, &gen);
+  if (*p++ != ';')
+    error (_("Bad qDeltaRegs reply: %s"), rs->buf);
+
+  /* From here on the baseline may be partially updated; forget it
+     unless the whole reply parses.  */
+  priv->delta_gen = 0;
+
+  data = alloca (len);
+  data_len = remote_unescape_input ((gdb_byte *) p, len - (p - rs->buf),
+				    data, len);
+  p = (char *) data;
+  while (p < (char *) data + data_len)
+    {
+      struct packet_reg *reg;
+      ULONGEST pnum;
+      int size;
+
+      if (!isxdigit (*p))
+	error (_("Bad qDeltaRegs reply"));
+      p = unpack_varlen_hex (p, &pnum);
+      reg = packet_reg_from_pnum (rsa, pnum);
+      if (reg == NULL || !reg->in_g_packet)
+	{
+	  /* The stub and we disagree about the register layout; stop
+	     using the packet.  */
+	  remote_protocol_packets[PACKET_qDeltaRegs].support
+	    = PACKET_DISABLE;
+	  return 0;
+	}
+
+      size = register_size (gdbarch, reg->regnum);
+      if (*p == 'x')
+	{
+	  priv->delta_avail[reg->regnum] = 0;
+	  memset (priv->delta_regs + reg->offset, 0, size);
+	  p++;
+	}
+      else if (*p == ':' && p + 1 + size <= (char *) data + data_len)
+	{
+	  priv->delta_avail[reg->regnum] = 1;
+	  memcpy (priv->delta_regs + reg->offset, p + 1, size);
+	  p += 1 + size;
+	}
+      else
+	error (_("Bad qDeltaRegs reply"));
+    }
+  priv->delta_gen = gen;
+
+  for (i = 0; i < gdbarch_num_regs (gdbarch); i++)
+    {
+      struct packet_reg *r = &rsa->regs[i];
+
+      if (r->in_g_packet)
+	{
+	  if (priv->delta_avail[r->regnum])
+	    regcache_raw_supply (regcache, r->regnum,
+				 priv->delta_regs + r->offset);
+	  else
+	    regcache_raw_supply (regcache, r->regnum, NULL);
+	}
+    }
+
+  return 1;
+}
+
 static void
 fetch_registers_using_g (struct regcache *regcache)
 {
+  if (fetch_registers_using_delta (regcache))
+    return;
+
   send_g_packet ();
   process_g_packet (regcache);
 }
@@ -6496,43 +6738,69 @@ remote_write_bytes (CORE_ADDR memaddr, const gdb_byte *myaddr, int len)
 				 memaddr, myaddr, len, packet_format[0], 1);
 }
 
-/* Read memory data directly from the remote machine.
-   This does not use the data cache; the data cache uses this.
-   MEMADDR is the address in the remote memory space.
-   MYADDR is the address of the buffer in our space.
-   LEN is the number of bytes.
-
-   Returns number of bytes transferred, or 0 for error.  */
+/* Return the number of bytes to request with one memory read packet,
+   and set *BINARY according to whether it should be an 'x' packet.  */
 
 static int
-remote_read_bytes (CORE_ADDR memaddr, gdb_byte *myaddr, int len)
+remote_read_bytes_chunk (int *binary)
 {
-  struct remote_state *rs = get_remote_state ();
   int max_buf_size;		/* Max size of packet output buffer.  */
-  char *p;
-  int todo;
-  int i;
-
-  if (len <= 0)
-    return 0;
 
   max_buf_size = get_memory_read_packet_size ();
   /* The packet buffer will be large enough for the payload;
      get_memory_packet_size ensures this.  */
 
-  /* Number if bytes that will fit.  */
-  todo = min (len, max_buf_size / 2);
+  /* Only use the binary "x" packet if the stub said it supports it;
+     there is no sensible fallback once a stub misparses one.  */
+  *binary = (remote_protocol_packets[PACKET_x].support == PACKET_ENABLE);
+
+  /* Number if bytes that will fit.  A binary reply is a 'b' followed by
+     the escaped data; if escaping makes it longer than the packet, the
+     stub sends back as much as fits.  */
+  if (*binary)
+    return max_buf_size - 1;
+  else
+    return max_buf_size / 2;
+}
+
+/* Send a request to read TODO bytes at MEMADDR, in binary if
+   BINARY.  */
+
+static void
+remote_send_read_request (CORE_ADDR memaddr, int todo, int binary)
+{
+  struct remote_state *rs = get_remote_state ();
+  char *p;
 
-  /* Construct "m"<memaddr>","<len>".  */
+  /* Construct "m"<memaddr>","<len>" or "x"<memaddr>","<len>".  */
   memaddr = remote_address_masked (memaddr);
   p = rs->buf;
-  *p++ = 'm';
+  *p++ = binary ? 'x' : 'm';
   p += hexnumstr (p, (ULONGEST) memaddr);
   *p++ = ',';
   p += hexnumstr (p, (ULONGEST) todo);
   *p = '\0';
   putpkt (rs->buf);
-  getpkt (&rs->buf, &rs->buf_size, 0);
+}
+
+/* Receive the reply to a request sent by remote_send_read_request,
+   storing up to TODO bytes in MYADDR.  Return the number of bytes
+   read, or 0 with errno set on error.  Return -1 with errno set if no
+   reply could be received at all.  */
+
+static int
+remote_read_bytes_reply (gdb_byte *myaddr, int todo, int binary)
+{
+  struct remote_state *rs = get_remote_state ();
+  int packet_len;
+
+  packet_len = getpkt_sane (&rs->buf, &rs->buf_size, 0);
+  if (packet_len < 0)
+    {
+      errno = EIO;
+      return -1;
+    }
+
   if (rs->buf[0] == 'E'
       && isxdigit (rs->buf[1]) && isxdigit (rs->buf[2])
       && rs->buf[3] == '\0')
@@ -6545,14 +6813,140 @@ remote_read_bytes (CORE_ADDR memaddr, gdb_byte *myaddr, int len)
       errno = EIO;
       return 0;
     }
+
+  if (binary)
+    {
+      if (packet_ok (rs->buf, &remote_protocol_packets[PACKET_x]) != PACKET_OK
+	  || rs->buf[0] != 'b')
+	error (_("Unexpected reply to x packet: %s"), rs->buf);
+
+      /* Return what we have.  Let higher layers handle partial reads.  */
+      return remote_unescape_input ((gdb_byte *) rs->buf + 1, packet_len - 1,
+				    myaddr, todo);
+    }
+
   /* Reply describes memory byte by byte, each byte encoded as two hex
-     characters.  */
-  p = rs->buf;
-  i = hex2bin (p, myaddr, todo);
-  /* Return what we have.  Let higher layers handle partial reads.  */
-  return i;
+     characters.  Return what we have.  Let higher layers handle partial
+     reads.  */
+  return hex2bin (rs->buf, myaddr, todo);
+}
+
+/* Read memory data directly from the remote machine.
+   This does not use the data cache; the data cache uses this.
+   MEMADDR is the address in the remote memory space.
+   MYADDR is the address of the buffer in our space.
+   LEN is the number of bytes.
+
+   Returns number of bytes transferred, or 0 for error.  */
+
+static int
+remote_read_bytes (CORE_ADDR memaddr, gdb_byte *myaddr, int len)
+{
+  int binary;
+  int todo, res;
+
+  if (len <= 0)
+    return 0;
+
+  todo = min (len, remote_read_bytes_chunk (&binary));
+  remote_send_read_request (memaddr, todo, binary);
+  res = remote_read_bytes_reply (myaddr, todo, binary);
+  return res < 0 ? 0 : res;
+}
+
+/* Replies to memory read requests still to be received, for
+   remote_read_bytes_pipelined.  */
+
+struct pending_read_replies
+{
+  int count;
+};
+
+static void
+drain_read_replies (void *arg)
+{
+  struct pending_read_replies *pending = arg;
+  struct remote_state *rs = get_remote_state ();
+
+  /* Keep the stream in sync; replies we can't use are dropped.  */
+  for (; pending->count > 0; pending->count--)
+    if (getpkt_sane (&rs->buf, &rs->buf_size, 0) < 0)
+      break;
+}
+
+/* Read LEN bytes at MEMADDR into MYADDR, sending several requests
+   before waiting for the replies so that large reads are not bound by
+   the link latency.  The stub answers the requests in order.  Return
+   the number of bytes read from the start of the range, like
+   remote_read_bytes.
+
+   Without acks, nothing ties a reply to its request.  If a reply does
+   not arrive in time, the rest can't be told apart from it, so they
+   are all drained, and pipelining is turned off for the connection.  */
+
+static int
+remote_read_bytes_pipelined (CORE_ADDR memaddr, gdb_byte *myaddr, int len)
+{
+  struct remote_state *rs = get_remote_state ();
+  struct pending_read_replies pending;
+  struct cleanup *old_chain;
+  int binary, chunk, nreqs, i;
+  int xfered = 0, contiguous = 1;
+
+  chunk = remote_read_bytes_chunk (&binary);
+
+  /* Leave room for escaping, so that the stub rarely has to cut a
+     reply short; that would leave a hole before the following
+     replies.  */
+  if (binary)
+    chunk -= chunk / 8;
+
+  nreqs = (len + chunk - 1) / chunk;
+  if (nreqs > remote_memory_read_pipeline)
+    nreqs = remote_memory_read_pipeline;
+
+  for (i = 0; i < nreqs; i++)
+    remote_send_read_request (memaddr + i * chunk,
+			      min (chunk, len - i * chunk), binary);
+
+  pending.count = nreqs;
+  old_chain = make_cleanup (drain_read_replies, &pending);
+
+  errno = 0;
+  for (i = 0; i < nreqs; i++)
+    {
+      int todo = min (chunk, len - i * chunk);
+      int res;
+
+      res = remote_read_bytes_reply (myaddr + i * chunk, todo, binary);
+      if (res < 0)
+	{
+	  /* The late reply, if it comes, and those after it are
+	     drained by the cleanup.  */
+	  warning (_("Timed out waiting for pipelined memory reads; "
+		     "disabling pipelining."));
+	  rs->pipelined_reads = 0;
+	  break;
+	}
+      pending.count--;
+
+      if (contiguous)
+	{
+	  xfered += res;
+	  if (res < todo)
+	    contiguous = 0;
+	}
+    }
+
+  do_cleanups (old_chain);
+
+  /* Report an error only if nothing could be read.  */
+  if (xfered > 0)
+    errno = 0;
+  else if (errno == 0)
+    errno = EIO;
+  return xfered;
 }
-
 
 /* Remote notification handler.  */
 
@@ -6821,6 +7215,114 @@ putpkt (char *buf)
   return putpkt_binary (buf, strlen (buf));
 }
 
+/* If the remote target accepts compressed packets and the CNT bytes
+   at BUF are worth compressing, return a newly allocated compressed
+   packet and store its length in CNT.  Otherwise return NULL.  */
+
+static char *
+remote_compress_packet (char *buf, int *cnt)
+{
+  struct remote_state *rs = get_remote_state ();
+  gdb_byte *data;
+  char *zbuf;
+  int data_len, header_len, out_len, consumed;
+
+  if (!rs->compressed_packets || *cnt < RSP_LZ_MIN_LENGTH)
+    return NULL;
+
+  data = xmalloc (*cnt);
+  data_len = rsp_lz_compress ((gdb_byte *) buf, *cnt, data, *cnt);
+  if (data_len < 0)
+    {
+      xfree (data);
+      return NULL;
+    }
+
+  zbuf = xmalloc (*cnt);
+  zbuf[0] = RSP_LZ_MARKER;
+  header_len = 1 + hexnumstr (zbuf + 1, (ULONGEST) *cnt);
+  zbuf[header_len++] = ':';
+  out_len = remote_escape_output (data, data_len,
+				  (gdb_byte *) zbuf + header_len,
+				  &consumed, *cnt - header_len - 1);
+  xfree (data);
+  if (consumed < data_len)
+    {
+      xfree (zbuf);
+      return NULL;
+    }
+
+  rs->compressed_sent++;
+  rs->compressed_sent_bytes += *cnt;
+  rs->compressed_sent_wire += header_len + out_len;
+  *cnt = header_len + out_len;
+  return zbuf;
+}
+
+/* If the packet of LEN bytes in *BUF_P is compressed, expand it in
+   place, growing *BUF_P and *SIZEOF_BUF if necessary.  Return the
+   length of the expanded packet, or -1 if it is malformed.  Packets
+   are only expanded if compression was offered in qSupported and,
+   past the reply to it, if the stub agreed; see accept_compressed.  */
+
+static long
+remote_decompress_packet (char **buf_p, long *sizeof_buf, long len)
+{
+  struct remote_state *rs = get_remote_state ();
+  struct cleanup *old_chain;
+  char *buf = *buf_p;
+  gdb_byte *data;
+  ULONGEST out_len = 0;
+  long i;
+  int data_len;
+
+  if (!rs->accept_compressed || len == 0 || buf[0] != RSP_LZ_MARKER)
+    return len;
+
+  for (i = 1; i < len && isxdigit (buf[i]); i++)
+    {
+      out_len = (out_len << 4) | fromhex (buf[i]);
+      if (out_len > INT_MAX)
+	break;
+    }
+  /* No match token can expand to more than 255 bytes per byte of
+     compressed data; anything claiming more is bogus.  */
+  if (i == 1 || i >= len || buf[i] != ':' || out_len > (ULONGEST) len * 255)
+    {
+      if (remote_debug)
+	fprintf_unfiltered (gdb_stdlog, "Malformed compressed packet\n");
+      return -1;
+    }
+  i++;
+
+  data = xmalloc (len - i);
+  old_chain = make_cleanup (xfree, data);
+  data_len = remote_unescape_input ((gdb_byte *) buf + i, len - i,
+				    data, len - i);
+
+  if (*sizeof_buf < out_len + 1)
+    {
+      *sizeof_buf = out_len + 1;
+      *buf_p = xrealloc (*buf_p, *sizeof_buf);
+      buf = *buf_p;
+    }
+
+  if (rsp_lz_decompress (data, data_len, (gdb_byte *) buf, out_len) < 0)
+    {
+      do_cleanups (old_chain);
+      if (remote_debug)
+	fprintf_unfiltered (gdb_stdlog, "Malformed compressed packet\n");
+      return -1;
+    }
+  do_cleanups (old_chain);
+  buf[out_len] = '\0';
+
+  rs->compressed_received++;
+  rs->compressed_received_bytes += out_len;
+  rs->compressed_received_wire += len;
+  return out_len;
+}
+
 /* Send a packet to the remote machine, with error checking.  The data
    of the packet is in BUF.  The string in BUF can be at most
    get_remote_packet_size () - 5 to account for the $, # and checksum,
@@ -6833,7 +7335,8 @@ putpkt_binary (char *buf, int cnt)
   struct remote_state *rs = get_remote_state ();
   int i;
   unsigned char csum = 0;
-  char *buf2 = alloca (cnt + 6);
+  char *buf2;
+  char *zbuf;
 
   int ch;
   int tcount = 0;
@@ -6853,6 +7356,11 @@ putpkt_binary (char *buf, int cnt)
      stale cached response.  */
   rs->cached_wait_status = 0;
 
+  zbuf = remote_compress_packet (buf, &cnt);
+  if (zbuf != NULL)
+    buf = zbuf;
+  buf2 = alloca (cnt + 6);
+
   /* Copy the packet into buffer BUF2, encapsulating it
      and giving it a checksum.  */
 
@@ -6867,6 +7375,7 @@ putpkt_binary (char *buf, int cnt)
   *p++ = '#';
   *p++ = tohex ((csum >> 4) & 0xf);
   *p++ = tohex (csum & 0xf);
+  xfree (zbuf);
 
   /* Send it over and over until we get a positive ack.  */
 
@@ -7123,11 +7632,11 @@ read_frame (char **buf_p,
 	       don't have any way to indicate a packet retransmission
 	       is necessary.  */
 	    if (rs->noack_mode)
-	      return bc;
+	      return remote_decompress_packet (buf_p, sizeof_buf, bc);
 
 	    pktcsum = (fromhex (check_0) << 4) | fromhex (check_1);
 	    if (csum == pktcsum)
-              return bc;
+	      return remote_decompress_packet (buf_p, sizeof_buf, bc);
 
 	    if (remote_debug)
 	      {
@@ -7678,6 +8187,35 @@ extended_remote_create_inferior (struct target_ops *ops,
    support, we ask the remote target to do the work; on targets
    which don't, we insert a traditional memory breakpoint.  */
 
+/* Append the conditions of BP_TGT to the Z0 packet being built in
+   RS->BUF, at P.  If they do not all fit in a packet, leave the
+   breakpoint unconditional; GDB evaluates the conditions anyway.  */
+
+static void
+remote_add_target_side_condition (struct bp_target_info *bp_tgt, char *p)
+{
+  struct remote_state *rs = get_remote_state ();
+  char *endbuf = rs->buf + get_remote_packet_size ();
+  char *start = p;
+  struct agent_expr *aexpr;
+  int ix;
+
+  for (ix = 0;
+       VEC_iterate (agent_expr_p, bp_tgt->conditions, ix, aexpr);
+       ix++)
+    {
+      /* ";X", the length, "," and the bytes in hex.  */
+      if (endbuf - p < 2 + 8 + 1 + 2 * aexpr->len + 1)
+	{
+	  *start = '\0';
+	  return;
+	}
+      p += sprintf (p, ";X%x,", aexpr->len);
+      p += 2 * bin2hex (aexpr->buf, p, aexpr->len);
+    }
+  *p = '\0';
+}
+
 static int
 remote_insert_breakpoint (struct gdbarch *gdbarch,
 			  struct bp_target_info *bp_tgt)
@@ -7704,7 +8242,10 @@ remote_insert_breakpoint (struct gdbarch *gdbarch,
       *(p++) = ',';
       addr = (ULONGEST) remote_address_masked (addr);
       p += hexnumstr (p, addr);
-      sprintf (p, ",%d", bpsize);
+      p += sprintf (p, ",%d", bpsize);
+
+      if (remote_supports_cond_breakpoints ())
+	remote_add_target_side_condition (bp_tgt, p);
 
       putpkt (rs->buf);
       getpkt (&rs->buf, &rs->buf_size, 0);
@@ -8263,6 +8804,11 @@ remote_xfer_partial (struct target_ops *ops, enum target_object object,
 
       if (writebuf != NULL)
 	xfered = remote_write_bytes (offset, writebuf, len);
+      /* Without acks, requests can be queued up behind each other.  */
+      else if (rs->pipelined_reads && rs->noack_mode
+	       && remote_memory_read_pipeline > 1
+	       && len > get_memory_read_packet_size ())
+	xfered = remote_read_bytes_pipelined (offset, readbuf, len);
       else
 	xfered = remote_read_bytes (offset, readbuf, len);
 
@@ -8628,6 +9174,37 @@ packet_command (char *args, int from_tty)
   puts_filtered ("\n");
 }
 
+/* Print how many packets were compressed in each direction, and how
+   many bytes that saved.  */
+
+static void
+maintenance_info_remote_compression (char *args, int from_tty)
+{
+  struct remote_state *rs = get_remote_state ();
+
+  if (!remote_desc)
+    error (_("command can only be used with remote target"));
+
+  if (!rs->compressed_packets)
+    printf_filtered (_("The remote target does not accept "
+		       "compressed packets.\n"));
+  printf_filtered (_("Compressed packets sent: %s, %s bytes "
+		     "as %s on the wire.\n"),
+		   pulongest (rs->compressed_sent),
+		   pulongest (rs->compressed_sent_bytes),
+		   pulongest (rs->compressed_sent_wire));
+  printf_filtered (_("Compressed packets received: %s, %s bytes "
+		     "as %s on the wire.\n"),
+		   pulongest (rs->compressed_received),
+		   pulongest (rs->compressed_received_bytes),
+		   pulongest (rs->compressed_received_wire));
+  printf_filtered (_("Bytes saved: %s.\n"),
+		   pulongest (rs->compressed_sent_bytes
+			      - rs->compressed_sent_wire
+			      + rs->compressed_received_bytes
+			      - rs->compressed_received_wire));
+}
+
 #if 0
 /* --------- UNIT_TEST for THREAD oriented PACKETS ------------------- */
 
@@ -9762,6 +10339,18 @@ remote_supports_cond_tracepoints (void)
   return rs->cond_tracepoints;
 }
 
+/* Breakpoint conditions travel with Z0 packets, so the stub can only
+   evaluate them if we are using those.  */
+
+static int
+remote_supports_cond_breakpoints (void)
+{
+  struct remote_state *rs = get_remote_state ();
+
+  return (rs->cond_breakpoints
+	  && remote_protocol_packets[PACKET_Z0].support != PACKET_DISABLE);
+}
+
 int
 remote_supports_fast_tracepoints (void)
 {
@@ -10651,6 +11240,8 @@ Specify the serial device it is connected to\n\
     = remote_supports_disable_randomization;
   remote_ops.to_supports_enable_disable_tracepoint = remote_supports_enable_disable_tracepoint;
   remote_ops.to_supports_string_tracing = remote_supports_string_tracing;
+  remote_ops.to_supports_evaluation_of_breakpoint_conditions
+    = remote_supports_cond_breakpoints;
   remote_ops.to_trace_init = remote_trace_init;
   remote_ops.to_download_tracepoint = remote_download_tracepoint;
   remote_ops.to_can_download_tracepoint = remote_can_download_tracepoint;
@@ -10942,6 +11533,11 @@ response packet.  GDB supplies the initial `$' character, and the\n\
 terminating `#' character and checksum."),
 	   &maintenancelist);
 
+  add_cmd ("remote-compression", class_maintenance,
+	   maintenance_info_remote_compression, _("\
+Show statistics about compressed remote protocol packets."),
+	   &maintenanceinfolist);
+
   add_setshow_boolean_cmd ("remotebreak", no_class, &remote_break, _("\
 Set whether to send break if interrupted."), _("\
 Show whether to send break if interrupted."), _("\
@@ -11006,6 +11602,26 @@ further restriction and ``limit'' to enable that restriction."),
 	   _("Show the maximum number of bytes per memory-read packet."),
 	   &remote_show_cmdlist);
 
+  add_setshow_zinteger_cmd ("memory-read-pipeline", no_class,
+			    &remote_memory_read_pipeline, _("\
+Set the maximum number of memory read requests in flight at once."), _("\
+Show the maximum number of memory read requests in flight at once."), _("\
+If the stub supports it, large memory reads are split into several\n\
+requests which are all sent before waiting for the first reply.\n\
+Specify a value below 2 to send one request at a time."),
+			    NULL, NULL,
+			    &remote_set_cmdlist, &remote_show_cmdlist);
+
+  add_setshow_boolean_cmd ("compressed-packets", no_class,
+			   &remote_compressed_packets_p, _("\
+Set whether to offer to exchange compressed packets."), _("\
+Show whether to offer to exchange compressed packets."), _("\
+If enabled, GDB asks the stub to compress large packets it sends,\n\
+and compresses its own large packets if the stub accepts them.\n\
+This takes effect the next time GDB connects to a target."),
+			   NULL, NULL,
+			   &remote_set_cmdlist, &remote_show_cmdlist);
+
   add_setshow_zinteger_cmd ("hardware-watchpoint-limit", no_class,
 			    &remote_hw_watchpoint_limit, _("\
 Set the maximum number of target hardware watchpoints."), _("\
@@ -11045,6 +11661,9 @@ Show the maximum size of the address (in bits) in a memory packet."), NULL,
   add_packet_config_cmd (&remote_protocol_packets[PACKET_X],
 			 "X", "binary-download", 1);
 
+  add_packet_config_cmd (&remote_protocol_packets[PACKET_x],
+			 "x", "binary-upload", 0);
+
   add_packet_config_cmd (&remote_protocol_packets[PACKET_vCont],
 			 "vCont", "verbose-resume", 0);
 
@@ -11189,6 +11808,9 @@ Show the maximum size of the address (in bits) in a memory packet."), NULL,
   add_packet_config_cmd (&remote_protocol_packets[PACKET_QDisableRandomization],
 			 "QDisableRandomization", "disable-randomization", 0);
 
+  add_packet_config_cmd (&remote_protocol_packets[PACKET_qDeltaRegs],
+			 "qDeltaRegs", "delta-registers", 0);
+
   /* Keep the old ``set remote Z-packet ...'' working.  Each individual
      Z sub-packet has its own set and show commands, but users may
      have sets to this variable in their .gdbinit files (or in their
@@ -18,16 +18,23 @@
    along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
 
 #include "defs.h"
+#include "arch-utils.h"
 #include "breakpoint.h"
+#include "command.h"
+#include "gdbcmd.h"
 #include "gdbcore.h"
 #include "inferior.h"
 #include "nacl-manifest.h"
 #include "nacl-tdep.h"
+#include "gdbthread.h"
 #include "objfiles.h"
 #include "observer.h"
+#include "regcache.h"
 #include "solib.h"
+#include "solib-nacl.h"
 #include "solib-svr4.h"
 #include "solist.h"
+#include "vec.h"
 
 
 /* Link map info to include in an allocated so_list entry.
@@ -61,10 +68,303 @@ static CORE_ADDR nacl_sandbox_base;
 static CORE_ADDR nacl_entry_point;
 
 
+/* Native Client sandbox, a region of the process address space with
+   untrusted code and data.  */
+
+typedef struct nacl_sandbox
+  {
+    CORE_ADDR base;
+
+    ULONGEST size;
+
+    /* Sandbox-relative end of the validated static code of the NaCl
+       program, or 0 if not known.  Code below it can not change while
+       the sandbox exists; dynamic code is only ever placed above it.  */
+    ULONGEST static_text_end;
+
+    /* Runtime architecture GDBARCH was looked up for.  */
+    struct gdbarch *runtime_gdbarch;
+
+    /* NaCl architecture for code in this sandbox, or NULL if there is none.
+       Valid iff RUNTIME_GDBARCH is target_gdbarch.  */
+    struct gdbarch *gdbarch;
+  } nacl_sandbox_s;
+
+DEF_VEC_O (nacl_sandbox_s);
+
+
+/* Per-inferior registry of sandboxes.  The only sandbox registered so
+   far is the one nacl_update_sandbox_base finds through the service
+   runtime, but lookups do not assume there is just one.  */
+
+struct nacl_inferior_info
+  {
+    /* Sandboxes sorted by base, never overlapping.  */
+    VEC (nacl_sandbox_s) *sandboxes;
+
+    /* Index of the sandbox that was found last.  Consecutive lookups tend
+       to hit the same sandbox.  Only a lookup hint, results never depend
+       on it.  */
+    int last_found;
+  };
+
+
+static const struct inferior_data *nacl_inferior_data;
+
+
+/* Value of "set nacl-sandbox-bits", 0 means pick the default for the
+   architecture.  */
+
+static int nacl_sandbox_bits;
+
+
+static void
+nacl_inferior_data_cleanup (struct inferior *inf, void *arg)
+{
+  struct nacl_inferior_info *info = arg;
+
+  if (info != NULL)
+    {
+      VEC_free (nacl_sandbox_s, info->sandboxes);
+      xfree (info);
+    }
+}
+
+
+static void
+nacl_invalidate_sandboxes (struct inferior *inf)
+{
+  struct nacl_inferior_info *info = inferior_data (inf, nacl_inferior_data);
+
+  nacl_inferior_data_cleanup (inf, info);
+  set_inferior_data (inf, nacl_inferior_data, NULL);
+}
+
+
+static struct nacl_inferior_info *
+get_nacl_inferior_info (struct inferior *inf)
+{
+  struct nacl_inferior_info *info = inferior_data (inf, nacl_inferior_data);
+
+  if (info == NULL)
+    {
+      info = XZALLOC (struct nacl_inferior_info);
+      set_inferior_data (inf, nacl_inferior_data, info);
+    }
+
+  return info;
+}
+
+
+static int
+nacl_sandbox_lessthan (const nacl_sandbox_s *lhs, const nacl_sandbox_s *rhs)
+{
+  return lhs->base < rhs->base;
+}
+
+
+/* Return sandbox of inferior INF containing ADDR, or NULL.  */
+
+static nacl_sandbox_s *
+nacl_find_sandbox (struct inferior *inf, CORE_ADDR addr)
+{
+  struct nacl_inferior_info *info = inferior_data (inf, nacl_inferior_data);
+  nacl_sandbox_s key;
+  nacl_sandbox_s *sandbox;
+  unsigned ix;
+
+  if (info == NULL || VEC_empty (nacl_sandbox_s, info->sandboxes))
+    return NULL;
+
+  if (info->last_found < VEC_length (nacl_sandbox_s, info->sandboxes))
+    {
+      sandbox = VEC_index (nacl_sandbox_s, info->sandboxes, info->last_found);
+      if (addr >= sandbox->base && addr - sandbox->base < sandbox->size)
+        return sandbox;
+    }
+
+  /* Find the last sandbox with base <= ADDR.  */
+  key.base = addr + 1;
+  ix = VEC_lower_bound (nacl_sandbox_s, info->sandboxes, &key,
+                        nacl_sandbox_lessthan);
+  if (ix == 0 || addr + 1 == 0)
+    return NULL;
+
+  sandbox = VEC_index (nacl_sandbox_s, info->sandboxes, ix - 1);
+  if (addr - sandbox->base >= sandbox->size)
+    return NULL;
+
+  info->last_found = ix - 1;
+  return sandbox;
+}
+
+
+/* Size of a sandbox.  Native Client is only supported on x86-64 here,
+   where sandboxes are 4GB.  */
+
+static ULONGEST
+nacl_default_sandbox_size (void)
+{
+  if (nacl_sandbox_bits)
+    return (ULONGEST) 1 << nacl_sandbox_bits;
+
+  return (ULONGEST) 1 << 32;
+}
+
+
+void
+nacl_register_sandbox (struct inferior *inf, CORE_ADDR base, ULONGEST size)
+{
+  struct nacl_inferior_info *info = get_nacl_inferior_info (inf);
+  nacl_sandbox_s sandbox;
+  nacl_sandbox_s *curr, *prev, *next;
+  unsigned ix;
+
+  memset (&sandbox, 0, sizeof (sandbox));
+  sandbox.base = base;
+  sandbox.size = size;
+
+  ix = VEC_lower_bound (nacl_sandbox_s, info->sandboxes, &sandbox,
+                        nacl_sandbox_lessthan);
+
+  curr = (ix < VEC_length (nacl_sandbox_s, info->sandboxes)
+          ? VEC_index (nacl_sandbox_s, info->sandboxes, ix) : NULL);
+  next = curr;
+  if (curr && curr->base == base)
+    next = (ix + 1 < VEC_length (nacl_sandbox_s, info->sandboxes)
+            ? VEC_index (nacl_sandbox_s, info->sandboxes, ix + 1) : NULL);
+  prev = ix > 0 ? VEC_index (nacl_sandbox_s, info->sandboxes, ix - 1) : NULL;
+
+  /* Lookups rely on sandboxes not overlapping.  */
+  if ((prev && base - prev->base < prev->size)
+      || (next && next->base - base < size))
+    {
+      warning (_("Native Client sandbox at %s overlaps a known sandbox, "
+                 "ignoring it."), paddress (target_gdbarch, base));
+      return;
+    }
+
+  if (curr && curr->base == base)
+    {
+      /* Already known, keep the cached architecture.  */
+      curr->size = size;
+      return;
+    }
+
+  VEC_safe_insert (nacl_sandbox_s, info->sandboxes, ix, &sandbox);
+}
+
+
+void
+nacl_unregister_sandbox (struct inferior *inf, CORE_ADDR base)
+{
+  struct nacl_inferior_info *info = inferior_data (inf, nacl_inferior_data);
+  nacl_sandbox_s *sandbox = info ? nacl_find_sandbox (inf, base) : NULL;
+
+  if (sandbox && sandbox->base == base)
+    VEC_ordered_remove (nacl_sandbox_s, info->sandboxes,
+                        sandbox - VEC_address (nacl_sandbox_s,
+                                               info->sandboxes));
+}
+
+
+struct gdbarch *
+nacl_sandbox_gdbarch (struct inferior *inf, CORE_ADDR addr)
+{
+  nacl_sandbox_s *sandbox = nacl_find_sandbox (inf, addr);
+
+  if (!sandbox)
+    return NULL;
+
+  if (sandbox->runtime_gdbarch != target_gdbarch)
+    {
+      struct gdbarch_info info;
+
+      /* NaCl and runtime architectures differ by OS ABI only.  */
+      gdbarch_info_init (&info);
+      info.bfd_arch_info = gdbarch_bfd_arch_info (target_gdbarch);
+      info.osabi = GDB_OSABI_NACL;
+
+      sandbox->gdbarch = gdbarch_find_by_info (info);
+      sandbox->runtime_gdbarch = target_gdbarch;
+    }
+
+  return sandbox->gdbarch;
+}
+
+
+int
+nacl_sandbox_range (struct inferior *inf, CORE_ADDR addr,
+                    CORE_ADDR *base, ULONGEST *size,
+                    ULONGEST *static_text_end)
+{
+  nacl_sandbox_s *sandbox = nacl_find_sandbox (inf, addr);
+
+  if (!sandbox)
+    return 0;
+
+  *base = sandbox->base;
+  *size = sandbox->size;
+  *static_text_end = sandbox->static_text_end;
+  return 1;
+}
+
+
+/* Record END as the end of the static code of the sandbox starting at
+   BASE in inferior INF.  */
+
+static void
+nacl_set_sandbox_static_text_end (struct inferior *inf, CORE_ADDR base,
+                                  ULONGEST end)
+{
+  nacl_sandbox_s *sandbox = nacl_find_sandbox (inf, base);
+
+  if (sandbox && sandbox->base == base)
+    sandbox->static_text_end = end;
+}
+
+
+int
+nacl_sandbox_address_p (CORE_ADDR addr)
+{
+  return nacl_find_sandbox (current_inferior (), addr) != NULL;
+}
+
+
+/* Return base of the sandbox that untrusted pointers are relative to,
+   or 0 if there is none.  That is the sandbox containing the pc of the
+   current thread.  If the thread is outside of all sandboxes, e.g. in
+   the service runtime, it is the sandbox the NaCl program was found in.  */
+
+static CORE_ADDR
+nacl_current_sandbox_base (void)
+{
+  struct inferior *inf = current_inferior ();
+  nacl_sandbox_s *sandbox = NULL;
+
+  if (!ptid_equal (inferior_ptid, null_ptid)
+      && target_has_registers
+      && !is_executing (inferior_ptid))
+    {
+      struct regcache *regcache;
+
+      /* Get runtime-side pc, as nacl_thread_architecture does.  */
+      regcache = get_thread_arch_regcache (inferior_ptid, target_gdbarch);
+      sandbox = nacl_find_sandbox (inf, regcache_read_pc (regcache));
+    }
+
+  if (sandbox == NULL && nacl_sandbox_base)
+    sandbox = nacl_find_sandbox (inf, nacl_sandbox_base);
+
+  return sandbox ? sandbox->base : 0;
+}
+
+
 static CORE_ADDR
 nacl_update_sandbox_base (void)
 {
   struct minimal_symbol *addr_sym;
+  CORE_ADDR prev_sandbox_base = nacl_sandbox_base;
 
   nacl_sandbox_base = 0;
 
@@ -79,19 +379,14 @@ nacl_update_sandbox_base (void)
         }
     }
 
-  return nacl_sandbox_base;
-}
+  if (prev_sandbox_base && prev_sandbox_base != nacl_sandbox_base)
+    nacl_unregister_sandbox (current_inferior (), prev_sandbox_base);
 
+  if (nacl_sandbox_base)
+    nacl_register_sandbox (current_inferior (), nacl_sandbox_base,
+                           nacl_default_sandbox_size ());
 
-int
-nacl_sandbox_address_p (CORE_ADDR addr)
-{
-  if (nacl_sandbox_base &&
-      addr >= nacl_sandbox_base &&
-      addr < nacl_sandbox_base + 4ULL * 1024ULL * 1024ULL * 1024ULL)
-    return 1;
-
-  return 0;
+  return nacl_sandbox_base;
 }
 
 
@@ -103,7 +398,7 @@ nacl_pointer_to_address (struct gdbarch *gdbarch,
   CORE_ADDR addr = unsigned_pointer_to_address (gdbarch, type, buf);
 
   if (addr)
-    addr = nacl_sandbox_base + (unsigned) addr;
+    addr = nacl_current_sandbox_base () + (unsigned) addr;
 
   return addr;
 }
@@ -138,17 +433,86 @@ struct ldso_interface
   };
 
 
-static int
-nacl_discover_ldso_interface (struct ldso_interface *ldso)
+/* Cached ld.so interface, valid iff NACL_LDSO_VALID_P.  It is only
+   recomputed when the sandbox base, the manifest or the program
+   objfile changes, as nacl_current_sos runs on every solib event.  */
+
+static struct ldso_interface nacl_ldso;
+
+static int nacl_ldso_valid_p;
+
+/* Sandbox base NACL_LDSO was discovered for.  */
+
+static CORE_ADDR nacl_ldso_sandbox_base;
+
+/* Manifest generation NACL_LDSO was discovered for.  */
+
+static int nacl_ldso_manifest_generation;
+
+/* Objfile NACL_LDSO was resolved through, or NULL if it came from the
+   program bfd because the objfile was not loaded yet.  */
+
+static struct objfile *nacl_ldso_objfile;
+
+
+static void
+nacl_invalidate_ldso_interface (void)
 {
-  bfd* abfd;
+  nacl_ldso_valid_p = 0;
+  nacl_ldso_objfile = NULL;
+}
 
-  gdb_assert (nacl_manifest_program ());
 
-  memset (ldso, 0, sizeof (*ldso));
+/* Return the objfile of the Native Client program, if already loaded.  */
+
+static struct objfile *
+nacl_find_program_objfile (void)
+{
+  struct so_list *so;
+
+  for (so = master_so_list (); so; so = so->next)
+    {
+      if (so->objfile
+          && strcmp (so->so_original_name, nacl_manifest_program ()) == 0)
+        return so->objfile;
+    }
+
+  return NULL;
+}
+
+
+/* Return sandbox address of minimal symbol NAME in OBJFILE, or 0.  */
+
+static CORE_ADDR
+nacl_lookup_ldso_symbol (struct objfile *objfile, const char *name)
+{
+  struct minimal_symbol *msym;
+
+  msym = lookup_minimal_symbol (name, NULL, objfile);
+  if (!msym)
+    return 0;
+
+  /* We need the link-time address, the objfile is relocated by both
+     sandbox base and load address.  */
+  return SYMBOL_VALUE_ADDRESS (msym)
+         - ANOFFSET (objfile->section_offsets, SYMBOL_SECTION (msym));
+}
+
+
+static void
+nacl_read_ldso_interface_from_objfile (struct ldso_interface *ldso,
+                                       struct objfile *objfile)
+{
+  ldso->solib_event_addr = nacl_lookup_ldso_symbol (objfile, "_dl_debug_state");
+  ldso->debug_struct_addr = nacl_lookup_ldso_symbol (objfile, "_r_debug");
+  ldso->argv_addr = nacl_lookup_ldso_symbol (objfile, "_dl_argv");
+}
+
 
-  /* TODO: try faster pass first: walk master so_list and find native client
-     executable's objfile, then lookup_minimal_symbol in that objfile.  */
+static void
+nacl_read_ldso_interface_from_bfd (struct ldso_interface *ldso)
+{
+  bfd* abfd;
 
   /* Slow and crappy: open native client executable's bfd and walk its dynamic
      symbol table.  */
@@ -194,16 +558,61 @@ nacl_discover_ldso_interface (struct ldso_interface *ldso)
 
       bfd_close (abfd);
     }
+}
+
+
+static int
+nacl_discover_ldso_interface (struct ldso_interface *ldso)
+{
+  struct objfile *objfile;
+
+  gdb_assert (nacl_manifest_program ());
+
+  objfile = nacl_find_program_objfile ();
+
+  /* The cached result obtained from the bfd stays good until the program
+     objfile shows up; then the objfile lookup is cheap anyway.  */
+  if (!nacl_ldso_valid_p
+      || nacl_ldso_sandbox_base != nacl_sandbox_base
+      || nacl_ldso_manifest_generation != nacl_manifest_generation ()
+      || (objfile && objfile != nacl_ldso_objfile))
+    {
+      memset (&nacl_ldso, 0, sizeof (nacl_ldso));
 
+      /* Fast pass: the program is already loaded, use its minimal symbols.
+         Otherwise fall back to reading the program file.  */
+      if (objfile)
+        nacl_read_ldso_interface_from_objfile (&nacl_ldso, objfile);
+      else
+        nacl_read_ldso_interface_from_bfd (&nacl_ldso);
+
+      nacl_ldso_valid_p = 1;
+      nacl_ldso_sandbox_base = nacl_sandbox_base;
+      nacl_ldso_manifest_generation = nacl_manifest_generation ();
+      nacl_ldso_objfile = objfile;
+    }
+
+  *ldso = nacl_ldso;
   return ldso->debug_struct_addr;
 }
 
 
+/* Return a new shared object NAME loaded at ADDR, or NULL if NAME does
+   not fit in struct so_list.  */
+
 static struct so_list *
 nacl_alloc_so (CORE_ADDR addr, const char *name)
 {
   struct so_list *so;
 
+  /* Manifest names are not limited in length, but so_list names are.
+     A truncated name would refer to some other file.  */
+  if (strlen (name) >= SO_NAME_MAX_PATH_SIZE)
+    {
+      warning (_("Native Client file name too long, ignoring: %s"), name);
+      return NULL;
+    }
+
   so = XZALLOC (struct so_list);
 
   strcpy (so->so_name, name);
@@ -229,55 +638,411 @@ nacl_find_and_alloc_so (CORE_ADDR addr, const char *original_name)
 }
 
 
+/* Layout of NaCl ld.so struct link_map.  Pointers are 32-bit sandbox
+   addresses, l_addr is 64-bit but we only need its low half.  */
+
+#define NACL_LM_ADDR_OFFSET 0
+#define NACL_LM_NAME_OFFSET 8
+#define NACL_LM_NEXT_OFFSET 16
+
+/* Number of link_map bytes we care about.  */
+
+#define NACL_LM_SIZE 20
+
+/* Layout of NaCl ld.so struct r_debug.  */
+
+#define NACL_R_MAP_OFFSET 4
+#define NACL_R_BRK_OFFSET 8
+#define NACL_R_STATE_OFFSET 16
+
+/* Number of r_debug bytes we care about.  */
+
+#define NACL_R_DEBUG_SIZE 20
+
+/* r_debug::r_state value for a list that is not being changed.  */
+
+#define NACL_RT_CONSISTENT 0
+
+/* Strings are read up to the end of this boundary at once, so that a
+   read never crosses into a page that might be unmapped.  */
+
+#define NACL_READ_STRING_CHUNK 4096
+
+
+/* Link map entry as seen during the last walk of the NaCl ld.so list.  */
+
+typedef struct nacl_lm_entry
+  {
+    /* Sandbox address of the link_map.  */
+    CORE_ADDR lm_addr;
+
+    /* Raw link_map contents.  */
+    gdb_byte raw[NACL_LM_SIZE];
+
+    /* Name as found in the inferior: l_name, or argv[0] for the main
+       executable.  */
+    char *name;
+
+    /* Nonzero if this is the main executable.  */
+    int main_p;
+
+    /* Resolved shared object, cloned into the list returned to solib.c.  */
+    struct so_list *so;
+  } nacl_lm_entry_s;
+
+DEF_VEC_O (nacl_lm_entry_s);
+
+
+/* Per-inferior NaCl ld.so list state.  */
+
+struct nacl_solib_info
+  {
+    /* Results of the last NaCl ld.so list walk.  As link_map entries only
+       get added at the end or removed, the unchanged prefix of the list is
+       reused without reading the names again.  */
+    VEC (nacl_lm_entry_s) *lm_cache;
+
+    /* Sandbox base LM_CACHE was read for.  */
+    CORE_ADDR lm_cache_sandbox_base;
+
+    /* Manifest generation the shared objects in LM_CACHE were resolved
+       with.  */
+    int lm_cache_manifest_generation;
+
+    /* Incremented each time _r_debug is seen in the middle of a change,
+       that is with r_state other than RT_CONSISTENT, and each time the
+       inferior is found stopped at the solib event breakpoint.  The list
+       can only differ from the previous consistent walk if this
+       changed.  */
+    int r_debug_generation;
+
+    /* _r_debug.r_map, _r_debug.r_brk and R_DEBUG_GENERATION as of the last
+       walk, if that walk saw a consistent list.  Otherwise
+       LM_CACHE_GENERATION is -1.  */
+    CORE_ADDR lm_cache_r_map;
+    CORE_ADDR lm_cache_r_brk;
+    int lm_cache_generation;
+
+    /* Address of the NaCl ld.so solib event breakpoint, or 0 if it has
+       not been planted for this inferior.  R_DEBUG_GENERATION only counts
+       changes while it is planted.  */
+    CORE_ADDR solib_event_addr;
+  };
+
+
+static const struct inferior_data *nacl_solib_inferior_data;
+
+
+/* Drop cached entries of INFO starting from index FROM.  */
+
+static void
+nacl_truncate_lm_cache (struct nacl_solib_info *info, int from)
+{
+  int ix;
+  nacl_lm_entry_s *entry;
+
+  for (ix = from;
+       VEC_iterate (nacl_lm_entry_s, info->lm_cache, ix, entry);
+       ix++)
+    {
+      xfree (entry->name);
+      if (entry->so)
+        {
+          xfree (entry->so->lm_info);
+          xfree (entry->so);
+        }
+    }
+
+  if (from < VEC_length (nacl_lm_entry_s, info->lm_cache))
+    VEC_truncate (nacl_lm_entry_s, info->lm_cache, from);
+}
+
+
+static void
+nacl_solib_inferior_data_cleanup (struct inferior *inf, void *arg)
+{
+  struct nacl_solib_info *info = arg;
+
+  if (info != NULL)
+    {
+      nacl_truncate_lm_cache (info, 0);
+      VEC_free (nacl_lm_entry_s, info->lm_cache);
+      xfree (info);
+    }
+}
+
+
+/* Forget the NaCl ld.so list state of inferior INF.  */
+
+static void
+nacl_invalidate_solib_info (struct inferior *inf)
+{
+  struct nacl_solib_info *info
+    = inferior_data (inf, nacl_solib_inferior_data);
+
+  nacl_solib_inferior_data_cleanup (inf, info);
+  set_inferior_data (inf, nacl_solib_inferior_data, NULL);
+}
+
+
+static struct nacl_solib_info *
+get_nacl_solib_info (struct inferior *inf)
+{
+  struct nacl_solib_info *info
+    = inferior_data (inf, nacl_solib_inferior_data);
+
+  if (info == NULL)
+    {
+      info = XZALLOC (struct nacl_solib_info);
+      info->lm_cache_generation = -1;
+      set_inferior_data (inf, nacl_solib_inferior_data, info);
+    }
+
+  return info;
+}
+
+
+/* Return nonzero if the current thread is stopped at the solib event
+   breakpoint recorded in INFO.  */
+
+static int
+nacl_stopped_at_solib_event (const struct nacl_solib_info *info)
+{
+  if (!info->solib_event_addr
+      || ptid_equal (inferior_ptid, null_ptid)
+      || !target_has_registers
+      || is_executing (inferior_ptid))
+    return 0;
+
+  return (regcache_read_pc (get_thread_arch_regcache (inferior_ptid,
+                                                      target_gdbarch))
+          == info->solib_event_addr);
+}
+
+
+/* Read a NUL-terminated string at sandbox address ADDR in as few target
+   transfers as possible.  Return xmalloc'ed result.  */
+
+static char *
+nacl_read_string (CORE_ADDR addr)
+{
+  char buf[SO_NAME_MAX_PATH_SIZE];
+  LONGEST len = 0;
+
+  while (len < sizeof (buf) - 1)
+    {
+      CORE_ADDR curr = addr + len;
+      LONGEST chunk, n;
+      char *end;
+
+      chunk = NACL_READ_STRING_CHUNK - (curr & (NACL_READ_STRING_CHUNK - 1));
+      if (chunk > sizeof (buf) - 1 - len)
+        chunk = sizeof (buf) - 1 - len;
+
+      n = target_read (&current_target, TARGET_OBJECT_MEMORY, NULL,
+                       (gdb_byte *) buf + len, curr, chunk);
+      if (n <= 0)
+        break;
+
+      end = memchr (buf + len, '\0', n);
+      if (end)
+        return xstrdup (buf);
+
+      len += n;
+    }
+
+  buf[len] = '\0';
+  return xstrdup (buf);
+}
+
+
+/* Fill in ENTRY->name and ENTRY->main_p from ENTRY->raw.  */
+
+static void
+nacl_read_lm_name (nacl_lm_entry_s *entry, const struct ldso_interface *ldso)
+{
+  CORE_ADDR l_name;
+  char *name;
+  struct cleanup *old_chain;
+
+  l_name = extract_unsigned_integer (entry->raw + NACL_LM_NAME_OFFSET, 4,
+                                     BFD_ENDIAN_LITTLE);
+  name = nacl_read_string (nacl_sandbox_base + l_name);
+  old_chain = make_cleanup (xfree, name);
+  entry->main_p = 0;
+
+  if (strcmp (name, "") == 0)
+    {
+      /* Native client dynamic executable, take its name from argv[0].  */
+      l_name = read_memory_unsigned_integer (nacl_sandbox_base + ldso->argv_addr, 4, BFD_ENDIAN_LITTLE);
+      l_name = read_memory_unsigned_integer (nacl_sandbox_base + l_name, 4, BFD_ENDIAN_LITTLE);
+
+      do_cleanups (old_chain);
+      name = nacl_read_string (nacl_sandbox_base + l_name);
+      old_chain = make_cleanup (xfree, name);
+      entry->main_p = 1;
+    }
+
+  discard_cleanups (old_chain);
+  entry->name = name;
+}
+
+
+/* Return a copy of SO.  update_solib_list takes ownership of the list
+   returned by current_sos: it frees every node that matches one already
+   in the solib list, and links the others into that list.  So the nodes
+   of LM_CACHE can not be returned themselves.  */
+
+static struct so_list *
+nacl_clone_so (const struct so_list *so)
+{
+  struct so_list *copy = XNEW (struct so_list);
+
+  *copy = *so;
+  copy->next = NULL;
+
+  copy->lm_info = XNEW (struct lm_info);
+  *copy->lm_info = *so->lm_info;
+
+  return copy;
+}
+
+
+/* Append copies of the shared objects cached in INFO to *LINK_PTR.  */
+
+static void
+nacl_append_cached_sos (struct nacl_solib_info *info,
+                        struct so_list **link_ptr)
+{
+  int ix;
+  nacl_lm_entry_s *entry;
+
+  for (ix = 0; VEC_iterate (nacl_lm_entry_s, info->lm_cache, ix, entry); ix++)
+    if (entry->so)
+      {
+        *link_ptr = nacl_clone_so (entry->so);
+        link_ptr = &(*link_ptr)->next;
+      }
+}
+
+
+static struct so_list *
+nacl_resolve_lm_entry (const nacl_lm_entry_s *entry)
+{
+  CORE_ADDR l_addr;
+
+  l_addr = extract_unsigned_integer (entry->raw + NACL_LM_ADDR_OFFSET, 4,
+                                     BFD_ENDIAN_LITTLE);
+
+  if (entry->main_p)
+    {
+      /* Native client dynamic executable. */
+      return nacl_find_and_alloc_so (nacl_sandbox_base + l_addr, entry->name);
+    }
+  else if (strcmp (entry->name, "NaClMain") == 0)
+    {
+      /* Native client ld.so. */
+      return nacl_alloc_so (nacl_sandbox_base + l_addr, nacl_manifest_program ());
+    }
+  else
+    {
+      /* Solib. */
+      return nacl_find_and_alloc_so (nacl_sandbox_base + l_addr, entry->name);
+    }
+}
+
+
 static void
 nacl_append_sos (struct so_list **link_ptr, const struct ldso_interface *ldso)
 {
+  struct nacl_solib_info *info = get_nacl_solib_info (current_inferior ());
+  gdb_byte r_debug[NACL_R_DEBUG_SIZE];
+  CORE_ADDR r_map, r_brk;
   CORE_ADDR lm_addr;
+  int r_state;
+  int ix;
 
-  /* for (lm_addr = _r_debug.r_map; lm_addr; lm_addr = lm_addr->l_next)  */
-  for (lm_addr = read_memory_unsigned_integer (nacl_sandbox_base + ldso->debug_struct_addr + 4, 4, BFD_ENDIAN_LITTLE);
-       lm_addr;
-       lm_addr = read_memory_unsigned_integer (nacl_sandbox_base + lm_addr + 16, 4, BFD_ENDIAN_LITTLE))
+  if (info->lm_cache_sandbox_base != nacl_sandbox_base
+      || info->lm_cache_manifest_generation != nacl_manifest_generation ())
     {
-      CORE_ADDR l_addr;
-      CORE_ADDR l_name;
-      char* so_name;
-      int err;
-      struct so_list *so;
+      nacl_truncate_lm_cache (info, 0);
+      info->lm_cache_sandbox_base = nacl_sandbox_base;
+      info->lm_cache_manifest_generation = nacl_manifest_generation ();
+      info->lm_cache_generation = -1;
+    }
 
-      /* link_map::l_addr.  */
-      l_addr = read_memory_unsigned_integer (nacl_sandbox_base + lm_addr, 4, BFD_ENDIAN_LITTLE);
+  read_memory (nacl_sandbox_base + ldso->debug_struct_addr, r_debug,
+               NACL_R_DEBUG_SIZE);
+  r_map = extract_unsigned_integer (r_debug + NACL_R_MAP_OFFSET, 4,
+                                    BFD_ENDIAN_LITTLE);
+  r_brk = extract_unsigned_integer (r_debug + NACL_R_BRK_OFFSET, 4,
+                                    BFD_ENDIAN_LITTLE);
+  r_state = extract_unsigned_integer (r_debug + NACL_R_STATE_OFFSET, 4,
+                                      BFD_ENDIAN_LITTLE);
+
+  /* ld.so reports both the start and the end of each change through
+     the event breakpoint.  Do not rely on having seen the start: a stop
+     at the breakpoint always means the list must be walked, whatever
+     r_state says now.  */
+  if (r_state != NACL_RT_CONSISTENT || nacl_stopped_at_solib_event (info))
+    info->r_debug_generation++;
+  else if (info->lm_cache_generation == info->r_debug_generation
+           && info->lm_cache_r_map == r_map
+           && info->lm_cache_r_brk == r_brk)
+    {
+      /* Nothing changed since the last walk.  */
+      nacl_append_cached_sos (info, link_ptr);
+      return;
+    }
+
+  /* for (lm_addr = _r_debug.r_map; lm_addr; lm_addr = lm_addr->l_next)  */
+  for (ix = 0, lm_addr = r_map; lm_addr; ix++)
+    {
+      gdb_byte raw[NACL_LM_SIZE];
+      nacl_lm_entry_s *entry;
 
-      /* link_map::l_name. */
-      l_name = read_memory_unsigned_integer (nacl_sandbox_base + lm_addr + 8, 4, BFD_ENDIAN_LITTLE);
-      target_read_string (nacl_sandbox_base + l_name, &so_name, SO_NAME_MAX_PATH_SIZE - 1, &err);
+      /* Whole link_map in one transfer.  */
+      read_memory (nacl_sandbox_base + lm_addr, raw, NACL_LM_SIZE);
 
-      if (strcmp (so_name, "") == 0)
+      entry = (ix < VEC_length (nacl_lm_entry_s, info->lm_cache)
+               ? VEC_index (nacl_lm_entry_s, info->lm_cache, ix) : NULL);
+      if (!entry
+          || entry->lm_addr != lm_addr
+          || memcmp (entry->raw, raw, NACL_LM_SIZE) != 0)
         {
-          /* Native client dynamic executable. */
-          xfree (so_name);
+          nacl_lm_entry_s new_entry;
+          struct cleanup *old_chain;
 
-          l_name = read_memory_unsigned_integer (nacl_sandbox_base + ldso->argv_addr, 4, BFD_ENDIAN_LITTLE);
-          l_name = read_memory_unsigned_integer (nacl_sandbox_base + l_name, 4, BFD_ENDIAN_LITTLE);
-          target_read_string (nacl_sandbox_base + l_name, &so_name, SO_NAME_MAX_PATH_SIZE - 1, &err);
+          /* The list differs from here on.  */
+          nacl_truncate_lm_cache (info, ix);
 
-          so = nacl_find_and_alloc_so (nacl_sandbox_base + l_addr, so_name);
-        }
-      else if (strcmp (so_name, "NaClMain") == 0)
-        {
-          /* Native client ld.so. */
-          so = nacl_alloc_so (nacl_sandbox_base + l_addr, nacl_manifest_program ());
+          new_entry.lm_addr = lm_addr;
+          memcpy (new_entry.raw, raw, NACL_LM_SIZE);
+          nacl_read_lm_name (&new_entry, ldso);
+          old_chain = make_cleanup (xfree, new_entry.name);
+          new_entry.so = nacl_resolve_lm_entry (&new_entry);
+          discard_cleanups (old_chain);
+
+          entry = VEC_safe_push (nacl_lm_entry_s, info->lm_cache,
+                                 &new_entry);
         }
-      else
+
+      if (entry->so)
         {
-          /* Solib. */
-          so = nacl_find_and_alloc_so (nacl_sandbox_base + l_addr, so_name);
+          *link_ptr = nacl_clone_so (entry->so);
+          link_ptr = &(*link_ptr)->next;
         }
-      xfree (so_name);
 
-      *link_ptr = so;
-      link_ptr = &so->next;
+      lm_addr = extract_unsigned_integer (raw + NACL_LM_NEXT_OFFSET, 4,
+                                          BFD_ENDIAN_LITTLE);
     }
+
+  nacl_truncate_lm_cache (info, ix);
+
+  info->lm_cache_r_map = r_map;
+  info->lm_cache_r_brk = r_brk;
+  info->lm_cache_generation = (r_state == NACL_RT_CONSISTENT
+                               ? info->r_debug_generation : -1);
 }
 
 
@@ -292,8 +1057,6 @@ nacl_current_sos (void)
 
   if (nacl_manifest_program ())
     {
-      CORE_ADDR prev_sandbox_base = nacl_sandbox_base;
-
       if (nacl_update_sandbox_base ())
         {
           struct ldso_interface ldso;
@@ -306,20 +1069,29 @@ nacl_current_sos (void)
           if (nacl_manifest_irt ())
             {
               *link_ptr = nacl_alloc_so (nacl_sandbox_base, nacl_manifest_irt ());
-              link_ptr = &(*link_ptr)->next;
+              if (*link_ptr)
+                link_ptr = &(*link_ptr)->next;
             }
 
           if (nacl_discover_ldso_interface (&ldso))
             {
-              /* Dynamic case - walk ld.so solib list.  */
-              nacl_append_sos (link_ptr, &ldso);
+              CORE_ADDR event_addr = nacl_sandbox_base + ldso.solib_event_addr;
+              struct nacl_solib_info *info
+                = get_nacl_solib_info (current_inferior ());
 
-              if (!prev_sandbox_base)
+              if (info->solib_event_addr != event_addr)
                 {
-                  /* This is the first time we are here with loaded NaCl.
-                     Set NaCl solib event breakpoint here.  */
-                  create_solib_event_breakpoint (target_gdbarch, nacl_sandbox_base + ldso.solib_event_addr);
+                  /* First time we are here with NaCl ld.so loaded.  Set
+                     NaCl solib event breakpoint before walking the list,
+                     so that no later change goes unnoticed.  Changes
+                     made so far were not counted.  */
+                  create_solib_event_breakpoint (target_gdbarch, event_addr);
+                  info->solib_event_addr = event_addr;
+                  info->lm_cache_generation = -1;
                 }
+
+              /* Dynamic case - walk ld.so solib list.  */
+              nacl_append_sos (link_ptr, &ldso);
             }
           else
             {
@@ -429,8 +1201,11 @@ nacl_windows_relocate_main_executable (void)
 static void
 nacl_solib_create_inferior_hook (int from_tty)
 {
+  nacl_invalidate_sandboxes (current_inferior ());
   nacl_sandbox_base = 0;
   nacl_entry_point = 0;
+  nacl_invalidate_ldso_interface ();
+  nacl_invalidate_solib_info (current_inferior ());
 
 #ifdef _WIN32
   /* GDB does not handle relocated pe executables -- fix this.  */
@@ -477,10 +1252,54 @@ nacl_solib_loaded (struct so_list *so)
          pick the highest one.  */
       if (nacl_entry_point < addr)
         nacl_entry_point = addr;
+
+      /* The program, either the static nexe or runnable-ld.so, is loaded
+         at its link-time sandbox addresses, and its code is the static
+         code of the sandbox.  */
+      if (nacl_sandbox_base
+          && nacl_manifest_program ()
+          && strcmp (so->so_original_name, nacl_manifest_program ()) == 0)
+        {
+          ULONGEST text_end = 0;
+          asection *sect;
+
+          for (sect = so->abfd->sections; sect; sect = sect->next)
+            if ((bfd_get_section_flags (so->abfd, sect) & SEC_CODE)
+                && (bfd_get_section_flags (so->abfd, sect) & SEC_ALLOC))
+              {
+                ULONGEST end = (bfd_get_section_vma (so->abfd, sect)
+                                + bfd_get_section_size (sect));
+
+                if (text_end < end)
+                  text_end = end;
+              }
+
+          nacl_set_sandbox_static_text_end (current_inferior (),
+                                            nacl_sandbox_base, text_end);
+        }
     }
 }
 
 
+static void
+nacl_solib_unloaded (struct so_list *so)
+{
+  if (so->objfile && so->objfile == nacl_ldso_objfile)
+    nacl_invalidate_ldso_interface ();
+}
+
+
+static void
+nacl_new_objfile (struct objfile *objfile)
+{
+  /* NULL means all objfiles are being discarded.  A new main objfile
+     means the program was changed with "file"; the interface read from
+     the previous program's bfd is stale.  */
+  if (!objfile || (objfile->flags & OBJF_MAINLINE))
+    nacl_invalidate_ldso_interface ();
+}
+
+
 void
 solib_add (char *pattern, int from_tty, struct target_ops *target, int readsyms)
 {
@@ -501,6 +1320,54 @@ solib_add (char *pattern, int from_tty, struct target_ops *target, int readsyms)
 }
 
 
+static void
+nacl_show_sandbox_bits (struct ui_file *file, int from_tty,
+                        struct cmd_list_element *c, const char *value)
+{
+  if (nacl_sandbox_bits)
+    fprintf_filtered (file, _("Native Client sandboxes span %s address bits.\n"),
+                      value);
+  else
+    fprintf_filtered (file, _("Native Client sandbox size is the default "
+                              "for the architecture.\n"));
+}
+
+
+static void
+nacl_set_sandbox_bits (char *args, int from_tty, struct cmd_list_element *c)
+{
+  struct inferior *inf = current_inferior ();
+  struct nacl_inferior_info *info = inferior_data (inf, nacl_inferior_data);
+  VEC (nacl_sandbox_s) *known = NULL;
+  struct cleanup *old_chain;
+  nacl_sandbox_s *sandbox;
+  int ix;
+
+  if (nacl_sandbox_bits < 0 || nacl_sandbox_bits > 63)
+    {
+      nacl_sandbox_bits = 0;
+      error (_("Invalid number of sandbox address bits."));
+    }
+
+  if (info == NULL)
+    return;
+
+  /* Register the known sandboxes again with the new size.  */
+  known = VEC_copy (nacl_sandbox_s, info->sandboxes);
+  old_chain = make_cleanup (VEC_cleanup (nacl_sandbox_s), &known);
+
+  nacl_invalidate_sandboxes (inf);
+  for (ix = 0; VEC_iterate (nacl_sandbox_s, known, ix, sandbox); ix++)
+    {
+      nacl_register_sandbox (inf, sandbox->base, nacl_default_sandbox_size ());
+      nacl_set_sandbox_static_text_end (inf, sandbox->base,
+                                        sandbox->static_text_end);
+    }
+
+  do_cleanups (old_chain);
+}
+
+
 /* Provide a prototype to silence -Wmissing-prototypes.  */
 extern initialize_file_ftype _initialize_nacl_solib;
 
@@ -508,4 +1375,25 @@ void
 _initialize_nacl_solib (void)
 {
   observer_attach_solib_loaded (nacl_solib_loaded);
+  observer_attach_solib_unloaded (nacl_solib_unloaded);
+  observer_attach_new_objfile (nacl_new_objfile);
+
+  nacl_inferior_data
+    = register_inferior_data_with_cleanup (nacl_inferior_data_cleanup);
+  observer_attach_inferior_exit (nacl_invalidate_sandboxes);
+  observer_attach_inferior_appeared (nacl_invalidate_sandboxes);
+
+  nacl_solib_inferior_data
+    = register_inferior_data_with_cleanup (nacl_solib_inferior_data_cleanup);
+  observer_attach_inferior_exit (nacl_invalidate_solib_info);
+
+  add_setshow_zinteger_cmd ("nacl-sandbox-bits", class_support,
+                            &nacl_sandbox_bits, _("\
+Set the size of Native Client sandboxes, in address bits."), _("\
+Show the size of Native Client sandboxes, in address bits."), _("\
+Addresses within 2^BITS bytes from a sandbox base are considered to be in\n\
+the sandbox.  Zero means use the default for the architecture, which is 32\n\
+for x86-64."),
+                            nacl_set_sandbox_bits, nacl_show_sandbox_bits,
+                            &setlist, &showlist);
 }
@@ -20,6 +20,29 @@
 #ifndef SOLIB_NACL_H
 #define SOLIB_NACL_H
 
+struct inferior;
+
+/* Add sandbox [BASE, BASE + SIZE) to inferior INF.  */
+extern void nacl_register_sandbox (struct inferior *inf, CORE_ADDR base,
+                                   ULONGEST size);
+
+/* Remove the sandbox starting at BASE from inferior INF.  */
+extern void nacl_unregister_sandbox (struct inferior *inf, CORE_ADDR base);
+
+/* Return the NaCl architecture for ADDR if it is in one of the sandboxes
+   of inferior INF, NULL otherwise.  */
+extern struct gdbarch *nacl_sandbox_gdbarch (struct inferior *inf,
+                                             CORE_ADDR addr);
+
+/* If ADDR is in one of the sandboxes of inferior INF, set *BASE and *SIZE
+   to its bounds, set *STATIC_TEXT_END to the sandbox-relative end of its
+   validated static code or 0 if that is not known, and return nonzero.
+   Otherwise return zero.  */
+extern int nacl_sandbox_range (struct inferior *inf, CORE_ADDR addr,
+                               CORE_ADDR *base, ULONGEST *size,
+                               ULONGEST *static_text_end);
+
+/* Return nonzero if ADDR is in one of the current inferior sandboxes.  */
 extern int nacl_sandbox_address_p (CORE_ADDR addr);
 
 extern void set_gdbarch_nacl_pointer_to_address (struct gdbarch *gdbarch);
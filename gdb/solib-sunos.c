@@ -231,6 +231,10 @@ solib_add_common_symbols (CORE_ADDR rtc_symp)
       obstack_init (&rt_common_objfile->objfile_obstack);
       rt_common_objfile->minimal_symbol_count = 0;
       rt_common_objfile->msymbols = NULL;
+      memset (&rt_common_objfile->msymbol_hash, 0,
+	      sizeof (rt_common_objfile->msymbol_hash));
+      memset (&rt_common_objfile->msymbol_demangled_hash, 0,
+	      sizeof (rt_common_objfile->msymbol_demangled_hash));
       terminate_minimal_symbol_table (rt_common_objfile);
     }
 
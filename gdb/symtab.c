@@ -79,7 +79,7 @@ static void sources_info (char *, int);
 
 static void output_source_filename (const char *, int *);
 
-static int find_line_common (struct linetable *, int, int *, int);
+static int find_line_common (struct symtab *, int, int *, int);
 
 static struct symbol *lookup_symbol_aux (const char *name,
 					 const struct block *block,
@@ -1882,6 +1882,354 @@ iterate_over_symbols (const struct block *block, const char *name,
     }
 }
 
+/* The PC to symtab map of a program space.  It indexes the range of
+   the global block of each primary symtab, so that
+   find_pc_sect_symtab only has to look at the symtabs whose range
+   contains the PC, instead of at every primary symtab.  The map is
+   rebuilt from scratch after objfiles come, go or move; symtabs that
+   are expanded in between are added to it as they are completed.  */
+
+struct pc_symtab_entry
+{
+  /* The range of the symtab's global block.  */
+  CORE_ADDR start;
+  CORE_ADDR end;
+
+  struct symtab *symtab;
+
+  /* The symtab's position among the primary symtabs of its objfile,
+     lowest first, as ALL_PRIMARY_SYMTABS visits them.  */
+  long order;
+};
+
+struct pc_symtab_map
+{
+  /* Zero if the map must be rebuilt before it is used.  */
+  int valid_p;
+
+  /* The entries, sorted by start address.  MAX_END[I] is the highest
+     end address of the entries in the implicit binary tree rooted at
+     entry I; see pc_symtab_map_build_tree.  */
+  struct pc_symtab_entry *entries;
+  CORE_ADDR *max_end;
+  int num_entries;
+  int alloc_entries;
+
+  /* Symtabs added since the entries were last sorted.  */
+  struct pc_symtab_entry *pending;
+  int num_pending;
+  int alloc_pending;
+
+  /* The ORDER to give the next added symtab.  New symtabs go at the
+     front of their objfile's list, so this counts down.  */
+  long next_order;
+};
+
+/* Per-program-space data key.  */
+static const struct program_space_data *pc_symtab_map_pspace_data;
+
+static void
+pc_symtab_map_pspace_data_cleanup (struct program_space *pspace, void *arg)
+{
+  struct pc_symtab_map *map = arg;
+
+  if (map != NULL)
+    {
+      xfree (map->entries);
+      xfree (map->max_end);
+      xfree (map->pending);
+      xfree (map);
+    }
+}
+
+/* Return the PC to symtab map of PSPACE, creating it if needed.  */
+
+static struct pc_symtab_map *
+get_pc_symtab_map (struct program_space *pspace)
+{
+  struct pc_symtab_map *map;
+
+  map = program_space_data (pspace, pc_symtab_map_pspace_data);
+  if (map == NULL)
+    {
+      map = XZALLOC (struct pc_symtab_map);
+      set_program_space_data (pspace, pc_symtab_map_pspace_data, map);
+    }
+
+  return map;
+}
+
+/* See symtab.h.  */
+
+void
+clear_pc_symtab_map (struct program_space *pspace)
+{
+  get_pc_symtab_map (pspace)->valid_p = 0;
+}
+
+/* Fill in ENTRY for the primary symtab SYMTAB.  Return zero if its
+   global block is empty and it need not be indexed.  */
+
+static int
+pc_symtab_entry_init (struct pc_symtab_entry *entry, struct symtab *symtab,
+		      long order)
+{
+  struct block *b = BLOCKVECTOR_BLOCK (BLOCKVECTOR (symtab), GLOBAL_BLOCK);
+
+  if (BLOCK_START (b) >= BLOCK_END (b))
+    return 0;
+
+  entry->start = BLOCK_START (b);
+  entry->end = BLOCK_END (b);
+  entry->symtab = symtab;
+  entry->order = order;
+  return 1;
+}
+
+/* See symtab.h.  */
+
+void
+add_symtab_to_pc_map (struct symtab *symtab)
+{
+  struct pc_symtab_map *map = get_pc_symtab_map (symtab->objfile->pspace);
+  struct pc_symtab_entry entry;
+
+  /* A rebuild will find it.  */
+  if (!map->valid_p)
+    return;
+
+  if (!pc_symtab_entry_init (&entry, symtab, map->next_order))
+    return;
+  map->next_order--;
+
+  if (map->num_pending == map->alloc_pending)
+    {
+      map->alloc_pending = map->alloc_pending ? 2 * map->alloc_pending : 16;
+      map->pending = xrealloc (map->pending,
+			       map->alloc_pending * sizeof (*map->pending));
+    }
+  map->pending[map->num_pending++] = entry;
+}
+
+static int
+compare_pc_symtab_entries (const void *a, const void *b)
+{
+  const struct pc_symtab_entry *ea = a;
+  const struct pc_symtab_entry *eb = b;
+
+  if (ea->start < eb->start)
+    return -1;
+  if (ea->start > eb->start)
+    return 1;
+  return 0;
+}
+
+/* Compute MAP->max_end for the entries from LO to HI, exclusive,
+   which form an implicit binary tree rooted at their middle entry.
+   Return the highest end address among them.  */
+
+static CORE_ADDR
+pc_symtab_map_build_tree (struct pc_symtab_map *map, int lo, int hi)
+{
+  int mid;
+  CORE_ADDR max_end, sub;
+
+  if (lo >= hi)
+    return 0;
+
+  mid = lo + (hi - lo) / 2;
+  max_end = map->entries[mid].end;
+  sub = pc_symtab_map_build_tree (map, lo, mid);
+  if (sub > max_end)
+    max_end = sub;
+  sub = pc_symtab_map_build_tree (map, mid + 1, hi);
+  if (sub > max_end)
+    max_end = sub;
+
+  map->max_end[mid] = max_end;
+  return max_end;
+}
+
+/* Make room for NUM entries in MAP.  */
+
+static void
+pc_symtab_map_reserve (struct pc_symtab_map *map, int num)
+{
+  if (num <= map->alloc_entries)
+    return;
+
+  map->alloc_entries = map->alloc_entries ? map->alloc_entries : 64;
+  while (map->alloc_entries < num)
+    map->alloc_entries *= 2;
+  map->entries = xrealloc (map->entries,
+			   map->alloc_entries * sizeof (*map->entries));
+  map->max_end = xrealloc (map->max_end,
+			   map->alloc_entries * sizeof (*map->max_end));
+}
+
+/* Bring MAP, the PC to symtab map of PSPACE, up to date.  */
+
+static void
+update_pc_symtab_map (struct program_space *pspace, struct pc_symtab_map *map)
+{
+  if (!map->valid_p)
+    {
+      struct objfile *objfile;
+      struct symtab *s;
+      long order = 0;
+
+      map->num_entries = 0;
+      map->num_pending = 0;
+
+      ALL_PSPACE_OBJFILES (pspace, objfile)
+	ALL_OBJFILE_SYMTABS (objfile, s)
+	  if (s->primary)
+	    {
+	      pc_symtab_map_reserve (map, map->num_entries + 1);
+	      if (pc_symtab_entry_init (&map->entries[map->num_entries],
+					s, order++))
+		map->num_entries++;
+	    }
+
+      qsort (map->entries, map->num_entries, sizeof (*map->entries),
+	     compare_pc_symtab_entries);
+      map->next_order = -1;
+      map->valid_p = 1;
+    }
+  else if (map->num_pending > 0)
+    {
+      int i, j, k;
+
+      /* Merge the sorted pending entries in from the back.  */
+      qsort (map->pending, map->num_pending, sizeof (*map->pending),
+	     compare_pc_symtab_entries);
+      pc_symtab_map_reserve (map, map->num_entries + map->num_pending);
+
+      i = map->num_entries - 1;
+      j = map->num_pending - 1;
+      k = map->num_entries + map->num_pending - 1;
+      while (j >= 0)
+	{
+	  if (i >= 0 && map->entries[i].start > map->pending[j].start)
+	    map->entries[k--] = map->entries[i--];
+	  else
+	    map->entries[k--] = map->pending[j--];
+	}
+
+      map->num_entries += map->num_pending;
+      map->num_pending = 0;
+    }
+  else
+    return;
+
+  pc_symtab_map_build_tree (map, 0, map->num_entries);
+}
+
+/* A primary symtab whose global block contains the PC being looked
+   up, with the position of its objfile in the program space.  */
+
+struct pc_symtab_candidate
+{
+  struct pc_symtab_entry entry;
+  int objfile_index;
+};
+
+/* Append to *CANDS (of which there are *NUM, with room for *ALLOC)
+   the entries of MAP from LO to HI, exclusive, whose range contains
+   PC.  */
+
+static void
+pc_symtab_map_stab (struct pc_symtab_map *map, int lo, int hi, CORE_ADDR pc,
+		    struct pc_symtab_candidate **cands, int *num, int *alloc)
+{
+  while (lo < hi)
+    {
+      int mid = lo + (hi - lo) / 2;
+      struct pc_symtab_entry *entry = &map->entries[mid];
+
+      if (map->max_end[mid] <= pc)
+	return;
+
+      pc_symtab_map_stab (map, lo, mid, pc, cands, num, alloc);
+
+      /* Everything to the right starts even later.  */
+      if (entry->start > pc)
+	return;
+
+      if (entry->end > pc)
+	{
+	  if (*num == *alloc)
+	    {
+	      *alloc = *alloc ? 2 * *alloc : 8;
+	      *cands = xrealloc (*cands, *alloc * sizeof (**cands));
+	    }
+	  (*cands)[*num].entry = *entry;
+	  (*cands)[*num].objfile_index = 0;
+	  (*num)++;
+	}
+
+      lo = mid + 1;
+    }
+}
+
+/* Sort candidates into the order ALL_PRIMARY_SYMTABS visits them.  */
+
+static int
+compare_pc_symtab_candidates (const void *a, const void *b)
+{
+  const struct pc_symtab_candidate *ca = a;
+  const struct pc_symtab_candidate *cb = b;
+
+  if (ca->objfile_index != cb->objfile_index)
+    return ca->objfile_index < cb->objfile_index ? -1 : 1;
+  if (ca->entry.order != cb->entry.order)
+    return ca->entry.order < cb->entry.order ? -1 : 1;
+  return 0;
+}
+
+/* Find the primary symtabs of the current program space whose global
+   block contains PC.  Return them in an xmalloc'd array, in the
+   order ALL_PRIMARY_SYMTABS would visit them, and store their number
+   in *NUM.  */
+
+static struct pc_symtab_candidate *
+find_pc_symtab_candidates (CORE_ADDR pc, int *num)
+{
+  struct pc_symtab_map *map = get_pc_symtab_map (current_program_space);
+  struct pc_symtab_candidate *cands = NULL;
+  int alloc = 0;
+  int i;
+
+  update_pc_symtab_map (current_program_space, map);
+
+  *num = 0;
+  pc_symtab_map_stab (map, 0, map->num_entries, pc, &cands, num, &alloc);
+
+  /* Symtabs of different objfiles rarely overlap; only look up where
+     the objfiles are in the list when they do.  */
+  for (i = 1; i < *num; i++)
+    if (cands[i].entry.symtab->objfile != cands[0].entry.symtab->objfile)
+      break;
+  if (i < *num)
+    {
+      struct objfile *objfile;
+      int index = 0;
+
+      ALL_OBJFILES (objfile)
+	{
+	  for (i = 0; i < *num; i++)
+	    if (cands[i].entry.symtab->objfile == objfile)
+	      cands[i].objfile_index = index;
+	  index++;
+	}
+    }
+
+  if (*num > 1)
+    qsort (cands, *num, sizeof (*cands), compare_pc_symtab_candidates);
+
+  return cands;
+}
+
 /* Find the symtab associated with PC and SECTION.  Look through the
    psymtabs and read in another symtab if necessary.  */
 
@@ -1893,11 +2241,11 @@ find_pc_sect_symtab (CORE_ADDR pc, struct obj_section *section)
   struct symtab *s = NULL;
   struct symtab *best_s = NULL;
   struct objfile *objfile;
-  struct program_space *pspace;
   CORE_ADDR distance = 0;
   struct minimal_symbol *msymbol;
-
-  pspace = current_program_space;
+  struct pc_symtab_candidate *cands;
+  struct cleanup *old_chain;
+  int i, num_cands;
 
   /* If we know that this is not a text address, return failure.  This is
      necessary because we loop based on the block's high and low code
@@ -1926,55 +2274,68 @@ find_pc_sect_symtab (CORE_ADDR pc, struct obj_section *section)
      like xcoff does (I'm not sure).
 
      It also happens for objfiles that have their functions reordered.
-     For these, the symtab we are looking for is not necessarily read in.  */
+     For these, the symtab we are looking for is not necessarily read in.
 
-  ALL_PRIMARY_SYMTABS (objfile, s)
-  {
-    bv = BLOCKVECTOR (s);
-    b = BLOCKVECTOR_BLOCK (bv, GLOBAL_BLOCK);
+     Only the symtabs whose global block contains PC can match, so
+     just visit those, in the order ALL_PRIMARY_SYMTABS would.  */
 
-    if (BLOCK_START (b) <= pc
-	&& BLOCK_END (b) > pc
-	&& (distance == 0
-	    || BLOCK_END (b) - BLOCK_START (b) < distance))
-      {
-	/* For an objfile that has its functions reordered,
-	   find_pc_psymtab will find the proper partial symbol table
-	   and we simply return its corresponding symtab.  */
-	/* In order to better support objfiles that contain both
-	   stabs and coff debugging info, we continue on if a psymtab
-	   can't be found.  */
-	if ((objfile->flags & OBJF_REORDERED) && objfile->sf)
-	  {
-	    struct symtab *result;
-
-	    result
-	      = objfile->sf->qf->find_pc_sect_symtab (objfile,
-						      msymbol,
-						      pc, section,
-						      0);
-	    if (result)
-	      return result;
-	  }
-	if (section != 0)
-	  {
-	    struct dict_iterator iter;
-	    struct symbol *sym = NULL;
+  cands = find_pc_symtab_candidates (pc, &num_cands);
+  old_chain = make_cleanup (xfree, cands);
 
-	    ALL_BLOCK_SYMBOLS (b, iter, sym)
-	      {
-		fixup_symbol_section (sym, objfile);
-		if (matching_obj_sections (SYMBOL_OBJ_SECTION (sym), section))
-		  break;
-	      }
-	    if (sym == NULL)
-	      continue;		/* No symbol in this symtab matches
+  for (i = 0; i < num_cands; i++)
+    {
+      s = cands[i].entry.symtab;
+      objfile = s->objfile;
+      bv = BLOCKVECTOR (s);
+      b = BLOCKVECTOR_BLOCK (bv, GLOBAL_BLOCK);
+
+      if (BLOCK_START (b) <= pc
+	  && BLOCK_END (b) > pc
+	  && (distance == 0
+	      || BLOCK_END (b) - BLOCK_START (b) < distance))
+	{
+	  /* For an objfile that has its functions reordered,
+	     find_pc_psymtab will find the proper partial symbol table
+	     and we simply return its corresponding symtab.  */
+	  /* In order to better support objfiles that contain both
+	     stabs and coff debugging info, we continue on if a psymtab
+	     can't be found.  */
+	  if ((objfile->flags & OBJF_REORDERED) && objfile->sf)
+	    {
+	      struct symtab *result;
+
+	      result
+		= objfile->sf->qf->find_pc_sect_symtab (objfile,
+							msymbol,
+							pc, section,
+							0);
+	      if (result)
+		{
+		  do_cleanups (old_chain);
+		  return result;
+		}
+	    }
+	  if (section != 0)
+	    {
+	      struct dict_iterator iter;
+	      struct symbol *sym = NULL;
+
+	      ALL_BLOCK_SYMBOLS (b, iter, sym)
+		{
+		  fixup_symbol_section (sym, objfile);
+		  if (matching_obj_sections (SYMBOL_OBJ_SECTION (sym), section))
+		    break;
+		}
+	      if (sym == NULL)
+		continue;	/* No symbol in this symtab matches
 				   section.  */
-	  }
-	distance = BLOCK_END (b) - BLOCK_START (b);
-	best_s = s;
-      }
-  }
+	    }
+	  distance = BLOCK_END (b) - BLOCK_START (b);
+	  best_s = s;
+	}
+    }
+
+  do_cleanups (old_chain);
 
   if (best_s != NULL)
     return (best_s);
@@ -2004,6 +2365,159 @@ find_pc_symtab (CORE_ADDR pc)
 {
   return find_pc_sect_symtab (pc, find_pc_mapped_section (pc));
 }
+
+/* Number of find_pc_sect_line results remembered per primary symtab.
+   Stepping, frame printing and breakpoint checks ask about the same
+   few PCs over and over, so a handful is plenty.  */
+
+#define PC_LINE_CACHE_SIZE 4
+
+/* A find_pc_sect_line result, minus the fields that do not depend on
+   the line tables.  */
+
+struct pc_line_cache_entry
+{
+  /* The PC looked up, after the NOTCURRENT adjustment.  */
+  CORE_ADDR pc;
+
+  struct symtab *symtab;
+  int line;
+  CORE_ADDR start;
+  CORE_ADDR end;
+};
+
+/* The lookup accelerators hung off a symtab's LINE_CACHE field.  They
+   live on the objfile obstack, like the symtab itself.  */
+
+struct symtab_line_cache
+{
+  /* Indices of the line table entries, sorted by line number and then
+     by index.  NULL until the first lookup by line number.  */
+  int *by_line;
+
+  /* Recent find_pc_sect_line results for PCs in this (primary) symtab,
+     most recently used first.  */
+  int num_pcs;
+  struct pc_line_cache_entry pcs[PC_LINE_CACHE_SIZE];
+};
+
+/* Return SYMTAB's line cache, allocating it if needed.  */
+
+static struct symtab_line_cache *
+get_symtab_line_cache (struct symtab *symtab)
+{
+  if (symtab->line_cache == NULL)
+    symtab->line_cache
+      = OBSTACK_ZALLOC (&symtab->objfile->objfile_obstack,
+			struct symtab_line_cache);
+  return symtab->line_cache;
+}
+
+/* See symtab.h.  */
+
+void
+clear_symtab_pc_line_cache (struct symtab *symtab)
+{
+  if (symtab->line_cache != NULL)
+    symtab->line_cache->num_pcs = 0;
+}
+
+/* Look PC up in the recent find_pc_sect_line results of the primary
+   symtab SYMTAB.  Return the entry, moved to the front, or NULL.  */
+
+static struct pc_line_cache_entry *
+lookup_pc_line_cache (struct symtab *symtab, CORE_ADDR pc)
+{
+  struct symtab_line_cache *cache = symtab->line_cache;
+  struct pc_line_cache_entry found;
+  int i;
+
+  if (cache == NULL)
+    return NULL;
+
+  for (i = 0; i < cache->num_pcs; i++)
+    if (cache->pcs[i].pc == pc)
+      break;
+  if (i == cache->num_pcs)
+    return NULL;
+
+  found = cache->pcs[i];
+  memmove (&cache->pcs[1], &cache->pcs[0], i * sizeof (cache->pcs[0]));
+  cache->pcs[0] = found;
+  return &cache->pcs[0];
+}
+
+/* Remember VAL as the find_pc_sect_line result for PC in the primary
+   symtab SYMTAB, evicting the least recently used entry if needed.  */
+
+static void
+add_pc_line_cache (struct symtab *symtab, CORE_ADDR pc,
+		   const struct symtab_and_line *val)
+{
+  struct symtab_line_cache *cache = get_symtab_line_cache (symtab);
+  int n = cache->num_pcs;
+
+  if (n == PC_LINE_CACHE_SIZE)
+    n--;
+  memmove (&cache->pcs[1], &cache->pcs[0], n * sizeof (cache->pcs[0]));
+  cache->num_pcs = n + 1;
+
+  cache->pcs[0].pc = pc;
+  cache->pcs[0].symtab = val->symtab;
+  cache->pcs[0].line = val->line;
+  cache->pcs[0].start = val->pc;
+  cache->pcs[0].end = val->end;
+}
+
+/* The line table whose indices compare_line_index is sorting.  */
+
+static struct linetable *line_index_table;
+
+/* qsort comparison function for indices into LINE_INDEX_TABLE.  */
+
+static int
+compare_line_index (const void *ap, const void *bp)
+{
+  int a = *(const int *) ap;
+  int b = *(const int *) bp;
+  int line_a = line_index_table->item[a].line;
+  int line_b = line_index_table->item[b].line;
+
+  if (line_a != line_b)
+    return line_a < line_b ? -1 : 1;
+  return a - b;
+}
+
+/* Return the indices of SYMTAB's line table entries sorted by line
+   number and then by index, building the array on first use.
+   SYMTAB must have a non-empty line table.  */
+
+static int *
+symtab_line_index (struct symtab *symtab)
+{
+  struct symtab_line_cache *cache = get_symtab_line_cache (symtab);
+  struct linetable *l = LINETABLE (symtab);
+
+  if (cache->by_line == NULL)
+    {
+      int *by_line;
+      int i;
+
+      by_line = obstack_alloc (&symtab->objfile->objfile_obstack,
+			       l->nitems * sizeof (int));
+      for (i = 0; i < l->nitems; i++)
+	by_line[i] = i;
+
+      line_index_table = l;
+      qsort (by_line, l->nitems, sizeof (int), compare_line_index);
+      line_index_table = NULL;
+
+      cache->by_line = by_line;
+    }
+
+  return cache->by_line;
+}
+
 
 
 /* Find the source file and line number for a given PC value and SECTION.
@@ -2021,7 +2535,10 @@ find_pc_symtab (CORE_ADDR pc)
    find the one whose first PC is closer than that of the next line in this
    symtab.  */
 
-/* If it's worth the effort, we could be using a binary search.  */
+/* Line tables are sorted by address when their symtab is finished (see
+   sort_linetable), so each one is binary-searched.  The results are
+   also cached per primary symtab, as the same PCs tend to be looked up
+   several times each time the inferior stops.  */
 
 struct symtab_and_line
 find_pc_sect_line (CORE_ADDR pc, struct obj_section *section, int notcurrent)
@@ -2036,6 +2553,9 @@ find_pc_sect_line (CORE_ADDR pc, struct obj_section *section, int notcurrent)
   struct minimal_symbol *msymbol;
   struct minimal_symbol *mfunsym;
   struct objfile *objfile;
+  struct symtab *primary;
+  struct pc_line_cache_entry *cached;
+  int lo, hi;
 
   /* Info on best line seen so far, and where it starts, and its file.  */
 
@@ -2162,6 +2682,18 @@ find_pc_sect_line (CORE_ADDR pc, struct obj_section *section, int notcurrent)
       return val;
     }
 
+  cached = lookup_pc_line_cache (s, pc);
+  if (cached != NULL)
+    {
+      val.symtab = cached->symtab;
+      val.line = cached->line;
+      val.pc = cached->start;
+      val.end = cached->end;
+      val.section = section;
+      return val;
+    }
+  primary = s;
+
   bv = BLOCKVECTOR (s);
   objfile = s->objfile;
 
@@ -2199,15 +2731,24 @@ find_pc_sect_line (CORE_ADDR pc, struct obj_section *section, int notcurrent)
 	  alt_symtab = s;
 	}
 
-      for (i = 0; i < len; i++, item++)
+      /* Find the first line that starts after PC, leaving prev pointing
+	 to the linetable entry for the last line that started at or
+	 before PC.  */
+      lo = 0;
+      hi = len;
+      while (lo < hi)
 	{
-	  /* Leave prev pointing to the linetable entry for the last line
-	     that started at or before PC.  */
-	  if (item->pc > pc)
-	    break;
+	  int mid = lo + (hi - lo) / 2;
 
-	  prev = item;
+	  if (l->item[mid].pc > pc)
+	    hi = mid;
+	  else
+	    lo = mid + 1;
 	}
+      i = lo;
+      item = l->item + i;
+      if (i > 0)
+	prev = item - 1;
 
       /* At this point, prev points at the line whose start addr is <= pc, and
          item points at the next line.  If we ran off the end of the linetable
@@ -2264,6 +2805,7 @@ find_pc_sect_line (CORE_ADDR pc, struct obj_section *section, int notcurrent)
       else
 	val.end = BLOCK_END (BLOCKVECTOR_BLOCK (bv, GLOBAL_BLOCK));
     }
+  add_pc_line_cache (primary, pc, &val);
   val.section = section;
   return val;
 }
@@ -2307,7 +2849,7 @@ find_line_symtab (struct symtab *symtab, int line,
   /* First try looking it up in the given symtab.  */
   best_linetable = LINETABLE (symtab);
   best_symtab = symtab;
-  best_index = find_line_common (best_linetable, line, &exact, 0);
+  best_index = find_line_common (symtab, line, &exact, 0);
   if (best_index < 0 || !exact)
     {
       /* Didn't find an exact match.  So we better keep looking for
@@ -2352,7 +2894,7 @@ find_line_symtab (struct symtab *symtab, int line,
 	    && FILENAME_CMP (symtab->fullname, s->fullname) != 0)
 	  continue;	
 	l = LINETABLE (s);
-	ind = find_line_common (l, line, &exact, 0);
+	ind = find_line_common (s, line, &exact, 0);
 	if (ind >= 0)
 	  {
 	    if (exact)
@@ -2402,7 +2944,7 @@ find_pcs_for_symtab_line (struct symtab *symtab, int line,
       int was_exact;
       int idx;
 
-      idx = find_line_common (LINETABLE (symtab), line, &was_exact, start);
+      idx = find_line_common (symtab, line, &was_exact, start);
       if (idx < 0)
 	break;
 
@@ -2488,7 +3030,7 @@ find_line_pc_range (struct symtab_and_line sal, CORE_ADDR *startptr,
   return 1;
 }
 
-/* Given a line table and a line number, return the index into the line
+/* Given a symtab and a line number, return the index into its line
    table for the pc of the nearest line whose number is >= the specified one.
    Return -1 if none is found.  The value is >= 0 if it is an index.
    START is the index at which to start searching the line table.
@@ -2496,47 +3038,81 @@ find_line_pc_range (struct symtab_and_line sal, CORE_ADDR *startptr,
    Set *EXACT_MATCH nonzero if the value returned is an exact match.  */
 
 static int
-find_line_common (struct linetable *l, int lineno,
+find_line_common (struct symtab *symtab, int lineno,
 		  int *exact_match, int start)
 {
-  int i;
+  struct linetable *l = LINETABLE (symtab);
+  int *by_line;
+  int lo, hi;
+  int i, group_end;
   int len;
 
-  /* BEST is the smallest linenumber > LINENO so far seen,
-     or 0 if none has been seen so far.
-     BEST_INDEX identifies the item for it.  */
-
-  int best_index = -1;
-  int best = 0;
-
   *exact_match = 0;
 
   if (lineno <= 0)
     return -1;
-  if (l == 0)
+  if (l == 0 || l->nitems <= 0)
     return -1;
 
   len = l->nitems;
-  for (i = start; i < len; i++)
+  by_line = symtab_line_index (symtab);
+
+  /* Find the first entry whose line is >= LINENO.  */
+  lo = 0;
+  hi = len;
+  while (lo < hi)
     {
-      struct linetable_entry *item = &(l->item[i]);
+      int mid = lo + (hi - lo) / 2;
+
+      if (l->item[by_line[mid]].line < lineno)
+	lo = mid + 1;
+      else
+	hi = mid;
+    }
+
+  /* Entries with the same line are ordered by index.  Look at each line
+     from LINENO upwards for its first (lowest address) entry at or
+     after START; the first line having one is either an exact match
+     or the smallest line number > LINENO.  */
+  for (i = lo; i < len; i = group_end)
+    {
+      int line = l->item[by_line[i]].line;
 
-      if (item->line == lineno)
+      /* Find where this line's entries end.  */
+      lo = i;
+      hi = len;
+      while (lo < hi)
 	{
-	  /* Return the first (lowest address) entry which matches.  */
-	  *exact_match = 1;
-	  return i;
+	  int mid = lo + (hi - lo) / 2;
+
+	  if (l->item[by_line[mid]].line <= line)
+	    lo = mid + 1;
+	  else
+	    hi = mid;
+	}
+      group_end = lo;
+
+      /* Find the first of them at or after START.  */
+      lo = i;
+      hi = group_end;
+      while (lo < hi)
+	{
+	  int mid = lo + (hi - lo) / 2;
+
+	  if (by_line[mid] < start)
+	    lo = mid + 1;
+	  else
+	    hi = mid;
 	}
 
-      if (item->line > lineno && (best == 0 || item->line < best))
+      if (lo < group_end)
 	{
-	  best = item->line;
-	  best_index = i;
+	  *exact_match = (line == lineno);
+	  return by_line[lo];
 	}
     }
 
-  /* If we got here, we didn't get an exact match.  */
-  return best_index;
+  return -1;
 }
 
 int
@@ -4860,4 +5436,8 @@ one base name, and gdb will do file name comparisons more efficiently."),
 			   &setlist, &showlist);
 
   observer_attach_executable_changed (symtab_observer_executable_changed);
+
+  pc_symtab_map_pspace_data
+    = register_program_space_data_with_cleanup
+	(pc_symtab_map_pspace_data_cleanup);
 }
@@ -355,16 +355,6 @@ struct minimal_symbol
   /* Two flag bits provided for the use of the target.  */
   unsigned int target_flag_1 : 1;
   unsigned int target_flag_2 : 1;
-
-  /* Minimal symbols with the same hash key are kept on a linked
-     list.  This is the link.  */
-
-  struct minimal_symbol *hash_next;
-
-  /* Minimal symbols are stored in two different hash tables.  This is
-     the `next' pointer for the demangled hash table.  */
-
-  struct minimal_symbol *demangled_hash_next;
 };
 
 #define MSYMBOL_TARGET_FLAG_1(msymbol)  (msymbol)->target_flag_1
@@ -844,6 +834,11 @@ struct symtab
   /* struct call_site entries for this compilation unit or NULL.  */
 
   htab_t call_site_htab;
+
+  /* Lookup accelerators for the line table, allocated on demand by
+     symtab.c.  NULL if nothing has been looked up yet.  */
+
+  struct symtab_line_cache *line_cache;
 };
 
 #define BLOCKVECTOR(symtab)	(symtab)->blockvector
@@ -989,6 +984,21 @@ extern struct symtab *find_pc_symtab (CORE_ADDR);
 
 extern struct symtab *find_pc_sect_symtab (CORE_ADDR, struct obj_section *);
 
+/* Tell the PC to symtab map used by find_pc_sect_symtab about the
+   newly completed primary symtab SYMTAB.  */
+
+extern void add_symtab_to_pc_map (struct symtab *symtab);
+
+/* Make the PC to symtab map of PSPACE be rebuilt before its next use,
+   after objfiles were added, removed or relocated.  */
+
+extern void clear_pc_symtab_map (struct program_space *pspace);
+
+/* Forget the find_pc_sect_line results cached for SYMTAB, after the
+   addresses in its line table changed.  */
+
+extern void clear_symtab_pc_line_cache (struct symtab *symtab);
+
 extern int find_pc_line_pc_range (CORE_ADDR, CORE_ADDR *, CORE_ADDR *);
 
 extern void reread_symbols (void);
@@ -1037,10 +1047,6 @@ extern unsigned int msymbol_hash (const char *);
 
 extern struct objfile * msymbol_objfile (struct minimal_symbol *sym);
 
-extern void
-add_minsym_to_hash_table (struct minimal_symbol *sym,
-			  struct minimal_symbol **table);
-
 extern struct minimal_symbol *lookup_minimal_symbol (const char *,
 						     const char *,
 						     struct objfile *);
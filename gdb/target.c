@@ -243,14 +243,42 @@ show_stack_cache_enabled_p (struct ui_file *file, int from_tty,
   fprintf_filtered (file, _("Cache use for stack accesses is %s.\n"), value);
 }
 
+/* Likewise for the "data-cache" option, which caches memory outside of
+   any defined memory region while the program is stopped.  */
+static int data_cache_enabled_p_1 = 0;
+static int data_cache_enabled_p = 0;
+
+static void
+set_data_cache_enabled_p (char *args, int from_tty,
+			  struct cmd_list_element *c)
+{
+  if (data_cache_enabled_p != data_cache_enabled_p_1)
+    target_dcache_invalidate ();
+
+  data_cache_enabled_p = data_cache_enabled_p_1;
+}
+
+static void
+show_data_cache_enabled_p (struct ui_file *file, int from_tty,
+			   struct cmd_list_element *c, const char *value)
+{
+  fprintf_filtered (file, _("Cache use for memory accesses "
+			    "while stopped is %s.\n"), value);
+}
+
+/* See target.h.  */
+unsigned int target_stop_generation;
+
 /* Cache of memory operations, to speed up remote access.  */
 static DCACHE *target_dcache;
 
-/* Invalidate the target dcache.  */
+/* Invalidate the target dcache, first writing out any data deferred
+   by "set dcache write-back".  */
 
 void
 target_dcache_invalidate (void)
 {
+  dcache_flush (target_dcache);
   dcache_invalidate (target_dcache);
 }
 
@@ -671,6 +699,7 @@ update_current_target (void)
       INHERIT (to_supports_multi_process, t);
       INHERIT (to_supports_enable_disable_tracepoint, t);
       INHERIT (to_supports_string_tracing, t);
+      INHERIT (to_supports_evaluation_of_breakpoint_conditions, t);
       INHERIT (to_trace_init, t);
       INHERIT (to_download_tracepoint, t);
       INHERIT (to_can_download_tracepoint, t);
@@ -846,6 +875,9 @@ update_current_target (void)
   de_fault (to_supports_string_tracing,
 	    (int (*) (void))
 	    return_zero);
+  de_fault (to_supports_evaluation_of_breakpoint_conditions,
+	    (int (*) (void))
+	    return_zero);
   de_fault (to_trace_init,
 	    (void (*) (void))
 	    tcomplain);
@@ -1530,7 +1562,12 @@ memory_xfer_partial_1 (struct target_ops *ops, enum target_object object,
 	 the collected memory range fails.  */
       && get_traceframe_number () == -1
       && (region->attrib.cache
-	  || (stack_cache_enabled_p && object == TARGET_OBJECT_STACK_MEMORY)))
+	  || (stack_cache_enabled_p && object == TARGET_OBJECT_STACK_MEMORY)
+	  /* Nothing can change memory behind our back while every
+	     thread is stopped.  Regions defined by the user or the
+	     target keep their own cache attribute.  */
+	  || (data_cache_enabled_p && !mem_region_defined_p (region)
+	      && target_has_execution && !any_running ())))
     {
       if (readbuf != NULL)
 	res = dcache_xfer_memory (ops, target_dcache, memaddr, readbuf,
@@ -1558,6 +1595,11 @@ memory_xfer_partial_1 (struct target_ops *ops, enum target_object object,
      delegate other bits to the target below it.  So, we must
      manually try all targets.  */
 
+  /* Data for this range deferred in the cache must reach the target
+     first.  */
+  if (inf != NULL)
+    dcache_flush_range (target_dcache, memaddr, reg_len);
+
   do
     {
       res = ops->to_xfer_partial (ops, TARGET_OBJECT_MEMORY, NULL,
@@ -1680,10 +1722,19 @@ target_xfer_partial (struct target_ops *ops,
       /* If this is a raw memory transfer, request the normal
 	 memory object from other layers.  */
       if (raw_object == TARGET_OBJECT_RAW_MEMORY)
-	raw_object = TARGET_OBJECT_MEMORY;
+	{
+	  raw_object = TARGET_OBJECT_MEMORY;
+	  dcache_flush_range (target_dcache, offset, len);
+	}
 
       retval = ops->to_xfer_partial (ops, raw_object, annex, readbuf,
 				     writebuf, offset, len);
+
+      /* Raw writes (e.g. inserting breakpoints) bypass the cache; keep
+	 any cached copy of the memory up to date.  */
+      if (object == TARGET_OBJECT_RAW_MEMORY
+	  && writebuf != NULL && retval > 0)
+	dcache_update (target_dcache, offset, (void *) writebuf, retval);
     }
 
   if (targetdebug)
@@ -2550,6 +2601,8 @@ target_detach (char *args, int from_tty)
        them before detaching.  */
     remove_breakpoints_pid (PIDGET (inferior_ptid));
 
+  target_dcache_invalidate ();
+
   prepare_for_detach ();
 
   for (t = current_target.beneath; t != NULL; t = t->beneath)
@@ -2577,6 +2630,8 @@ target_disconnect (char *args, int from_tty)
      disconnecting.  */
   remove_breakpoints ();
 
+  target_dcache_invalidate ();
+
   for (t = current_target.beneath; t != NULL; t = t->beneath)
     if (t->to_disconnect != NULL)
 	{
@@ -2601,6 +2656,12 @@ target_wait (ptid_t ptid, struct target_waitstatus *status, int options)
 	{
 	  ptid_t retval = (*t->to_wait) (t, ptid, status, options);
 
+	  /* Whatever ran may have changed memory.  A TARGET_WNOHANG
+	     poll that found nothing is not a stop.  */
+	  if (status->kind != TARGET_WAITKIND_IGNORE
+	      && status->kind != TARGET_WAITKIND_NO_RESUMED)
+	    target_stop_generation++;
+
 	  if (targetdebug)
 	    {
 	      char *status_string;
@@ -2654,6 +2715,7 @@ target_resume (ptid_t ptid, int step, enum target_signal signal)
   struct target_ops *t;
 
   target_dcache_invalidate ();
+  target_stop_generation++;
 
   for (t = current_target.beneath; t != NULL; t = t->beneath)
     {
@@ -4400,6 +4462,21 @@ By default, caching for stack access is on."),
 			   show_stack_cache_enabled_p,
 			   &setlist, &showlist);
 
+  add_setshow_boolean_cmd ("data-cache", class_support,
+			   &data_cache_enabled_p_1, _("\
+Set cache use for all memory access while the program is stopped."), _("\
+Show cache use for all memory access while the program is stopped."), _("\
+When on, use the data cache for access to memory outside of any defined\n\
+memory region while every thread of the program is stopped.  Regions\n\
+defined with \"mem\" or by the target's memory map keep their own cache\n\
+attribute.  Cached data is discarded whenever the program runs.  Misses\n\
+that walk sequentially through memory read ahead, see\n\
+\"set dcache read-ahead\".\n\
+By default, caching for memory access while stopped is off."),
+			   set_data_cache_enabled_p,
+			   show_data_cache_enabled_p,
+			   &setlist, &showlist);
+
   add_setshow_boolean_cmd ("may-write-registers", class_support,
 			   &may_write_registers_1, _("\
 Set permission to write into registers."), _("\
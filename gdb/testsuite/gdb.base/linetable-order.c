@@ -0,0 +1,37 @@
+/* This testcase is part of GDB, the GNU debugger.
+
+   Copyright 2012 Free Software Foundation, Inc.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+/* The linker places .text.startup before .text, but the compiler emits
+   the line number program for main after that of in_text, so the line
+   table of this file is not in address order.  */
+
+static volatile int counter;
+
+void
+in_text (void)
+{
+  counter++;	/* in_text line */
+}
+
+int __attribute__ ((section (".text.startup")))
+main (void)
+{
+  in_text ();	/* main line */
+
+  /* No code for this line.  */
+  return 0;	/* return line */
+}
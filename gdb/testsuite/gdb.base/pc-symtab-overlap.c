@@ -0,0 +1,41 @@
+/* This testcase is part of GDB, the GNU debugger.
+
+   Copyright 2012 Free Software Foundation, Inc.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+/* The linker places .text.startup before .text.  So the functions of
+   this file and of pc-symtab-overlap2.c are interleaved, and the
+   address ranges of the two compilation units overlap: main and
+   inner_startup come first, then outer_text and inner_text.  */
+
+extern void inner_startup (void);
+extern void inner_text (void);
+
+static volatile int counter;
+
+void
+outer_text (void)
+{
+  counter++;	/* outer_text line */
+}
+
+int __attribute__ ((section (".text.startup")))
+main (void)
+{
+  outer_text ();
+  inner_startup ();	/* main line */
+  inner_text ();
+  return 0;
+}
@@ -0,0 +1,37 @@
+/* This testcase is part of GDB, the GNU debugger.
+
+   Copyright 2012 Free Software Foundation, Inc.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+typedef int worker_typedef_1;
+
+enum worker_enum_1 { worker_enumerator_1, worker_enumerator_2 };
+
+extern int worker_func_2 (int);
+
+worker_typedef_1 worker_var_1 = 1;
+enum worker_enum_1 worker_enum_var_1 = worker_enumerator_2;
+
+int
+worker_func_1 (int i)
+{
+  return i + worker_var_1;
+}
+
+int
+main (void)
+{
+  return worker_func_1 (0) + worker_func_2 (0) + worker_enum_var_1;
+}
@@ -0,0 +1,182 @@
+/* This testcase is part of GDB, the GNU debugger.
+
+   Copyright 2012 Free Software Foundation, Inc.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+/* This program generates a trace file with several traceframes of
+   two tracepoints, whose memory blocks overlap and split variables.  */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+char spbuf[200];
+
+char trbuf[4000];
+char *trptr;
+char *tfsizeptr;
+
+unsigned char membuf[16];
+
+void
+tp_a (void)
+{
+}
+
+void
+tp_b (void)
+{
+}
+
+/* Fill MEMBUF with BASE, BASE + 1, ...  */
+
+void
+fill_membuf (int base)
+{
+  int i;
+
+  for (i = 0; i < sizeof (membuf); i++)
+    membuf[i] = base + i;
+}
+
+void
+add_memory_block (unsigned char *addr, int size)
+{
+  short short_x;
+  unsigned long long ll_x;
+
+  *((char *) trptr) = 'M';
+  trptr += 1;
+  ll_x = (unsigned long) addr;
+  memcpy (trptr, &ll_x, sizeof (unsigned long long));
+  trptr += sizeof (unsigned long long);
+  short_x = size;
+  memcpy (trptr, &short_x, 2);
+  trptr += 2;
+  memcpy (trptr, addr, size);
+  trptr += size;
+}
+
+/* Start a traceframe of tracepoint TPNUM.  */
+
+void
+start_frame (short tpnum)
+{
+  memcpy (trptr, &tpnum, 2);
+  trptr += 2;
+  tfsizeptr = trptr;
+  trptr += 4;
+}
+
+/* Patch in the size of the current traceframe.  */
+
+void
+finish_frame (void)
+{
+  int int_x = trptr - tfsizeptr - sizeof (int);
+
+  memcpy (tfsizeptr, &int_x, 4);
+}
+
+void
+write_index_trace_file (void)
+{
+  int fd;
+
+  fd = open ("tfile-index.tf", O_WRONLY|O_CREAT|O_TRUNC,
+	     S_IRUSR|S_IWUSR|S_IRGRP|S_IROTH);
+  if (fd < 0)
+    return;
+
+  write (fd, "\x7fTRACE0\n", 8);
+
+  snprintf (spbuf, sizeof spbuf, "R %x\n", 500 /* FIXME get from arch */);
+  write (fd, spbuf, strlen (spbuf));
+
+  snprintf (spbuf, sizeof spbuf, "status 0;tstop:0;tframes:5;tcreated:5;tfree:100;tsize:1000\n");
+  write (fd, spbuf, strlen (spbuf));
+
+  snprintf (spbuf, sizeof spbuf, "tp T1:%lx:E:0:0\n", (long) &tp_a);
+  write (fd, spbuf, strlen (spbuf));
+  snprintf (spbuf, sizeof spbuf, "tp T2:%lx:E:0:0\n", (long) &tp_b);
+  write (fd, spbuf, strlen (spbuf));
+
+  write (fd, "\n", 1);
+
+  trptr = trbuf;
+
+  /* Frame 0, tracepoint 1: MEMBUF in two halves, then a block
+     overlapping both, which the halves hide.  */
+  start_frame (1);
+  fill_membuf (1);
+  add_memory_block (membuf, 8);
+  add_memory_block (membuf + 8, 8);
+  fill_membuf (101);
+  add_memory_block (membuf + 2, 12);
+  finish_frame ();
+
+  /* Frame 1, tracepoint 2.  */
+  start_frame (2);
+  fill_membuf (21);
+  add_memory_block (membuf, sizeof (membuf));
+  finish_frame ();
+
+  /* Frame 2, tracepoint 1: all of MEMBUF, then a block within it,
+     which it hides.  */
+  start_frame (1);
+  fill_membuf (41);
+  add_memory_block (membuf, sizeof (membuf));
+  fill_membuf (141);
+  add_memory_block (membuf + 4, 4);
+  finish_frame ();
+
+  /* Frame 3, tracepoint 2.  */
+  start_frame (2);
+  fill_membuf (61);
+  add_memory_block (membuf, sizeof (membuf));
+  finish_frame ();
+
+  /* Frame 4, tracepoint 1: a block within MEMBUF, then all of it.  */
+  start_frame (1);
+  fill_membuf (181);
+  add_memory_block (membuf + 4, 4);
+  fill_membuf (81);
+  add_memory_block (membuf, sizeof (membuf));
+  finish_frame ();
+
+  /* End of trace buffer marker.  */
+  memset (trptr, 0, 6);
+  trptr += 6;
+
+  write (fd, trbuf, trptr - trbuf);
+  close (fd);
+}
+
+void
+done_making_trace_files (void)
+{
+}
+
+int
+main (void)
+{
+  write_index_trace_file ();
+
+  done_making_trace_files ();
+
+  return 0;
+}
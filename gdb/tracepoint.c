@@ -64,6 +64,11 @@
 #include <unistd.h>
 #endif
 
+#ifdef HAVE_MMAP
+#include <sys/mman.h>
+#endif
+#include "gdb_stat.h"
+
 #ifndef O_LARGEFILE
 #define O_LARGEFILE 0
 #endif
@@ -3590,6 +3595,103 @@ int cur_traceframe_number;
 int cur_data_size;
 int trace_regblock_size;
 
+/* An entry of the trace file's traceframe index, which is built when
+   the file is opened, so that looking up a traceframe doesn't need to
+   scan the file from the start.  */
+
+struct tfile_frame
+{
+  /* Offset in the file of the traceframe's data, just past its
+     header.  */
+  off_t offset;
+
+  /* Size of the traceframe's data.  */
+  unsigned int data_size;
+
+  /* Number of the tracepoint that collected the traceframe.  */
+  short tpnum;
+};
+
+/* A run of TFILE_FRAMES_BY_TP holding every traceframe collected by
+   the tracepoint numbered TPNUM.  */
+
+struct tfile_tp_frames
+{
+  short tpnum;
+  int start;
+  int count;
+};
+
+/* The traceframes in the file, indexed by traceframe number.  */
+static struct tfile_frame *tfile_frames;
+static int tfile_frame_count;
+
+/* Traceframe numbers sorted by tracepoint number, then by traceframe
+   number, and the runs of it belonging to each tracepoint, sorted by
+   tracepoint number.  */
+static int *tfile_frames_by_tp;
+static struct tfile_tp_frames *tfile_tps;
+static int tfile_tp_count;
+
+/* The byte order the index was built with.  */
+static enum bfd_endian tfile_frames_byte_order;
+
+/* How much of the file to read at a time while building the
+   index.  */
+#define TFILE_INDEX_BUFSIZE (64 * 1024)
+
+/* The whole trace file mapped into memory, or NULL if mapping it
+   failed, in which case traceframes are read into a buffer.  */
+static gdb_byte *tfile_map;
+static size_t tfile_map_size;
+
+/* A memory block of the current traceframe.  */
+
+struct tfile_mem_block
+{
+  /* The address and length of the memory collected.  */
+  ULONGEST addr;
+  unsigned short len;
+
+  /* Position of the block's contents in the traceframe's data.  */
+  int pos;
+
+  /* The highest end address of this block and of all the blocks
+     sorted before it.  */
+  ULONGEST max_end;
+};
+
+/* The blocks of the current traceframe, parsed once when it is first
+   looked at after being selected.  */
+
+struct tfile_frame_blocks
+{
+  /* The traceframe these blocks are from, or -1 if none.  */
+  int traceframe;
+
+  /* The traceframe's data, either in TFILE_MAP, or in BUF.  */
+  gdb_byte *data;
+  gdb_byte *buf;
+  int buf_size;
+
+  /* Position of the first register block's contents, or -1 if the
+     traceframe has none, and how many of its bytes are present.  */
+  int regs_pos;
+  int regs_size;
+
+  /* The memory blocks, sorted by address.  */
+  struct tfile_mem_block *mem;
+  int mem_count;
+  int mem_alloc;
+
+  /* Positions of the trace state variable blocks' contents.  */
+  int *tsv_pos;
+  int tsv_count;
+  int tsv_alloc;
+};
+
+static struct tfile_frame_blocks tfile_blocks = { -1 };
+
 static void tfile_interp_line (char *line,
 			       struct uploaded_tp **utpp,
 			       struct uploaded_tsv **utsvp);
@@ -3612,6 +3714,129 @@ tfile_read (gdb_byte *readbuf, int size)
     error (_("Premature end of file while reading trace file"));
 }
 
+/* Discard the traceframe index.  */
+
+static void
+tfile_free_frame_index (void)
+{
+  xfree (tfile_frames);
+  tfile_frames = NULL;
+  tfile_frame_count = 0;
+  xfree (tfile_frames_by_tp);
+  tfile_frames_by_tp = NULL;
+  xfree (tfile_tps);
+  tfile_tps = NULL;
+  tfile_tp_count = 0;
+}
+
+/* qsort comparison function for tfile_frames_by_tp.  */
+
+static int
+compare_tfile_frames_by_tp (const void *ap, const void *bp)
+{
+  int a = *(const int *) ap;
+  int b = *(const int *) bp;
+
+  if (tfile_frames[a].tpnum != tfile_frames[b].tpnum)
+    return tfile_frames[a].tpnum < tfile_frames[b].tpnum ? -1 : 1;
+  return a - b;
+}
+
+/* Build the traceframe index, reading the traceframe headers in large
+   chunks.  A file that ends without the terminating zero tracepoint
+   number, e.g. because it is still being written, is indexed up to
+   the last complete traceframe header.  */
+
+static void
+tfile_build_frame_index (void)
+{
+  enum bfd_endian byte_order = gdbarch_byte_order (target_gdbarch);
+  struct cleanup *old_chain;
+  gdb_byte *buf;
+  off_t buf_offset = 0, buf_len = 0, offset;
+  int alloc = 0;
+  int i;
+
+  tfile_free_frame_index ();
+
+  if (tfile_map != NULL)
+    {
+      /* The headers can be looked at in place.  */
+      buf = tfile_map;
+      buf_len = tfile_map_size;
+      old_chain = make_cleanup (null_cleanup, NULL);
+    }
+  else
+    {
+      buf = xmalloc (TFILE_INDEX_BUFSIZE);
+      old_chain = make_cleanup (xfree, buf);
+    }
+
+  offset = trace_frames_offset;
+  while (1)
+    {
+      gdb_byte *hdr;
+      short tpnum;
+
+      /* Refill the buffer if it doesn't hold this frame's header.  */
+      if (tfile_map == NULL && offset + 6 > buf_offset + buf_len)
+	{
+	  if (lseek (trace_fd, offset, SEEK_SET) < 0)
+	    perror_with_name (trace_filename);
+	  buf_len = read (trace_fd, buf, TFILE_INDEX_BUFSIZE);
+	  if (buf_len < 0)
+	    perror_with_name (trace_filename);
+	  buf_offset = offset;
+	}
+
+      hdr = buf + (offset - buf_offset);
+      if (buf_len - (offset - buf_offset) < 2)
+	break;
+      tpnum = (short) extract_signed_integer (hdr, 2, byte_order);
+      if (tpnum == 0 || buf_len - (offset - buf_offset) < 6)
+	break;
+
+      if (tfile_frame_count == alloc)
+	{
+	  alloc = alloc ? alloc * 2 : 1024;
+	  tfile_frames = xrealloc (tfile_frames,
+				   alloc * sizeof (struct tfile_frame));
+	}
+      tfile_frames[tfile_frame_count].tpnum = tpnum;
+      tfile_frames[tfile_frame_count].data_size
+	= (unsigned int) extract_unsigned_integer (hdr + 2, 4, byte_order);
+      tfile_frames[tfile_frame_count].offset = offset + 6;
+      offset += 6 + tfile_frames[tfile_frame_count].data_size;
+      ++tfile_frame_count;
+    }
+
+  do_cleanups (old_chain);
+
+  tfile_frames_by_tp = xmalloc ((tfile_frame_count + 1) * sizeof (int));
+  for (i = 0; i < tfile_frame_count; i++)
+    tfile_frames_by_tp[i] = i;
+  qsort (tfile_frames_by_tp, tfile_frame_count, sizeof (int),
+	 compare_tfile_frames_by_tp);
+
+  tfile_tps = xmalloc ((tfile_frame_count + 1)
+		       * sizeof (struct tfile_tp_frames));
+  for (i = 0; i < tfile_frame_count; i++)
+    {
+      short tpnum = tfile_frames[tfile_frames_by_tp[i]].tpnum;
+
+      if (tfile_tp_count == 0 || tfile_tps[tfile_tp_count - 1].tpnum != tpnum)
+	{
+	  tfile_tps[tfile_tp_count].tpnum = tpnum;
+	  tfile_tps[tfile_tp_count].start = i;
+	  tfile_tps[tfile_tp_count].count = 0;
+	  tfile_tp_count++;
+	}
+      tfile_tps[tfile_tp_count - 1].count++;
+    }
+
+  tfile_frames_byte_order = byte_order;
+}
+
 static void
 tfile_open (char *filename, int from_tty)
 {
@@ -3656,6 +3881,10 @@ tfile_open (char *filename, int from_tty)
   trace_filename = xstrdup (filename);
   trace_fd = scratch_chan;
 
+  /* Nothing of a previous file that failed to open may be used.  */
+  tfile_map = NULL;
+  tfile_map_size = 0;
+
   bytes = 0;
   /* Read the file header and test for validity.  */
   tfile_read ((gdb_byte *) &header, TRACE_HEADER_SIZE);
@@ -3665,6 +3894,27 @@ tfile_open (char *filename, int from_tty)
 	&& (strncmp (header + 1, "TRACE0\n", 7) == 0)))
     error (_("File is not a valid trace file."));
 
+  /* Only map the file once it is known to be a trace file, so that
+     nothing is left mapped if the header check fails.  */
+#ifdef HAVE_MMAP
+  {
+    struct stat st;
+
+    if (fstat (trace_fd, &st) == 0 && st.st_size > 0
+	&& (size_t) st.st_size == st.st_size)
+      {
+	void *map = mmap (NULL, st.st_size, PROT_READ, MAP_PRIVATE,
+			  trace_fd, 0);
+
+	if (map != MAP_FAILED)
+	  {
+	    tfile_map = map;
+	    tfile_map_size = st.st_size;
+	  }
+      }
+  }
+#endif
+
   push_target (&tfile_ops);
 
   trace_regblock_size = 0;
@@ -3713,6 +3963,8 @@ tfile_open (char *filename, int from_tty)
 	 traceframes.  */
       if (trace_regblock_size == 0)
 	error (_("No register block size recorded in trace file"));
+
+      tfile_build_frame_index ();
     }
   if (ex.reason < 0)
     {
@@ -4117,6 +4369,20 @@ tfile_close (int quitting)
   trace_fd = -1;
   xfree (trace_filename);
   trace_filename = NULL;
+  tfile_free_frame_index ();
+
+#ifdef HAVE_MMAP
+  if (tfile_map != NULL)
+    munmap (tfile_map, tfile_map_size);
+#endif
+  tfile_map = NULL;
+  tfile_map_size = 0;
+
+  xfree (tfile_blocks.buf);
+  xfree (tfile_blocks.mem);
+  xfree (tfile_blocks.tsv_pos);
+  memset (&tfile_blocks, 0, sizeof (tfile_blocks));
+  tfile_blocks.traceframe = -1;
 }
 
 static void
@@ -4144,36 +4410,25 @@ tfile_get_tracepoint_status (struct breakpoint *tp, struct uploaded_tp *utp)
      trace files, so nothing to do here.  */
 }
 
-/* Given the position of a traceframe in the file, figure out what
-   address the frame was collected at.  This would normally be the
-   value of a collected PC register, but if not available, we
-   improvise.  */
+/* Given the number of the tracepoint that collected a traceframe,
+   figure out what address the frame was collected at.  This would
+   normally be the value of a collected PC register, but if not
+   available, we improvise.  */
 
 static ULONGEST
-tfile_get_traceframe_address (off_t tframe_offset)
+tfile_get_traceframe_address (short tpnum)
 {
   ULONGEST addr = 0;
-  short tpnum;
   struct tracepoint *tp;
-  off_t saved_offset = cur_offset;
 
   /* FIXME dig pc out of collected registers.  */
 
   /* Fall back to using tracepoint address.  */
-  lseek (trace_fd, tframe_offset, SEEK_SET);
-  tfile_read ((gdb_byte *) &tpnum, 2);
-  tpnum = (short) extract_signed_integer ((gdb_byte *) &tpnum, 2,
-					  gdbarch_byte_order
-					      (target_gdbarch));
-
   tp = get_tracepoint_by_number_on_target (tpnum);
   /* FIXME this is a poor heuristic if multiple locations.  */
   if (tp && tp->base.loc)
     addr = tp->base.loc->address;
 
-  /* Restore our seek position.  */
-  cur_offset = saved_offset;
-  lseek (trace_fd, cur_offset, SEEK_SET);
   return addr;
 }
 
@@ -4199,8 +4454,55 @@ set_tfile_traceframe (void)
     warning (_("could not set tfile's traceframe"));
 }
 
-/* Given a type of search and some parameters, scan the collection of
-   traceframes in the file looking for a match.  When found, return
+/* Return the number of the first traceframe collected by the
+   tracepoint whose run in the index is TPF, at or after traceframe
+   number START, or -1 if there is none.  */
+
+static int
+tfile_find_frame_in_tp (struct tfile_tp_frames *tpf, int start)
+{
+  int *frames = tfile_frames_by_tp + tpf->start;
+  int lo = 0, hi = tpf->count;
+
+  while (lo < hi)
+    {
+      int mid = lo + (hi - lo) / 2;
+
+      if (frames[mid] < start)
+	lo = mid + 1;
+      else
+	hi = mid;
+    }
+
+  return lo < tpf->count ? frames[lo] : -1;
+}
+
+/* Return the index run of the tracepoint numbered TPNUM on the target,
+   or NULL if it collected no traceframes.  */
+
+static struct tfile_tp_frames *
+tfile_find_tp_frames (short tpnum)
+{
+  int lo = 0, hi = tfile_tp_count;
+
+  while (lo < hi)
+    {
+      int mid = lo + (hi - lo) / 2;
+
+      if (tfile_tps[mid].tpnum < tpnum)
+	lo = mid + 1;
+      else
+	hi = mid;
+    }
+
+  if (lo < tfile_tp_count && tfile_tps[lo].tpnum == tpnum)
+    return &tfile_tps[lo];
+  return NULL;
+}
+
+/* Given a type of search and some parameters, look up the traceframe
+   index for a match.  Searches other than by absolute frame number
+   proceed forward from the current traceframe.  When found, return
    both the traceframe and tracepoint number, otherwise -1 for
    each.  */
 
@@ -4208,11 +4510,9 @@ static int
 tfile_trace_find (enum trace_find_type type, int num,
 		  ULONGEST addr1, ULONGEST addr2, int *tpp)
 {
-  short tpnum;
-  int tfnum = 0, found = 0;
-  unsigned int data_size;
-  struct tracepoint *tp;
-  off_t offset, tframe_offset;
+  int tfnum = -1;
+  int start, i;
+  struct tfile_tp_frames *tpf;
   ULONGEST tfaddr;
 
   /* Lookups other than by absolute frame number depend on the current
@@ -4227,135 +4527,177 @@ tfile_trace_find (enum trace_find_type type, int num,
       return -1;
     }
 
-  lseek (trace_fd, trace_frames_offset, SEEK_SET);
-  offset = trace_frames_offset;
-  while (1)
+  /* The index was built using the byte order known when the file was
+     opened; rebuild it if that has since changed.  */
+  if (tfile_frames_byte_order != gdbarch_byte_order (target_gdbarch))
+    tfile_build_frame_index ();
+
+  start = cur_traceframe_number + 1;
+  switch (type)
     {
-      tframe_offset = offset;
-      tfile_read ((gdb_byte *) &tpnum, 2);
-      tpnum = (short) extract_signed_integer ((gdb_byte *) &tpnum, 2,
-					      gdbarch_byte_order
-						  (target_gdbarch));
-      offset += 2;
-      if (tpnum == 0)
-	break;
-      tfile_read ((gdb_byte *) &data_size, 4);
-      data_size = (unsigned int) extract_unsigned_integer
-                                     ((gdb_byte *) &data_size, 4,
-				      gdbarch_byte_order (target_gdbarch));
-      offset += 4;
-      switch (type)
-	{
-	case tfind_number:
-	  if (tfnum == num)
-	    found = 1;
-	  break;
-	case tfind_pc:
-	  tfaddr = tfile_get_traceframe_address (tframe_offset);
-	  if (tfaddr == addr1)
-	    found = 1;
-	  break;
-	case tfind_tp:
-	  tp = get_tracepoint (num);
-	  if (tp && tpnum == tp->number_on_target)
-	    found = 1;
-	  break;
-	case tfind_range:
-	  tfaddr = tfile_get_traceframe_address (tframe_offset);
-	  if (addr1 <= tfaddr && tfaddr <= addr2)
-	    found = 1;
-	  break;
-	case tfind_outside:
-	  tfaddr = tfile_get_traceframe_address (tframe_offset);
-	  if (!(addr1 <= tfaddr && tfaddr <= addr2))
-	    found = 1;
-	  break;
-	default:
-	  internal_error (__FILE__, __LINE__, _("unknown tfind type"));
-	}
-      if (found)
+    case tfind_number:
+      if (num >= 0 && num < tfile_frame_count)
+	tfnum = num;
+      break;
+    case tfind_tp:
+      /* NUM is already the target's number for the tracepoint.  */
+      tpf = tfile_find_tp_frames (num);
+      if (tpf)
+	tfnum = tfile_find_frame_in_tp (tpf, start);
+      break;
+    case tfind_pc:
+    case tfind_range:
+    case tfind_outside:
+      /* A traceframe's address only depends on its tracepoint, so
+	 check each tracepoint once, and take the earliest match.  */
+      for (i = 0; i < tfile_tp_count; i++)
 	{
-	  if (tpp)
-	    *tpp = tpnum;
-	  cur_offset = offset;
-	  cur_data_size = data_size;
-	  cur_traceframe_number = tfnum;
-	  return tfnum;
+	  int found, n;
+
+	  tfaddr = tfile_get_traceframe_address (tfile_tps[i].tpnum);
+	  if (type == tfind_pc)
+	    found = (tfaddr == addr1);
+	  else if (type == tfind_range)
+	    found = (addr1 <= tfaddr && tfaddr <= addr2);
+	  else
+	    found = !(addr1 <= tfaddr && tfaddr <= addr2);
+	  if (!found)
+	    continue;
+
+	  n = tfile_find_frame_in_tp (&tfile_tps[i], start);
+	  if (n != -1 && (tfnum == -1 || n < tfnum))
+	    tfnum = n;
 	}
-      /* Skip past the traceframe's data.  */
-      lseek (trace_fd, data_size, SEEK_CUR);
-      offset += data_size;
-      /* Update our own count of traceframes.  */
-      ++tfnum;
+      break;
+    default:
+      internal_error (__FILE__, __LINE__, _("unknown tfind type"));
+    }
+
+  if (tfnum == -1)
+    {
+      /* Did not find what we were looking for.  */
+      if (tpp)
+	*tpp = -1;
+      return -1;
     }
-  /* Did not find what we were looking for.  */
+
   if (tpp)
-    *tpp = -1;
-  return -1;
+    *tpp = tfile_frames[tfnum].tpnum;
+  cur_offset = tfile_frames[tfnum].offset;
+  cur_data_size = tfile_frames[tfnum].data_size;
+  cur_traceframe_number = tfnum;
+  return tfnum;
 }
 
-/* Prototype of the callback passed to tframe_walk_blocks.  */
-typedef int (*walk_blocks_callback_func) (char blocktype, void *data);
-
-/* Callback for traceframe_walk_blocks, used to find a given block
-   type in a traceframe.  */
+/* qsort comparison function for the memory blocks of a
+   traceframe.  */
 
 static int
-match_blocktype (char blocktype, void *data)
+compare_tfile_mem_blocks (const void *ap, const void *bp)
 {
-  char *wantedp = data;
+  const struct tfile_mem_block *a = ap;
+  const struct tfile_mem_block *b = bp;
 
-  if (*wantedp == blocktype)
-    return 1;
-
-  return 0;
+  if (a->addr != b->addr)
+    return a->addr < b->addr ? -1 : 1;
+  return a->pos - b->pos;
 }
 
-/* Walk over all traceframe block starting at POS offset from
-   CUR_OFFSET, and call CALLBACK for each block found, passing in DATA
-   unmodified.  If CALLBACK returns true, this returns the position in
-   the traceframe where the block is found, relative to the start of
-   the traceframe (cur_offset).  Returns -1 if no callback call
-   returned true, indicating that all blocks have been walked.  */
+/* Make TFILE_BLOCKS describe the current traceframe.  Its data is
+   looked at in place in the mapped file if possible, or else read in
+   with a single read, and its blocks are walked once, recording where
+   the register block is, and which memory and trace state variables
+   are present.  */
 
-static int
-traceframe_walk_blocks (walk_blocks_callback_func callback,
-			int pos, void *data)
+static void
+tfile_index_frame_blocks (void)
 {
-  /* Iterate through a traceframe's blocks, looking for a block of the
-     requested type.  */
+  struct tfile_frame_blocks *fb = &tfile_blocks;
+  enum bfd_endian byte_order = gdbarch_byte_order (target_gdbarch);
+  int pos, i;
 
-  lseek (trace_fd, cur_offset + pos, SEEK_SET);
-  while (pos < cur_data_size)
-    {
-      unsigned short mlen;
-      char block_type;
+  if (fb->traceframe == cur_traceframe_number)
+    return;
 
-      tfile_read (&block_type, 1);
+  fb->traceframe = -1;
+  fb->data = NULL;
+  fb->regs_pos = -1;
+  fb->regs_size = 0;
+  fb->mem_count = 0;
+  fb->tsv_count = 0;
+
+  if (cur_traceframe_number == -1)
+    {
+      fb->traceframe = cur_traceframe_number;
+      return;
+    }
 
-      ++pos;
+  if (tfile_map != NULL)
+    {
+      if (cur_offset + cur_data_size > tfile_map_size)
+	error (_("Premature end of file while reading trace file"));
+      fb->data = tfile_map + cur_offset;
+    }
+  else
+    {
+      if (cur_data_size > fb->buf_size)
+	{
+	  fb->buf = xrealloc (fb->buf, cur_data_size);
+	  fb->buf_size = cur_data_size;
+	}
+      lseek (trace_fd, cur_offset, SEEK_SET);
+      tfile_read (fb->buf, cur_data_size);
+      fb->data = fb->buf;
+    }
 
-      if ((*callback) (block_type, data))
-	return pos;
+  pos = 0;
+  while (pos < cur_data_size)
+    {
+      char block_type = fb->data[pos++];
 
       switch (block_type)
 	{
 	case 'R':
-	  lseek (trace_fd, cur_offset + pos + trace_regblock_size, SEEK_SET);
+	  if (fb->regs_pos == -1)
+	    {
+	      fb->regs_pos = pos;
+	      fb->regs_size = min (trace_regblock_size, cur_data_size - pos);
+	    }
 	  pos += trace_regblock_size;
 	  break;
 	case 'M':
-	  lseek (trace_fd, cur_offset + pos + 8, SEEK_SET);
-	  tfile_read ((gdb_byte *) &mlen, 2);
-          mlen = (unsigned short)
-                extract_unsigned_integer ((gdb_byte *) &mlen, 2,
-                                          gdbarch_byte_order
-                                              (target_gdbarch));
-	  lseek (trace_fd, mlen, SEEK_CUR);
-	  pos += (8 + 2 + mlen);
+	  {
+	    struct tfile_mem_block *mb;
+
+	    if (pos + 8 + 2 > cur_data_size)
+	      error (_("Premature end of file while reading trace file"));
+	    if (fb->mem_count == fb->mem_alloc)
+	      {
+		fb->mem_alloc = fb->mem_alloc ? fb->mem_alloc * 2 : 16;
+		fb->mem = xrealloc (fb->mem,
+				    fb->mem_alloc * sizeof (*fb->mem));
+	      }
+	    mb = &fb->mem[fb->mem_count++];
+	    mb->addr = extract_unsigned_integer (fb->data + pos, 8,
+						 byte_order);
+	    mb->len = (unsigned short)
+	      extract_unsigned_integer (fb->data + pos + 8, 2, byte_order);
+	    mb->pos = pos + 8 + 2;
+	    pos += 8 + 2 + mb->len;
+	    if (pos > cur_data_size)
+	      error (_("Premature end of file while reading trace file"));
+	  }
 	  break;
 	case 'V':
-	  lseek (trace_fd, cur_offset + pos + 4 + 8, SEEK_SET);
+	  if (pos + 4 + 8 > cur_data_size)
+	    error (_("Premature end of file while reading trace file"));
+	  if (fb->tsv_count == fb->tsv_alloc)
+	    {
+	      fb->tsv_alloc = fb->tsv_alloc ? fb->tsv_alloc * 2 : 16;
+	      fb->tsv_pos = xrealloc (fb->tsv_pos,
+				      fb->tsv_alloc * sizeof (int));
+	    }
+	  fb->tsv_pos[fb->tsv_count++] = pos;
 	  pos += (4 + 8);
 	  break;
 	default:
@@ -4365,17 +4707,48 @@ traceframe_walk_blocks (walk_blocks_callback_func callback,
 	}
     }
 
-  return -1;
+  qsort (fb->mem, fb->mem_count, sizeof (*fb->mem), compare_tfile_mem_blocks);
+  for (i = 0; i < fb->mem_count; i++)
+    {
+      fb->mem[i].max_end = fb->mem[i].addr + fb->mem[i].len;
+      if (i > 0 && fb->mem[i - 1].max_end > fb->mem[i].max_end)
+	fb->mem[i].max_end = fb->mem[i - 1].max_end;
+    }
+
+  fb->traceframe = cur_traceframe_number;
 }
 
-/* Convenience wrapper around traceframe_walk_blocks.  Looks for the
-   position offset of a block of type TYPE_WANTED in the current trace
-   frame, starting at POS.  Returns -1 if no such block was found.  */
+/* Return the memory block of the current traceframe that holds ADDR,
+   or NULL if there is none.  If several blocks do, return the one
+   that comes first in the traceframe.  */
 
-static int
-traceframe_find_block_type (char type_wanted, int pos)
+static struct tfile_mem_block *
+tfile_find_mem_block (ULONGEST addr)
 {
-  return traceframe_walk_blocks (match_blocktype, pos, &type_wanted);
+  struct tfile_frame_blocks *fb = &tfile_blocks;
+  struct tfile_mem_block *found = NULL;
+  int lo = 0, hi = fb->mem_count;
+  int i;
+
+  /* Find the first block starting above ADDR...  */
+  while (lo < hi)
+    {
+      int mid = lo + (hi - lo) / 2;
+
+      if (fb->mem[mid].addr <= addr)
+	lo = mid + 1;
+      else
+	hi = mid;
+    }
+
+  /* ... and look back through the blocks that might still reach
+     it.  */
+  for (i = lo - 1; i >= 0 && fb->mem[i].max_end > addr; i--)
+    if (addr < fb->mem[i].addr + fb->mem[i].len
+	&& (found == NULL || fb->mem[i].pos < found->pos))
+      found = &fb->mem[i];
+
+  return found;
 }
 
 /* Look for a block of saved registers in the traceframe, and get the
@@ -4386,10 +4759,8 @@ tfile_fetch_registers (struct target_ops *ops,
 		       struct regcache *regcache, int regno)
 {
   struct gdbarch *gdbarch = get_regcache_arch (regcache);
-  char block_type;
-  int pos, offset, regn, regsize, pc_regno;
-  unsigned short mlen;
-  char *regs;
+  int offset, regn, regsize, pc_regno;
+  gdb_byte *regs;
 
   /* An uninitialized reg size says we're not going to be
      successful at getting register blocks.  */
@@ -4397,12 +4768,12 @@ tfile_fetch_registers (struct target_ops *ops,
     return;
 
   set_tfile_traceframe ();
+  tfile_index_frame_blocks ();
 
-  regs = alloca (trace_regblock_size);
-
-  if (traceframe_find_block_type ('R', 0) >= 0)
+  if (tfile_blocks.regs_pos >= 0)
     {
-      tfile_read (regs, trace_regblock_size);
+      /* Supply the registers straight from the traceframe's data.  */
+      regs = tfile_blocks.data + tfile_blocks.regs_pos;
 
       /* Assume the block is laid out in GDB register number order,
 	 each register with the size that it has in GDB.  */
@@ -4411,7 +4782,7 @@ tfile_fetch_registers (struct target_ops *ops,
 	{
 	  regsize = register_size (gdbarch, regn);
 	  /* Make sure we stay within block bounds.  */
-	  if (offset + regsize >= trace_regblock_size)
+	  if (offset + regsize >= tfile_blocks.regs_size)
 	    break;
 	  if (regcache_register_status (regcache, regn) == REG_UNKNOWN)
 	    {
@@ -4461,6 +4832,7 @@ tfile_fetch_registers (struct target_ops *ops,
 	      return;
 	    }
 
+	  regs = alloca (register_size (gdbarch, pc_regno));
 	  store_unsigned_integer (regs, register_size (gdbarch, pc_regno),
 				  gdbarch_byte_order (gdbarch),
 				  tp->base.loc->address);
@@ -4485,39 +4857,24 @@ tfile_xfer_partial (struct target_ops *ops, enum target_object object,
 
  if (traceframe_number != -1)
     {
-      int pos = 0;
+      struct tfile_mem_block *mb;
 
-      /* Iterate through the traceframe's blocks, looking for
-	 memory.  */
-      while ((pos = traceframe_find_block_type ('M', pos)) >= 0)
+      tfile_index_frame_blocks ();
+
+      /* If a block includes the first part of the desired range,
+	 return as much it has; GDB will re-request the remainder,
+	 which might be in a different block of this trace frame.  */
+      mb = tfile_find_mem_block (offset);
+      if (mb != NULL)
 	{
-	  ULONGEST maddr, amt;
-	  unsigned short mlen;
-	  enum bfd_endian byte_order = gdbarch_byte_order (target_gdbarch);
-
-	  tfile_read ((gdb_byte *) &maddr, 8);
-	  maddr = extract_unsigned_integer ((gdb_byte *) &maddr, 8,
-					    byte_order);
-	  tfile_read ((gdb_byte *) &mlen, 2);
-	  mlen = (unsigned short)
-	    extract_unsigned_integer ((gdb_byte *) &mlen, 2, byte_order);
-
-	  /* If the block includes the first part of the desired
-	     range, return as much it has; GDB will re-request the
-	     remainder, which might be in a different block of this
-	     trace frame.  */
-	  if (maddr <= offset && offset < (maddr + mlen))
-	    {
-	      amt = (maddr + mlen) - offset;
-	      if (amt > len)
-		amt = len;
+	  ULONGEST amt = (mb->addr + mb->len) - offset;
 
-	      tfile_read (readbuf, amt);
-	      return amt;
-	    }
+	  if (amt > len)
+	    amt = len;
 
-	  /* Skip over this block.  */
-	  pos += (8 + 2 + mlen);
+	  memcpy (readbuf,
+		  tfile_blocks.data + mb->pos + (offset - mb->addr), amt);
+	  return amt;
 	}
     }
 
@@ -4564,28 +4921,23 @@ tfile_xfer_partial (struct target_ops *ops, enum target_object object,
 static int
 tfile_get_trace_state_variable_value (int tsvnum, LONGEST *val)
 {
-  int pos;
+  enum bfd_endian byte_order = gdbarch_byte_order (target_gdbarch);
+  int i;
 
   set_tfile_traceframe ();
+  tfile_index_frame_blocks ();
 
-  pos = 0;
-  while ((pos = traceframe_find_block_type ('V', pos)) >= 0)
+  for (i = 0; i < tfile_blocks.tsv_count; i++)
     {
+      gdb_byte *block = tfile_blocks.data + tfile_blocks.tsv_pos[i];
       int vnum;
 
-      tfile_read ((gdb_byte *) &vnum, 4);
-      vnum = (int) extract_signed_integer ((gdb_byte *) &vnum, 4,
-					   gdbarch_byte_order
-					   (target_gdbarch));
+      vnum = (int) extract_signed_integer (block, 4, byte_order);
       if (tsvnum == vnum)
 	{
-	  tfile_read ((gdb_byte *) val, 8);
-	  *val = extract_signed_integer ((gdb_byte *) val, 8,
-					 gdbarch_byte_order
-					 (target_gdbarch));
+	  *val = extract_signed_integer (block + 4, 8, byte_order);
 	  return 1;
 	}
-      pos += (4 + 8);
     }
 
   /* Didn't find anything.  */
@@ -4622,53 +4974,27 @@ tfile_thread_alive (struct target_ops *ops, ptid_t ptid)
   return 1;
 }
 
-/* Callback for traceframe_walk_blocks.  Builds a traceframe_info
-   object for the tfile target's current traceframe.  */
+/* Build a traceframe_info object for the tfile target's current
+   traceframe.  */
 
-static int
-build_traceframe_info (char blocktype, void *data)
+static struct traceframe_info *
+tfile_traceframe_info (void)
 {
-  struct traceframe_info *info = data;
+  struct traceframe_info *info = XCNEW (struct traceframe_info);
+  int i;
 
-  switch (blocktype)
-    {
-    case 'M':
-      {
-	struct mem_range *r;
-	ULONGEST maddr;
-	unsigned short mlen;
+  tfile_index_frame_blocks ();
 
-	tfile_read ((gdb_byte *) &maddr, 8);
-	tfile_read ((gdb_byte *) &mlen, 2);
+  for (i = 0; i < tfile_blocks.mem_count; i++)
+    {
+      struct mem_range *r;
 
-	r = VEC_safe_push (mem_range_s, info->memory, NULL);
+      r = VEC_safe_push (mem_range_s, info->memory, NULL);
 
-	r->start = maddr;
-	r->length = mlen;
-	break;
-      }
-    case 'V':
-    case 'R':
-    case 'S':
-      {
-	break;
-      }
-    default:
-      warning (_("Unhandled trace block type (%d) '%c ' "
-		 "while building trace frame info."),
-	       blocktype, blocktype);
-      break;
+      r->start = tfile_blocks.mem[i].addr;
+      r->length = tfile_blocks.mem[i].len;
     }
 
-  return 0;
-}
-
-static struct traceframe_info *
-tfile_traceframe_info (void)
-{
-  struct traceframe_info *info = XCNEW (struct traceframe_info);
-
-  traceframe_walk_blocks (build_traceframe_info, 0, info);
   return info;
 }
 
@@ -759,6 +759,9 @@ make_command_stats_cleanup (int msg_type)
 void
 vwarning (const char *string, va_list args)
 {
+  if (thread_problem_hook != NULL)
+    thread_problem_hook ();
+
   if (deprecated_warning_hook)
     (*deprecated_warning_hook) (string, args);
   else
@@ -917,6 +920,9 @@ internal_vproblem (struct internal_problem *problem,
   int dump_core_p;
   char *reason;
 
+  if (thread_problem_hook != NULL)
+    thread_problem_hook ();
+
   /* Don't allow infinite error/warning recursion.  */
   {
     static char msg[] = "Recursive internal problem.\n";